@@ -137,7 +137,8 @@ public:
 		delete[] contigScafIds ;
 	}
 
-	void AddEdge( int u, int dummyU, int v, int dummyV, bool checkDuplicate = false ) 
+	// Return false if checkDuplicate is set and the edge is already in the graph.
+	bool AddEdge( int u, int dummyU, int v, int dummyV, bool checkDuplicate = false ) 
 	{
 		if ( checkDuplicate )
 		{
@@ -146,7 +147,7 @@ public:
 			for ( int i = 0 ; i < ncnt ; ++i )
 			{
 				if ( neighbors[i].a == v && neighbors[i].b == dummyV )
-					return ;
+					return false ;
 			}
 		}
 		contigGraph[ edgeUsed ].u = u ;
@@ -170,6 +171,7 @@ public:
 			fprintf( stderr, "Too many edges.\n" ) ;
 			exit( 1 ) ;
 		}
+		return true ;
 	}
 
 	void RemoveEdge( int u, int dummyU, int v, int dummyV )
@@ -0,0 +1,123 @@
+// The hash table mapping an edge (u,v) to its index in the adjacency list of u
+// Li Song
+
+#ifndef _LSONG_RSCAF_EDGEHASH_HEADER
+#define _LSONG_RSCAF_EDGEHASH_HEADER
+
+#include <stdint.h>
+#include <vector>
+
+#define EDGEHASH_EMPTY ((uint64_t)-1)
+
+// Open addressing with linear probing. The edges are never removed during the
+// construction of a graph, so there is no deletion, only Clear().
+class EdgeHash
+{
+private:
+	std::vector<uint64_t> keys ;
+	std::vector<int> values ;
+	int size ;
+	uint64_t mask ;
+
+	uint64_t GetKey( int u, int v )
+	{
+		return ( (uint64_t)(uint32_t)u << 32 ) | (uint32_t)v ;
+	}
+
+	uint64_t Hash( uint64_t key )
+	{
+		// The finalizer of splitmix64
+		key ^= key >> 30 ;
+		key *= 0xbf58476d1ce4e5b9ull ;
+		key ^= key >> 27 ;
+		key *= 0x94d049bb133111ebull ;
+		key ^= key >> 31 ;
+		return key ;
+	}
+
+	void Rehash( int capacity )
+	{
+		std::vector<uint64_t> oldKeys ;
+		std::vector<int> oldValues ;
+		oldKeys.swap( keys ) ;
+		oldValues.swap( values ) ;
+
+		keys.assign( capacity, EDGEHASH_EMPTY ) ;
+		values.assign( capacity, -1 ) ;
+		mask = capacity - 1 ;
+
+		int oldCapacity = oldKeys.size() ;
+		for ( int i = 0 ; i < oldCapacity ; ++i )
+		{
+			if ( oldKeys[i] == EDGEHASH_EMPTY )
+				continue ;
+			uint64_t h = Hash( oldKeys[i] ) & mask ;
+			while ( keys[h] != EDGEHASH_EMPTY )
+				h = ( h + 1 ) & mask ;
+			keys[h] = oldKeys[i] ;
+			values[h] = oldValues[i] ;
+		}
+	}
+
+public:
+	EdgeHash()
+	{
+		size = 0 ;
+		Rehash( 16 ) ;
+	}
+	~EdgeHash() {}
+
+	void Clear()
+	{
+		std::vector<uint64_t>().swap( keys ) ;
+		std::vector<int>().swap( values ) ;
+		size = 0 ;
+		Rehash( 16 ) ;
+	}
+
+	// Reserve the space for about n edges.
+	void Reserve( int n )
+	{
+		int capacity = keys.size() ;
+		while ( capacity < 2 * n )
+			capacity *= 2 ;
+		if ( capacity > (int)keys.size() )
+			Rehash( capacity ) ;
+	}
+
+	// Return the index of edge (u,v), -1 if it does not exist.
+	int Find( int u, int v )
+	{
+		uint64_t key = GetKey( u, v ) ;
+		uint64_t h = Hash( key ) & mask ;
+		while ( keys[h] != EDGEHASH_EMPTY )
+		{
+			if ( keys[h] == key )
+				return values[h] ;
+			h = ( h + 1 ) & mask ;
+		}
+		return -1 ;
+	}
+
+	// Set the index of edge (u,v). The edge should not be in the table yet.
+	void Insert( int u, int v, int value )
+	{
+		if ( 2 * ( size + 1 ) > (int)keys.size() )
+			Rehash( 2 * keys.size() ) ;
+
+		uint64_t key = GetKey( u, v ) ;
+		uint64_t h = Hash( key ) & mask ;
+		while ( keys[h] != EDGEHASH_EMPTY )
+			h = ( h + 1 ) & mask ;
+		keys[h] = key ;
+		values[h] = value ;
+		++size ;
+	}
+
+	int GetSize()
+	{
+		return size ;
+	}
+} ;
+
+#endif
@@ -0,0 +1,172 @@
+// The class stores a multiset of kmers as a sorted array with counts
+// Li Song
+
+#ifndef _LSONG_RSCAF_KMERARRAY_HEADER
+#define _LSONG_RSCAF_KMERARRAY_HEADER
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "defs.h"
+
+// Kmers are appended in any order, then Build() sorts them with LSD radix sort and
+// compresses the runs into (kmer, count). It is much more compact than std::map,
+// and the lookups are binary searches over a contiguous array.
+// T is the word type of the kmer code, see KmerCode.hpp
+template <typename T>
+class KmerArray
+{
+private:
+	std::vector<T> kmers ; // sorted distinct kmers after Build()
+	std::vector<int> counts ;
+	std::vector<T> buffer ; // the scratch space for radix sort, kept to avoid reallocation
+	int keyBits ; // the number of low bits that can be non-zero
+
+	void RadixSort()
+	{
+		int n = kmers.size() ;
+		int i ;
+		if ( n < 64 )
+		{
+			std::sort( kmers.begin(), kmers.end() ) ;
+			return ;
+		}
+
+		buffer.resize( n ) ;
+		T *from = &kmers[0] ;
+		T *to = &buffer[0] ;
+		int count[256] ;
+		int passCnt = ( keyBits + 7 ) / 8 ;
+
+		for ( int pass = 0 ; pass < passCnt ; ++pass )
+		{
+			int shift = pass * 8 ;
+			memset( count, 0, sizeof( count ) ) ;
+			for ( i = 0 ; i < n ; ++i )
+				++count[ (int)( ( from[i] >> shift ) & (T)0xff ) ] ;
+
+			// All the keys share this digit.
+			if ( count[ (int)( ( from[0] >> shift ) & (T)0xff ) ] == n )
+				continue ;
+
+			int sum = 0 ;
+			for ( i = 0 ; i < 256 ; ++i )
+			{
+				int tmp = count[i] ;
+				count[i] = sum ;
+				sum += tmp ;
+			}
+			for ( i = 0 ; i < n ; ++i )
+			{
+				int d = (int)( ( from[i] >> shift ) & (T)0xff ) ;
+				to[ count[d] ] = from[i] ;
+				++count[d] ;
+			}
+
+			T *tmp = from ;
+			from = to ;
+			to = tmp ;
+		}
+
+		if ( from != &kmers[0] )
+			memcpy( &kmers[0], from, sizeof( T ) * n ) ;
+	}
+
+public:
+	KmerArray() { keyBits = sizeof( T ) * 8 ; }
+	~KmerArray() {}
+
+	void Clear()
+	{
+		kmers.clear() ;
+		counts.clear() ;
+	}
+
+	// Tell the sort how many bits the kmer codes use, i.e. 2 * kmer length.
+	void SetKeyBits( int bits )
+	{
+		if ( bits <= 0 || bits > (int)sizeof( T ) * 8 )
+			bits = sizeof( T ) * 8 ;
+		keyBits = bits ;
+	}
+
+	// Append a kmer. Call Build() before any query.
+	void Add( T kmer )
+	{
+		kmers.push_back( kmer ) ;
+	}
+
+	void Build()
+	{
+		int n = kmers.size() ;
+		int i, k ;
+		counts.clear() ;
+		if ( n == 0 )
+			return ;
+		RadixSort() ;
+
+		counts.push_back( 1 ) ;
+		for ( i = 1, k = 0 ; i < n ; ++i )
+		{
+			if ( kmers[i] == kmers[k] )
+				++counts[k] ;
+			else
+			{
+				++k ;
+				kmers[k] = kmers[i] ;
+				counts.push_back( 1 ) ;
+			}
+		}
+		kmers.resize( k + 1 ) ;
+	}
+
+	int Size()
+	{
+		return counts.size() ;
+	}
+
+	T GetKmer( int ind )
+	{
+		return kmers[ind] ;
+	}
+
+	int GetCount( int ind )
+	{
+		return counts[ind] ;
+	}
+
+	// Return the index of the kmer, -1 if it does not exist.
+	// The binary search has no branch in the loop.
+	int Find( T kmer )
+	{
+		int n = counts.size() ;
+		if ( n == 0 )
+			return -1 ;
+		const T *base = &kmers[0] ;
+		while ( n > 1 )
+		{
+			int half = n / 2 ;
+			base = ( base[half] <= kmer ) ? base + half : base ;
+			n -= half ;
+		}
+		if ( *base == kmer )
+			return base - &kmers[0] ;
+		return -1 ;
+	}
+
+	bool IsIn( T kmer )
+	{
+		return Find( kmer ) != -1 ;
+	}
+
+	int GetKmerCount( T kmer )
+	{
+		int ind = Find( kmer ) ;
+		if ( ind == -1 )
+			return 0 ;
+		return counts[ind] ;
+	}
+} ;
+
+#endif
@@ -7,13 +7,16 @@
 extern char nucToNum[26] ;
 extern char numToNuc[26] ;
 
+// The word type decides the largest kmer we can hold: 
+// uint64_t for kmer length<=32, unsigned __int128 for kmer length<=64.
+template <typename T>
 class KmerCode
 {
 	private:
 		int kmerLength ;
 		int invalidPos ; // The position contains characters other than A,C,G,T in the code
-		uint64_t code ;
-		uint64_t mask ;
+		T code ;
+		T mask ;
 	public: 
 		KmerCode() 
 		{
@@ -41,16 +44,18 @@ class KmerCode
 			code = in.code ;
 		}
 
-		void Restart() { code = 0ull ; invalidPos = -1 ; } 
-		uint64_t GetCode() { return code ; } 
-		uint64_t GetCanonicalKmerCode()
+		static int GetMaxKmerLength() { return sizeof( T ) * 4 ; }
+
+		void Restart() { code = 0 ; invalidPos = -1 ; } 
+		T GetCode() { return code ; } 
+		T GetCanonicalKmerCode()
 		{
 			int i ;
-			uint64_t crCode = 0ull ; // complementary code
+			T crCode = 0 ; // complementary code
 			for ( i = 0 ; i < kmerLength ; ++i )
 			{
-				uint64_t tmp = ( code >> ( 2ull * i ) ) & 3ull ;
-				crCode = ( crCode << 2ull ) | ( 3ull - tmp ) ;
+				T tmp = ( code >> ( 2 * i ) ) & (T)3 ;
+				crCode = ( crCode << 2 ) | ( (T)3 - tmp ) ;
 			}
 			return crCode < code ? crCode : code ;
 		}
@@ -74,8 +79,8 @@ class KmerCode
 			if ( c >= 'a' && c <= 'z' )
 				c = c - 'a' + 'A' ;
 
-			code = ( ( code << 2ull ) & mask ) | 
-				( (uint64_t)( nucToNum[ c - 'A' ] & 3 ) ) ;
+			code = ( ( code << 2 ) & mask ) | 
+				( (T)( nucToNum[ c - 'A' ] & 3 ) ) ;
 
 			if ( nucToNum[c - 'A'] == -1 )
 			{
@@ -94,7 +99,7 @@ class KmerCode
 			{
 				invalidPos = kmerLength - 1 ;
 			}
-			code = ( code | ( (uint64_t)( nucToNum[c - 'A'] & 3 ) << ( 2ull * ( kmerLength - 1 ) ) ) ) & mask ;
+			code = ( code | ( (T)( nucToNum[c - 'A'] & 3 ) << ( 2 * ( kmerLength - 1 ) ) ) ) & mask ;
 		}
 
 		inline void ShiftRight( int k ) 
@@ -102,7 +107,7 @@ class KmerCode
 			if ( invalidPos != -1 )
 				invalidPos -= k ;
 
-			code = ( code >> ( 2ull * k ) ) & ( mask >> ( 2ull * k ) ) ;	
+			code = ( code >> ( 2 * k ) ) & ( mask >> ( 2 * k ) ) ;	
 
 			if ( invalidPos < 0 )
 				invalidPos = -1 ;
@@ -0,0 +1,182 @@
+// The buffered writer for the large output files
+// Li Song
+
+#ifndef _LSONG_RSCAF_OUTPUTWRITER_HEADER
+#define _LSONG_RSCAF_OUTPUTWRITER_HEADER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define OUTPUT_WRITER_BUFFER_SIZE ( 1 << 20 )
+
+// The text is formatted into a large buffer. When it is full, a background thread writes it
+// to the file while the caller fills the other buffer. The writer appends to the FILE,
+// so the file should not be written elsewhere before Flush().
+class OutputWriter
+{
+private:
+	FILE *fp ;
+	char *buffers[2] ;
+	int bufferSize ;
+	int current ; // the buffer being filled
+	int used ;
+
+	pthread_t thread ;
+	bool writing ; // whether the other buffer is being written
+	char *pending ;
+	int pendingLen ;
+	bool failed ;
+
+	static void *Write_Thread( void *arg )
+	{
+		OutputWriter *writer = (OutputWriter *)arg ;
+		if ( fwrite( writer->pending, 1, writer->pendingLen, writer->fp ) != (size_t)writer->pendingLen )
+			writer->failed = true ;
+		pthread_exit( NULL ) ;
+		return NULL ;
+	}
+
+	void Wait()
+	{
+		if ( !writing )
+			return ;
+		pthread_join( thread, NULL ) ;
+		writing = false ;
+		if ( failed )
+		{
+			fprintf( stderr, "Failed to write the output.\n" ) ;
+			exit( 1 ) ;
+		}
+	}
+
+	// Hand the current buffer to the background thread.
+	void Submit()
+	{
+		Wait() ;
+		if ( used == 0 )
+			return ;
+		pending = buffers[ current ] ;
+		pendingLen = used ;
+		if ( pthread_create( &thread, NULL, Write_Thread, (void *)this ) )
+		{
+			// Write it in this thread then.
+			if ( fwrite( pending, 1, pendingLen, fp ) != (size_t)pendingLen )
+			{
+				fprintf( stderr, "Failed to write the output.\n" ) ;
+				exit( 1 ) ;
+			}
+		}
+		else
+			writing = true ;
+		current = 1 - current ;
+		used = 0 ;
+	}
+
+	void Reserve( int len )
+	{
+		if ( used + len > bufferSize )
+			Submit() ;
+	}
+public:
+	OutputWriter( FILE *f, int size = OUTPUT_WRITER_BUFFER_SIZE )
+	{
+		fp = f ;
+		bufferSize = size < 64 ? 64 : size ;
+		buffers[0] = new char[ bufferSize ] ;
+		buffers[1] = new char[ bufferSize ] ;
+		current = 0 ;
+		used = 0 ;
+		writing = false ;
+		failed = false ;
+	}
+
+	~OutputWriter()
+	{
+		Flush() ;
+		delete[] buffers[0] ;
+		delete[] buffers[1] ;
+	}
+
+	// Write out everything, after that the FILE can be used directly again.
+	void Flush()
+	{
+		Submit() ;
+		Wait() ;
+		fflush( fp ) ;
+	}
+
+	void PutChar( char c )
+	{
+		if ( used >= bufferSize )
+			Submit() ;
+		buffers[ current ][ used++ ] = c ;
+	}
+
+	void PutBytes( const char *s, int len )
+	{
+		while ( len > 0 )
+		{
+			if ( used >= bufferSize )
+				Submit() ;
+			int l = bufferSize - used ;
+			if ( l > len )
+				l = len ;
+			memcpy( buffers[ current ] + used, s, l ) ;
+			used += l ;
+			s += l ;
+			len -= l ;
+		}
+	}
+
+	void PutString( const char *s )
+	{
+		PutBytes( s, strlen( s ) ) ;
+	}
+
+	void PutInt( int64_t v )
+	{
+		char digits[24] ;
+		int len = 0 ;
+		uint64_t u = v < 0 ? -(uint64_t)v : (uint64_t)v ;
+		do
+		{
+			digits[ len++ ] = '0' + u % 10 ;
+			u /= 10 ;
+		} while ( u > 0 ) ;
+		Reserve( len + 1 ) ;
+		char *p = buffers[ current ] + used ;
+		if ( v < 0 )
+			*p++ = '-' ;
+		while ( len > 0 )
+			*p++ = digits[ --len ] ;
+		used = p - buffers[ current ] ;
+	}
+
+	// For the rare formats the Put functions do not cover.
+	void Printf( const char *fmt, ... )
+	{
+		va_list args ;
+		va_start( args, fmt ) ;
+		int len = vsnprintf( buffers[ current ] + used, bufferSize - used, fmt, args ) ;
+		va_end( args ) ;
+		if ( used + len < bufferSize )
+		{
+			used += len ;
+			return ;
+		}
+
+		// It did not fit.
+		char *s = new char[ len + 1 ] ;
+		va_start( args, fmt ) ;
+		vsnprintf( s, len + 1, fmt, args ) ;
+		va_end( args ) ;
+		PutBytes( s, len ) ;
+		delete[] s ;
+	}
+} ;
+
+#endif
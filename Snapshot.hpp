@@ -0,0 +1,114 @@
+// The helper functions for writing and reading the binary snapshots of the pipeline stages
+// Li Song
+
+#ifndef _LSONG_RSCAF_SNAPSHOT_HEADER
+#define _LSONG_RSCAF_SNAPSHOT_HEADER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+// Bump the version whenever the layout of a saved structure changes,
+// the snapshots from other versions are rejected.
+#define SNAPSHOT_MAGIC "RSCFSNAP"
+#define SNAPSHOT_VERSION 5
+
+// The stages after which a snapshot can be taken, in the order of the pipeline.
+#define STAGE_NONE 0
+#define STAGE_EXON_BLOCK 1
+#define STAGE_GENE_BLOCK 2
+#define STAGE_GRAPH 3
+#define STAGE_CLEAN_GRAPH 4
+#define STAGE_COMPONENT 5
+
+const char *stageNames[] = { "none", "exonblock", "geneblock", "graph", "cleangraph", "component" } ;
+
+// Return the stage id of the name, -1 if it is unknown.
+int GetStageId( const char *name )
+{
+	for ( int i = STAGE_EXON_BLOCK ; i <= STAGE_COMPONENT ; ++i )
+		if ( !strcmp( name, stageNames[i] ) )
+			return i ;
+	return -1 ;
+}
+
+void SnapshotWrite( FILE *fp, const void *p, size_t size, size_t cnt )
+{
+	if ( cnt > 0 && fwrite( p, size, cnt, fp ) != cnt )
+	{
+		fprintf( stderr, "Failed to write the snapshot.\n" ) ;
+		exit( 1 ) ;
+	}
+}
+
+void SnapshotRead( FILE *fp, void *p, size_t size, size_t cnt )
+{
+	if ( cnt > 0 && fread( p, size, cnt, fp ) != cnt )
+	{
+		fprintf( stderr, "The snapshot is truncated.\n" ) ;
+		exit( 1 ) ;
+	}
+}
+
+// The elements are written as raw bytes, so T must not hold pointers.
+template <typename T>
+void SnapshotWriteVector( FILE *fp, const std::vector<T> &v )
+{
+	int64_t size = v.size() ;
+	SnapshotWrite( fp, &size, sizeof( size ), 1 ) ;
+	if ( size > 0 )
+		SnapshotWrite( fp, &v[0], sizeof( T ), size ) ;
+}
+
+template <typename T>
+void SnapshotReadVector( FILE *fp, std::vector<T> &v )
+{
+	int64_t size ;
+	SnapshotRead( fp, &size, sizeof( size ), 1 ) ;
+	if ( size < 0 )
+	{
+		fprintf( stderr, "The snapshot is corrupted.\n" ) ;
+		exit( 1 ) ;
+	}
+	v.resize( size ) ;
+	if ( size > 0 )
+		SnapshotRead( fp, &v[0], sizeof( T ), size ) ;
+}
+
+void SnapshotWriteHeader( FILE *fp, int stage )
+{
+	int version = SNAPSHOT_VERSION ;
+	SnapshotWrite( fp, SNAPSHOT_MAGIC, 1, 8 ) ;
+	SnapshotWrite( fp, &version, sizeof( version ), 1 ) ;
+	SnapshotWrite( fp, &stage, sizeof( stage ), 1 ) ;
+}
+
+// Check the header and return the stage of the snapshot.
+int SnapshotReadHeader( FILE *fp )
+{
+	char magic[8] ;
+	int version, stage ;
+	SnapshotRead( fp, magic, 1, 8 ) ;
+	if ( memcmp( magic, SNAPSHOT_MAGIC, 8 ) )
+	{
+		fprintf( stderr, "The file is not a rascaf snapshot.\n" ) ;
+		exit( 1 ) ;
+	}
+	SnapshotRead( fp, &version, sizeof( version ), 1 ) ;
+	if ( version != SNAPSHOT_VERSION )
+	{
+		fprintf( stderr, "The snapshot version %d does not match the program's version %d.\n", version, SNAPSHOT_VERSION ) ;
+		exit( 1 ) ;
+	}
+	SnapshotRead( fp, &stage, sizeof( stage ), 1 ) ;
+	if ( stage < STAGE_EXON_BLOCK || stage > STAGE_COMPONENT )
+	{
+		fprintf( stderr, "The snapshot is corrupted.\n" ) ;
+		exit( 1 ) ;
+	}
+	return stage ;
+}
+
+#endif
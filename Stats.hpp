@@ -0,0 +1,175 @@
+// The per-stage time, memory and counters of a run, written as JSON by -stats
+// Li Song
+
+#ifndef _LSONG_RSCAF_STATS_HEADER
+#define _LSONG_RSCAF_STATS_HEADER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <vector>
+#include <string>
+
+struct _stageStat
+{
+	std::string name ;
+	double wallTime ; // in seconds
+	double cpuTime ; // in seconds, all the threads and the waited child processes
+	long maxRss ; // the peak RSS of the process up to the end of the stage, in KB
+	std::vector< std::pair<std::string, int64_t> > counters ;
+} ;
+
+// Each stage costs two clock reads and two getrusage calls, so it is kept on all the time,
+// and the counters are filled in by the caller from the cheap counters of the other classes.
+class Stats
+{
+private:
+	std::vector<struct _stageStat> stages ;
+	double wallStart ;
+	double cpuStart ;
+	bool inStage ;
+
+	static double GetWallTime()
+	{
+		struct timespec t ;
+		clock_gettime( CLOCK_MONOTONIC, &t ) ;
+		return t.tv_sec + t.tv_nsec / 1e9 ;
+	}
+
+	static double GetCpuTime()
+	{
+		struct rusage self, children ;
+		getrusage( RUSAGE_SELF, &self ) ;
+		getrusage( RUSAGE_CHILDREN, &children ) ;
+		return self.ru_utime.tv_sec + self.ru_utime.tv_usec / 1e6 + self.ru_stime.tv_sec + self.ru_stime.tv_usec / 1e6
+			+ children.ru_utime.tv_sec + children.ru_utime.tv_usec / 1e6 + children.ru_stime.tv_sec + children.ru_stime.tv_usec / 1e6 ;
+	}
+
+	static long GetMaxRss()
+	{
+		struct rusage self ;
+		getrusage( RUSAGE_SELF, &self ) ;
+		return self.ru_maxrss ;
+	}
+
+	static void OutputString( FILE *fp, const char *s )
+	{
+		fputc( '"', fp ) ;
+		for ( ; *s ; ++s )
+		{
+			if ( *s == '"' || *s == '\\' )
+				fprintf( fp, "\\%c", *s ) ;
+			else if ( (unsigned char)*s < 0x20 )
+				fprintf( fp, "\\u%04x", *s ) ;
+			else
+				fputc( *s, fp ) ;
+		}
+		fputc( '"', fp ) ;
+	}
+public:
+	Stats()
+	{
+		inStage = false ;
+	}
+
+	void BeginStage( const char *name )
+	{
+		if ( inStage )
+			EndStage() ;
+		struct _stageStat s ;
+		s.name = name ;
+		s.wallTime = s.cpuTime = 0 ;
+		s.maxRss = 0 ;
+		stages.push_back( s ) ;
+		inStage = true ;
+		wallStart = GetWallTime() ;
+		cpuStart = GetCpuTime() ;
+	}
+
+	void EndStage()
+	{
+		if ( !inStage )
+			return ;
+		struct _stageStat &s = stages.back() ;
+		s.wallTime = GetWallTime() - wallStart ;
+		s.cpuTime = GetCpuTime() - cpuStart ;
+		s.maxRss = GetMaxRss() ;
+		inStage = false ;
+	}
+
+	// Discard the stage being recorded.
+	void DropStage()
+	{
+		if ( !inStage )
+			return ;
+		stages.pop_back() ;
+		inStage = false ;
+	}
+
+	// Add the counter to the last stage, the counters with the same name are summed.
+	void AddCounter( const char *name, int64_t value )
+	{
+		if ( stages.size() == 0 )
+			return ;
+		std::vector< std::pair<std::string, int64_t> > &counters = stages.back().counters ;
+		int size = counters.size() ;
+		for ( int i = 0 ; i < size ; ++i )
+			if ( counters[i].first == name )
+			{
+				counters[i].second += value ;
+				return ;
+			}
+		counters.push_back( std::pair<std::string, int64_t>( name, value ) ) ;
+	}
+
+	void Output( const char *file, const char *program )
+	{
+		EndStage() ;
+		FILE *fp = fopen( file, "w" ) ;
+		if ( fp == NULL )
+		{
+			fprintf( stderr, "Can not open %s.\n", file ) ;
+			exit( 1 ) ;
+		}
+
+		int i, j ;
+		int size = stages.size() ;
+		double wallTime = 0, cpuTime = 0 ;
+		long maxRss = 0 ;
+		for ( i = 0 ; i < size ; ++i )
+		{
+			wallTime += stages[i].wallTime ;
+			cpuTime += stages[i].cpuTime ;
+			if ( stages[i].maxRss > maxRss )
+				maxRss = stages[i].maxRss ;
+		}
+
+		fprintf( fp, "{\n\t\"program\": " ) ;
+		OutputString( fp, program ) ;
+		fprintf( fp, ",\n\t\"wall_time\": %.6lf,\n\t\"cpu_time\": %.6lf,\n\t\"max_rss_kb\": %ld,\n\t\"stages\": [",
+			wallTime, cpuTime, maxRss ) ;
+		for ( i = 0 ; i < size ; ++i )
+		{
+			struct _stageStat &s = stages[i] ;
+			fprintf( fp, "%s\n\t\t{\n\t\t\t\"name\": ", i > 0 ? "," : "" ) ;
+			OutputString( fp, s.name.c_str() ) ;
+			fprintf( fp, ",\n\t\t\t\"wall_time\": %.6lf,\n\t\t\t\"cpu_time\": %.6lf,\n\t\t\t\"max_rss_kb\": %ld,\n\t\t\t\"counters\": {",
+				s.wallTime, s.cpuTime, s.maxRss ) ;
+			int cnt = s.counters.size() ;
+			for ( j = 0 ; j < cnt ; ++j )
+			{
+				fprintf( fp, "%s\n\t\t\t\t", j > 0 ? "," : "" ) ;
+				OutputString( fp, s.counters[j].first.c_str() ) ;
+				fprintf( fp, ": %lld", (long long)s.counters[j].second ) ;
+			}
+			fprintf( fp, "%s}\n\t\t}", cnt > 0 ? "\n\t\t\t" : "" ) ;
+		}
+		fprintf( fp, "%s]\n}\n", size > 0 ? "\n\t" : "" ) ;
+		fclose( fp ) ;
+	}
+} ;
+
+#endif
@@ -0,0 +1,296 @@
+// The thread pool running batches of independent tasks with work stealing
+// Li Song
+
+#ifndef _LSONG_RSCAF_THREADPOOL_HEADER
+#define _LSONG_RSCAF_THREADPOOL_HEADER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+// A chunk is a consecutive range of tasks [from, to]
+struct _threadPoolChunk
+{
+	int from, to ;
+	int64_t cost ;
+} ;
+
+bool CompThreadPoolChunk( const struct _threadPoolChunk &c1, const struct _threadPoolChunk &c2 )
+{
+	return c1.cost > c2.cost ;
+}
+
+class ThreadPool
+{
+private:
+	struct _threadArg
+	{
+		ThreadPool *pool ;
+		int threadId ;
+	} ;
+
+	int threadCnt ;
+
+	// Each thread owns a queue of chunks sorted by decreasing cost.
+	// The owner takes from the head, and the idle threads steal from the tail.
+	std::vector<struct _threadPoolChunk> *queues ;
+	int *heads ;
+	int *tails ;
+	pthread_mutex_t *locks ;
+
+	void (*func)( int taskId, int threadId, void *arg ) ;
+	void *funcArg ;
+
+	// The workers are created by the first batch and wait for the next one,
+	// so a caller running many small batches does not pay the thread creation each time.
+	pthread_t *threads ;
+	struct _threadArg *threadArgs ;
+	pthread_mutex_t runLock ;
+	pthread_cond_t runCond ; // a new batch is started, or quit
+	pthread_cond_t doneCond ; // all the workers finished the batch
+	int generation ; // the number of batches started
+	int runningCnt ; // the number of workers still on the current batch
+	bool quit ;
+
+	bool GetChunk( int threadId, struct _threadPoolChunk &chunk )
+	{
+		int i ;
+		bool ret = false ;
+
+		pthread_mutex_lock( &locks[ threadId ] ) ;
+		if ( heads[ threadId ] < tails[ threadId ] )
+		{
+			chunk = queues[ threadId ][ heads[ threadId ] ] ;
+			++heads[ threadId ] ;
+			ret = true ;
+		}
+		pthread_mutex_unlock( &locks[ threadId ] ) ;
+		if ( ret )
+			return true ;
+
+		// Steal from the other threads.
+		for ( i = 1 ; i < threadCnt && !ret ; ++i )
+		{
+			int victim = ( threadId + i ) % threadCnt ;
+			pthread_mutex_lock( &locks[ victim ] ) ;
+			if ( heads[ victim ] < tails[ victim ] )
+			{
+				--tails[ victim ] ;
+				chunk = queues[ victim ][ tails[ victim ] ] ;
+				ret = true ;
+			}
+			pthread_mutex_unlock( &locks[ victim ] ) ;
+		}
+		return ret ;
+	}
+
+	static void *Worker( void *arg )
+	{
+		struct _threadArg *threadArg = (struct _threadArg *)arg ;
+		ThreadPool *pool = threadArg->pool ;
+		int threadId = threadArg->threadId ;
+		struct _threadPoolChunk chunk ;
+		int seen = 0 ;
+
+		while ( 1 )
+		{
+			pthread_mutex_lock( &pool->runLock ) ;
+			while ( pool->generation == seen && !pool->quit )
+				pthread_cond_wait( &pool->runCond, &pool->runLock ) ;
+			if ( pool->quit )
+			{
+				pthread_mutex_unlock( &pool->runLock ) ;
+				break ;
+			}
+			seen = pool->generation ;
+			pthread_mutex_unlock( &pool->runLock ) ;
+
+			while ( pool->GetChunk( threadId, chunk ) )
+			{
+				for ( int i = chunk.from ; i <= chunk.to ; ++i )
+					pool->func( i, threadId, pool->funcArg ) ;
+			}
+
+			pthread_mutex_lock( &pool->runLock ) ;
+			--pool->runningCnt ;
+			if ( pool->runningCnt == 0 )
+				pthread_cond_signal( &pool->doneCond ) ;
+			pthread_mutex_unlock( &pool->runLock ) ;
+		}
+		pthread_exit( NULL ) ;
+		return NULL ;
+	}
+
+public:
+	ThreadPool( int tc )
+	{
+		threadCnt = tc < 1 ? 1 : tc ;
+		queues = new std::vector<struct _threadPoolChunk>[ threadCnt ] ;
+		heads = new int[ threadCnt ] ;
+		tails = new int[ threadCnt ] ;
+		locks = new pthread_mutex_t[ threadCnt ] ;
+		for ( int i = 0 ; i < threadCnt ; ++i )
+			pthread_mutex_init( &locks[i], NULL ) ;
+
+		threads = NULL ;
+		threadArgs = NULL ;
+		pthread_mutex_init( &runLock, NULL ) ;
+		pthread_cond_init( &runCond, NULL ) ;
+		pthread_cond_init( &doneCond, NULL ) ;
+		generation = 0 ;
+		runningCnt = 0 ;
+		quit = false ;
+	}
+
+	~ThreadPool()
+	{
+		int i ;
+		if ( threads != NULL )
+		{
+			Wait() ;
+			pthread_mutex_lock( &runLock ) ;
+			quit = true ;
+			pthread_cond_broadcast( &runCond ) ;
+			pthread_mutex_unlock( &runLock ) ;
+			for ( i = 0 ; i < threadCnt ; ++i )
+				pthread_join( threads[i], NULL ) ;
+			delete[] threads ;
+			delete[] threadArgs ;
+		}
+		pthread_mutex_destroy( &runLock ) ;
+		pthread_cond_destroy( &runCond ) ;
+		pthread_cond_destroy( &doneCond ) ;
+
+		for ( i = 0 ; i < threadCnt ; ++i )
+			pthread_mutex_destroy( &locks[i] ) ;
+		delete[] queues ;
+		delete[] heads ;
+		delete[] tails ;
+		delete[] locks ;
+	}
+
+	int GetThreadCount()
+	{
+		return threadCnt ;
+	}
+
+	// Run f( taskId, threadId, arg ) for every task in [0, taskCnt).
+	// The tasks are grouped into chunks of roughly equal total cost, so a few expensive tasks
+	// do not hold one thread while the others are idle. taskCost can be NULL for unit cost.
+	void Run( int taskCnt, const int64_t *taskCost, void (*f)( int taskId, int threadId, void *arg ), void *arg, int chunkPerThread = 8 )
+	{
+		Start( taskCnt, taskCost, f, arg, chunkPerThread ) ;
+		Wait() ;
+	}
+
+	// The same as Run, but return without waiting for the tasks, so the caller can prepare 
+	// the next batch meanwhile. Call Wait() before touching anything the tasks use.
+	// With one thread, the tasks are run here.
+	void Start( int taskCnt, const int64_t *taskCost, void (*f)( int taskId, int threadId, void *arg ), void *arg, int chunkPerThread = 8 )
+	{
+		int i ;
+		Wait() ; // the queues are still used by the previous batch otherwise
+		if ( taskCnt <= 0 )
+			return ;
+
+		if ( threadCnt == 1 )
+		{
+			for ( i = 0 ; i < taskCnt ; ++i )
+				f( i, 0, arg ) ;
+			return ;
+		}
+
+		func = f ;
+		funcArg = arg ;
+
+		// Build the chunks
+		int64_t totalCost = 0 ;
+		for ( i = 0 ; i < taskCnt ; ++i )
+			totalCost += ( taskCost == NULL ? 1 : taskCost[i] ) ;
+		int64_t chunkCost = totalCost / ( (int64_t)threadCnt * chunkPerThread ) ;
+		if ( chunkCost < 1 )
+			chunkCost = 1 ;
+
+		std::vector<struct _threadPoolChunk> chunks ;
+		struct _threadPoolChunk chunk ;
+		chunk.from = 0 ;
+		chunk.cost = 0 ;
+		for ( i = 0 ; i < taskCnt ; ++i )
+		{
+			chunk.cost += ( taskCost == NULL ? 1 : taskCost[i] ) ;
+			if ( chunk.cost >= chunkCost || i == taskCnt - 1 )
+			{
+				chunk.to = i ;
+				chunks.push_back( chunk ) ;
+				chunk.from = i + 1 ;
+				chunk.cost = 0 ;
+			}
+		}
+
+		// Assign the expensive chunks first, each to the least loaded thread.
+		std::stable_sort( chunks.begin(), chunks.end(), CompThreadPoolChunk ) ;
+		int64_t *load = new int64_t[ threadCnt ] ;
+		for ( i = 0 ; i < threadCnt ; ++i )
+		{
+			queues[i].clear() ;
+			load[i] = 0 ;
+		}
+		int chunkCnt = chunks.size() ;
+		for ( i = 0 ; i < chunkCnt ; ++i )
+		{
+			int min = 0 ;
+			for ( int j = 1 ; j < threadCnt ; ++j )
+				if ( load[j] < load[min] )
+					min = j ;
+			queues[min].push_back( chunks[i] ) ;
+			load[min] += chunks[i].cost ;
+		}
+		delete[] load ;
+
+		for ( i = 0 ; i < threadCnt ; ++i )
+		{
+			heads[i] = 0 ;
+			tails[i] = queues[i].size() ;
+		}
+
+		if ( threads == NULL )
+		{
+			threads = new pthread_t[ threadCnt ] ;
+			threadArgs = new struct _threadArg[ threadCnt ] ;
+			pthread_attr_t attr ;
+			pthread_attr_init( &attr ) ;
+			pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE ) ;
+			for ( i = 0 ; i < threadCnt ; ++i )
+			{
+				threadArgs[i].pool = this ;
+				threadArgs[i].threadId = i ;
+				if ( pthread_create( &threads[i], &attr, Worker, (void *)&threadArgs[i] ) )
+				{
+					fprintf( stderr, "Failed to create threads.\n" ) ;
+					exit( 1 ) ;
+				}
+			}
+			pthread_attr_destroy( &attr ) ;
+		}
+
+		pthread_mutex_lock( &runLock ) ;
+		runningCnt = threadCnt ;
+		++generation ;
+		pthread_cond_broadcast( &runCond ) ;
+		pthread_mutex_unlock( &runLock ) ;
+	}
+
+	// Wait for the tasks of the last Start.
+	void Wait()
+	{
+		pthread_mutex_lock( &runLock ) ;
+		while ( runningCnt > 0 )
+			pthread_cond_wait( &doneCond, &runLock ) ;
+		pthread_mutex_unlock( &runLock ) ;
+	}
+} ;
+
+#endif
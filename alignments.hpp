@@ -9,9 +9,32 @@
 #include <assert.h>
 #include <iostream>
 #include <stdio.h>
+#include <string.h>
 
 #include "defs.h"
 
+// The fields of an alignment used by Support, so the alignment can still be 
+// counted after the reader moved to the next one.
+struct _alignmentSummary
+{
+	int64_t start, end ; // the start of the first segment and the end of the last segment
+	double strandWeight ;
+	int nm ;
+	int strand ;
+	bool unique ;
+	bool hasSA ;
+} ;
+
+// The number of alignments read by Next() and the ones rejected by each of its filters
+struct _readStat
+{
+	int64_t consumed ;
+	int64_t flag ; // unmapped, or the mate is unmapped
+	int64_t lowComplexity ;
+	int64_t secondary ; // secondary or supplementary
+	int64_t mateIncompatible ; // the mate is in an intron of the read
+} ;
+
 class Alignments
 {
 private:
@@ -23,6 +46,7 @@ private:
 	std::map<std::string, int> chrNameToId ;
 	bool allowSupplementary ;
 	double strandWeight ; // the weight of this alignment when considering strand.
+	struct _readStat readStat ;
 
 	void Open()
 	{
@@ -53,7 +77,7 @@ public:
 	struct _pair segments[MAX_SEG_COUNT] ;		
 	unsigned int segCnt ;
 
-	Alignments() { b = NULL ; opened = false ; allowSupplementary = false ;}
+	Alignments() { b = NULL ; opened = false ; allowSupplementary = false ; ClearReadStat() ; }
 	~Alignments() 
 	{
 		if ( b )
@@ -104,8 +128,12 @@ public:
 
 				if ( samread( fpSam, b ) <= 0 )
 					return 0 ;
+				++readStat.consumed ;
 				if ( b->core.flag & 0xC )
+				{
+					++readStat.flag ;
 					continue ;
+				}
 				// ignore low-complexity sequence
 				int count[16] ;
 				count[1] = count[2] = count[4] = count[8] = count[15] = 0 ;
@@ -130,7 +158,10 @@ public:
 				if ( count[1] >= threshold || count[2] >= threshold 
 					|| count[4] >= threshold || count[8] >= threshold 
 					|| count[15] >= threshold )
+				{
+					++readStat.lowComplexity ;
 					continue ;
+				}
 
 				if ( allowSupplementary )
 				{
@@ -142,6 +173,7 @@ public:
 					if ( ( b->core.flag & 0x900 ) == 0 )
 						break ;
 				}
+				++readStat.secondary ;
 			}
 			// Compute the exons segments from the reads
 			segCnt = 0 ;
@@ -204,7 +236,10 @@ public:
 						break ;
 				}
 				if ( i < segCnt - 1 )
+				{
+					++readStat.mateIncompatible ;
 					continue ;
+				}
 			}
 			
 			break ;
@@ -214,6 +249,16 @@ public:
 	}
 
 
+	const struct _readStat &GetReadStat()
+	{
+		return readStat ;
+	}
+
+	void ClearReadStat()
+	{
+		memset( &readStat, 0, sizeof( readStat ) ) ;
+	}
+
 	int GetChromId()
 	{
 		return b->core.tid ; 
@@ -235,6 +280,11 @@ public:
 		return chrNameToId[ss] ;
 	}
 
+	int GetChromCount()
+	{
+		return fpSam->header->n_targets ;
+	}
+
 	int GetChromLength( int tid )
 	{
 		return fpSam->header->target_len[ tid ] ;
@@ -311,7 +361,7 @@ public:
 			return 0 ;
 	}
 
-	int GetFieldI( char *f )
+	int GetFieldI( const char *f )
 	{
 		if ( bam_aux_get( b, f ) )
 		{
@@ -320,7 +370,7 @@ public:
 		return -1 ;
 	}
 
-	char *GetFieldZ( char *f )
+	char *GetFieldZ( const char *f )
 	{
 		if ( bam_aux_get( b, f ) )
 		{
@@ -329,6 +379,17 @@ public:
 		return NULL ;
 	}
 	
+	void GetSummary( struct _alignmentSummary &summary )
+	{
+		summary.start = segments[0].a ;
+		summary.end = segments[ segCnt - 1 ].b ;
+		summary.strandWeight = GetStrandWeight() ;
+		summary.nm = GetFieldI( "NM" ) ;
+		summary.strand = GetStrand() ;
+		summary.unique = IsUnique() ;
+		summary.hasSA = ( GetFieldZ( "SA" ) != NULL ) ;
+	}
+
 	bool IsSupplementary()
 	{
 		if ( ( b->core.flag & 0x800 ) == 0 )
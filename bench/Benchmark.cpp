@@ -0,0 +1,308 @@
+// Run rascaf and rascaf-join on the simulated assemblies of several scales,
+// and report the time and the peak memory of each run and each of its stages, and the accuracy of the connections
+// Li Song
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <vector>
+#include <set>
+#include <map>
+#include <string>
+#include <algorithm>
+
+char usage[] = "usage: rascaf-bench [options]\n"
+	       "options:\n"
+	       "\t-scales STRING: comma-separated list of the numbers of genes to simulate (default: 500,2000,8000)\n"
+	       "\t-n50 INT: the N50 of the simulated contigs (default: 20000)\n"
+	       "\t-d FLOAT: the scale of the read depth (default: 1.0)\n"
+	       "\t-t INT: number of threads for rascaf (default: 1)\n"
+	       "\t-seed INT: random seed of the simulation (default: 17)\n"
+	       "\t-dir STRING: the directory for the simulated data and the outputs (default: bench_data)\n"
+	       "\t-bin STRING: the directory holding rascaf, rascaf-join and bench/simulate-assembly (default: .)\n" ;
+
+struct _runStat
+{
+	double wallTime ;
+	double cpuTime ;
+	long maxRss ; // in KB
+} ;
+
+// Run the command and wait for it, its stdout and stderr go to logFile.
+struct _runStat Run( std::vector<std::string> &args, const char *logFile )
+{
+	struct _runStat stat ;
+	struct timeval start, end ;
+	gettimeofday( &start, NULL ) ;
+
+	pid_t pid = fork() ;
+	if ( pid < 0 )
+	{
+		fprintf( stderr, "Failed to fork.\n" ) ;
+		exit( 1 ) ;
+	}
+	if ( pid == 0 )
+	{
+		FILE *fp = fopen( logFile, "w" ) ;
+		if ( fp != NULL )
+		{
+			dup2( fileno( fp ), 1 ) ;
+			dup2( fileno( fp ), 2 ) ;
+		}
+		std::vector<char *> argv ;
+		for ( size_t i = 0 ; i < args.size() ; ++i )
+			argv.push_back( (char *)args[i].c_str() ) ;
+		argv.push_back( NULL ) ;
+		execv( argv[0], &argv[0] ) ;
+		fprintf( stderr, "Failed to run %s.\n", argv[0] ) ;
+		_exit( 127 ) ;
+	}
+
+	int status ;
+	struct rusage usage ;
+	if ( wait4( pid, &status, 0, &usage ) < 0 )
+	{
+		fprintf( stderr, "Failed to wait for %s.\n", args[0].c_str() ) ;
+		exit( 1 ) ;
+	}
+	gettimeofday( &end, NULL ) ;
+	if ( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+	{
+		fprintf( stderr, "%s failed, see %s.\n", args[0].c_str(), logFile ) ;
+		exit( 1 ) ;
+	}
+
+	stat.wallTime = ( end.tv_sec - start.tv_sec ) + ( end.tv_usec - start.tv_usec ) / 1e6 ;
+	stat.cpuTime = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+		+ usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6 ;
+	stat.maxRss = usage.ru_maxrss ;
+	return stat ;
+}
+
+// Read the connections from the scaffold lines of rascaf's output:
+// "N: (chrom length contigId orientation) (chrom length contigId orientation) ..."
+void ReadConnections( const char *file, std::set< std::pair<int, int> > &connections )
+{
+	FILE *fp = fopen( file, "r" ) ;
+	if ( fp == NULL )
+	{
+		fprintf( stderr, "Can not open %s.\n", file ) ;
+		exit( 1 ) ;
+	}
+	char line[65536] ;
+	while ( fgets( line, sizeof( line ), fp ) )
+	{
+		if ( line[0] < '0' || line[0] > '9' || strstr( line, ": (" ) == NULL )
+			continue ;
+		int prev = -1 ;
+		char *p = line ;
+		while ( ( p = strchr( p, '(' ) ) != NULL )
+		{
+			char chrom[1024], orientation ;
+			long length ;
+			int contigId ;
+			if ( sscanf( p + 1, "%1023s %ld %d %c", chrom, &length, &contigId, &orientation ) != 4 )
+				break ;
+			if ( prev != -1 )
+				connections.insert( std::make_pair( std::min( prev, contigId ), std::max( prev, contigId ) ) ) ;
+			prev = contigId ;
+			++p ;
+		}
+	}
+	fclose( fp ) ;
+}
+
+// The true connections, whose value tells whether the two contigs are in the same scaffold of the assembly.
+void ReadTruth( const char *file, std::map< std::pair<int, int>, int > &truth )
+{
+	FILE *fp = fopen( file, "r" ) ;
+	if ( fp == NULL )
+	{
+		fprintf( stderr, "Can not open %s.\n", file ) ;
+		exit( 1 ) ;
+	}
+	int a, b, same ;
+	while ( fscanf( fp, "%d %d %d", &a, &b, &same ) == 3 )
+		truth[ std::make_pair( a, b ) ] = same ;
+	fclose( fp ) ;
+}
+
+void PrintStat( const char *scale, const char *stage, const struct _runStat &stat )
+{
+	printf( "%-8s %-24s %10.2f %10.2f %12.1f\n", scale, stage, stat.wallTime, stat.cpuTime, stat.maxRss / 1024.0 ) ;
+	fflush( stdout ) ;
+}
+
+// The number after key in text, searching from position from.
+double ReadJsonNumber( const std::string &text, const char *key, size_t from )
+{
+	size_t p = text.find( key, from ) ;
+	if ( p == std::string::npos )
+		return 0 ;
+	return atof( text.c_str() + p + strlen( key ) ) ;
+}
+
+// Print one row for each stage in the -stats file of a run, as "program/stage".
+void PrintStageStats( const char *scale, const char *program, const char *file )
+{
+	FILE *fp = fopen( file, "r" ) ;
+	if ( fp == NULL )
+	{
+		fprintf( stderr, "Can not open %s.\n", file ) ;
+		exit( 1 ) ;
+	}
+	std::string text ;
+	char buffer[4096] ;
+	size_t len ;
+	while ( ( len = fread( buffer, 1, sizeof( buffer ), fp ) ) > 0 )
+		text.append( buffer, len ) ;
+	fclose( fp ) ;
+
+	// The stage names are plain words, so a scan of the fields is enough for the file written by -stats.
+	const char *nameKey = "\"name\": \"" ;
+	size_t p = text.find( "\"stages\"" ) ;
+	while ( p != std::string::npos && ( p = text.find( nameKey, p ) ) != std::string::npos )
+	{
+		p += strlen( nameKey ) ;
+		size_t end = text.find( '"', p ) ;
+		if ( end == std::string::npos )
+			break ;
+		std::string stage = std::string( program ) + "/" + text.substr( p, end - p ) ;
+		struct _runStat stat ;
+		stat.wallTime = ReadJsonNumber( text, "\"wall_time\": ", end ) ;
+		stat.cpuTime = ReadJsonNumber( text, "\"cpu_time\": ", end ) ;
+		stat.maxRss = (long)ReadJsonNumber( text, "\"max_rss_kb\": ", end ) ;
+		PrintStat( scale, stage.c_str(), stat ) ;
+		p = end ;
+	}
+}
+
+int main( int argc, char *argv[] )
+{
+	int i ;
+	std::string scales = "500,2000,8000" ;
+	std::string n50 = "20000" ;
+	std::string depth = "1.0" ;
+	std::string threads = "1" ;
+	std::string seed = "17" ;
+	std::string dir = "bench_data" ;
+	std::string bin = "." ;
+
+	for ( i = 1 ; i < argc ; ++i )
+	{
+		if ( i + 1 >= argc )
+		{
+			fprintf( stderr, "%s", usage ) ;
+			exit( 1 ) ;
+		}
+		if ( !strcmp( "-scales", argv[i] ) )
+			scales = argv[++i] ;
+		else if ( !strcmp( "-n50", argv[i] ) )
+			n50 = argv[++i] ;
+		else if ( !strcmp( "-d", argv[i] ) )
+			depth = argv[++i] ;
+		else if ( !strcmp( "-t", argv[i] ) )
+			threads = argv[++i] ;
+		else if ( !strcmp( "-seed", argv[i] ) )
+			seed = argv[++i] ;
+		else if ( !strcmp( "-dir", argv[i] ) )
+			dir = argv[++i] ;
+		else if ( !strcmp( "-bin", argv[i] ) )
+			bin = argv[++i] ;
+		else
+		{
+			fprintf( stderr, "Unknown option: %s\n%s", argv[i], usage ) ;
+			exit( 1 ) ;
+		}
+	}
+	mkdir( dir.c_str(), 0755 ) ;
+
+	std::vector<std::string> scaleList ;
+	size_t start = 0 ;
+	while ( start <= scales.length() )
+	{
+		size_t end = scales.find( ',', start ) ;
+		if ( end == std::string::npos )
+			end = scales.length() ;
+		if ( end > start )
+			scaleList.push_back( scales.substr( start, end - start ) ) ;
+		start = end + 1 ;
+	}
+
+	// The row of a program is the whole process, followed by the rows of its stages.
+	printf( "%-8s %-24s %10s %10s %12s\n", "genes", "stage", "wall(s)", "cpu(s)", "maxrss(MB)" ) ;
+	std::vector<std::string> accuracy ;
+	int scaleCnt = scaleList.size() ;
+	for ( i = 0 ; i < scaleCnt ; ++i )
+	{
+		const char *scale = scaleList[i].c_str() ;
+		std::string prefix = dir + "/sim_g" + scaleList[i] ;
+		std::string log ;
+		std::vector<std::string> args ;
+
+		args.push_back( bin + "/bench/simulate-assembly" ) ;
+		args.push_back( "-o" ) ; args.push_back( prefix ) ;
+		args.push_back( "-g" ) ; args.push_back( scaleList[i] ) ;
+		args.push_back( "-n50" ) ; args.push_back( n50 ) ;
+		args.push_back( "-d" ) ; args.push_back( depth ) ;
+		args.push_back( "-seed" ) ; args.push_back( seed ) ;
+		log = prefix + "_simulate.log" ;
+		PrintStat( scale, "simulate", Run( args, log.c_str() ) ) ;
+
+		args.clear() ;
+		args.push_back( bin + "/rascaf" ) ;
+		args.push_back( "-b" ) ; args.push_back( prefix + ".bam" ) ;
+		args.push_back( "-f" ) ; args.push_back( prefix + ".fa" ) ;
+		args.push_back( "-o" ) ; args.push_back( prefix ) ;
+		args.push_back( "-t" ) ; args.push_back( threads ) ;
+		args.push_back( "-stats" ) ; args.push_back( prefix + "_rascaf_stats.json" ) ;
+		log = prefix + "_rascaf.log" ;
+		PrintStat( scale, "rascaf", Run( args, log.c_str() ) ) ;
+		PrintStageStats( scale, "rascaf", ( prefix + "_rascaf_stats.json" ).c_str() ) ;
+
+		args.clear() ;
+		args.push_back( bin + "/rascaf-join" ) ;
+		args.push_back( "-r" ) ; args.push_back( prefix + ".out" ) ;
+		args.push_back( "-o" ) ; args.push_back( prefix + "_scaffold" ) ;
+		args.push_back( "-stats" ) ; args.push_back( prefix + "_join_stats.json" ) ;
+		log = prefix + "_join.log" ;
+		PrintStat( scale, "rascaf-join", Run( args, log.c_str() ) ) ;
+		PrintStageStats( scale, "rascaf-join", ( prefix + "_join_stats.json" ).c_str() ) ;
+
+		std::map< std::pair<int, int>, int > truth ;
+		std::set< std::pair<int, int> > connections ;
+		ReadTruth( ( prefix + ".truth" ).c_str(), truth ) ;
+		ReadConnections( ( prefix + ".out" ).c_str(), connections ) ;
+		int correct = 0 ;
+		int acrossCnt = 0, acrossCorrect = 0 ;
+		for ( std::map< std::pair<int, int>, int >::iterator it = truth.begin() ; it != truth.end() ; ++it )
+		{
+			bool found = ( connections.find( it->first ) != connections.end() ) ;
+			if ( found )
+				++correct ;
+			if ( it->second == 0 )
+			{
+				++acrossCnt ;
+				if ( found )
+					++acrossCorrect ;
+			}
+		}
+		char buffer[1024] ;
+		sprintf( buffer, "%-8s %10d %10d %10d %10.4f %10.4f %16.4f", scale, (int)connections.size(), (int)truth.size(), correct,
+			connections.size() > 0 ? (double)correct / connections.size() : 0.0,
+			truth.size() > 0 ? (double)correct / truth.size() : 0.0,
+			acrossCnt > 0 ? (double)acrossCorrect / acrossCnt : 0.0 ) ;
+		accuracy.push_back( buffer ) ;
+	}
+
+	// recall(across) only counts the true connections between different scaffolds of the assembly.
+	printf( "\n%-8s %10s %10s %10s %10s %10s %16s\n", "genes", "predicted", "true", "correct", "precision", "recall", "recall(across)" ) ;
+	for ( i = 0 ; i < scaleCnt ; ++i )
+		printf( "%s\n", accuracy[i].c_str() ) ;
+	return 0 ;
+}
@@ -0,0 +1,651 @@
+// Micro-benchmarks of the inner loops on synthetic data, reporting the time and the cache misses per operation
+// Li Song
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "alignments.hpp"
+#include "blocks.hpp"
+#include "ContigGraph.hpp"
+
+char usage[] = "usage: microbench [options]\n"
+	       "options:\n"
+	       "\t-time INT: the least running time of a kernel in milliseconds for one measurement (default: 200)\n"
+	       "\t-repeat INT: the number of measurements of a kernel, the fastest one is reported (default: 3)\n"
+	       "\t-filter STRING: only run the kernels whose names contain STRING (default: run all)\n"
+	       "\t-chr INT: the number of synthetic chromosomes (default: 64)\n"
+	       "\t-chrLen INT: the length of a synthetic chromosome (default: 1000000)\n"
+	       "\t-seed INT: random seed (default: 17)\n" ;
+
+// The globals the headers expect from the main program.
+int minimumSupport = 2 ;
+int minimumEffectiveLength = 200 ;
+int kmerSize = 23 ;
+int numOfThreads = 1 ;
+bool VERBOSE = false ;
+FILE *fpOut = NULL ;
+bool aggressiveMode = false ;
+double fragLengthQuantile = -1 ;
+int breakN = 1 ;
+
+#define QUERY_COUNT ( 1 << 20 ) // the size of the precomputed query arrays, a power of 2
+#define KMER_STATE_COUNT 4096
+#define SUPPORT_COUNT 1024
+#define EXON_RANGE_LENGTH 300 // the length of an exon range for the kmer kernels
+#define KMER_SET_LENGTH 3000 // the exonic length of a gene block whose kmers are collected
+
+uint64_t rngState ;
+
+uint64_t NextRandom()
+{
+	// splitmix64
+	uint64_t z = ( rngState += 0x9e3779b97f4a7c15ULL ) ;
+	z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL ;
+	z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL ;
+	return z ^ ( z >> 31 ) ;
+}
+
+// Uniform in [a, b]
+int64_t RandomInt( int64_t a, int64_t b )
+{
+	return a + (int64_t)( NextRandom() % (uint64_t)( b - a + 1 ) ) ;
+}
+
+double GetTime()
+{
+	struct timespec t ;
+	clock_gettime( CLOCK_MONOTONIC, &t ) ;
+	return t.tv_sec + t.tv_nsec / 1e9 ;
+}
+
+// The hardware counters from perf_event. A counter whose fd is -1 is not available,
+// e.g. not on Linux, in a container, or with a strict perf_event_paranoid.
+#define PERF_COUNTER_COUNT 2
+const char *perfCounterNames[ PERF_COUNTER_COUNT ] = { "L1D-miss/op", "LLC-miss/op" } ;
+int perfFds[ PERF_COUNTER_COUNT ] ;
+
+void OpenPerfCounters()
+{
+	int i ;
+	for ( i = 0 ; i < PERF_COUNTER_COUNT ; ++i )
+		perfFds[i] = -1 ;
+#ifdef __linux__
+	for ( i = 0 ; i < PERF_COUNTER_COUNT ; ++i )
+	{
+		struct perf_event_attr attr ;
+		memset( &attr, 0, sizeof( attr ) ) ;
+		attr.size = sizeof( attr ) ;
+		attr.disabled = 1 ;
+		attr.exclude_kernel = 1 ;
+		attr.exclude_hv = 1 ;
+		if ( i == 0 )
+		{
+			attr.type = PERF_TYPE_HW_CACHE ;
+			attr.config = PERF_COUNT_HW_CACHE_L1D | ( PERF_COUNT_HW_CACHE_OP_READ << 8 )
+				| ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ) ;
+		}
+		else
+		{
+			attr.type = PERF_TYPE_HARDWARE ;
+			attr.config = PERF_COUNT_HW_CACHE_MISSES ;
+		}
+		perfFds[i] = syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 ) ;
+		if ( perfFds[i] < 0 )
+		{
+			fprintf( stderr, "The counter %s is not available: %s\n", perfCounterNames[i], strerror( errno ) ) ;
+			perfFds[i] = -1 ;
+		}
+	}
+#endif
+}
+
+void StartPerfCounters()
+{
+#ifdef __linux__
+	for ( int i = 0 ; i < PERF_COUNTER_COUNT ; ++i )
+	{
+		if ( perfFds[i] == -1 )
+			continue ;
+		ioctl( perfFds[i], PERF_EVENT_IOC_RESET, 0 ) ;
+		ioctl( perfFds[i], PERF_EVENT_IOC_ENABLE, 0 ) ;
+	}
+#endif
+}
+
+// values[i] is -1 if counter i is not available.
+void StopPerfCounters( int64_t values[] )
+{
+	for ( int i = 0 ; i < PERF_COUNTER_COUNT ; ++i )
+	{
+		values[i] = -1 ;
+#ifdef __linux__
+		if ( perfFds[i] == -1 )
+			continue ;
+		ioctl( perfFds[i], PERF_EVENT_IOC_DISABLE, 0 ) ;
+		uint64_t v ;
+		if ( read( perfFds[i], &v, sizeof( v ) ) == sizeof( v ) )
+			values[i] = v ;
+#endif
+	}
+}
+
+// The synthetic data shared by the kernels.
+struct _range
+{
+	int chrId ;
+	int start ; // the range is [start, start + EXON_RANGE_LENGTH - 1]
+} ;
+
+struct _query
+{
+	int chrId ;
+	int geneBlockId ;
+	int64_t pos ;
+} ;
+
+std::string sequence ; // the concatenation of the chromosomes, for the kernels reading the bases
+BitSequence bitSequence ;
+Genome genome ;
+int chrCnt ;
+int chrLen ;
+std::vector<struct _range> exonRanges ;
+KmerArray<uint64_t> kmerSet ; // the kmers of the first KMER_SET_LENGTH bases
+KmerCode<uint64_t> kmerStates64[ KMER_STATE_COUNT ] ;
+KmerCode<unsigned __int128> kmerStates128[ KMER_STATE_COUNT ] ;
+Support supports[ SUPPORT_COUNT ] ;
+std::vector<struct _alignmentSummary> summaries ;
+Blocks blocks ;
+std::vector<struct _query> sortedQueries ; // sorted by coordinate, as the reads of a BAM file
+std::vector<struct _query> randomQueries ;
+std::vector<struct _query> exonQueries ; // the positions within the gene blocks
+ContigGraph *contigGraph ;
+int contigCnt ;
+std::vector<int> contigOrder ;
+
+void BuildSyntheticData()
+{
+	int i, j ;
+	const char nuc[] = "ACGT" ;
+
+	// The genome
+	for ( i = 0 ; i < chrCnt ; ++i )
+	{
+		std::string chrom( chrLen, 'A' ) ;
+		for ( j = 0 ; j < chrLen ; ++j )
+			chrom[j] = nuc[ NextRandom() & 3 ] ;
+		genome.AddChrom( chrom.c_str() ) ;
+		sequence += chrom ;
+	}
+	// Keep the bit sequence within a few MB, so the sequential kernels are not bound by the memory.
+	int bitLen = std::min( (int)sequence.length(), 1 << 22 ) ;
+	bitSequence = BitSequence( bitLen ) ;
+	for ( i = 0 ; i < bitLen ; ++i )
+		bitSequence.Append( sequence[i] ) ;
+
+	for ( i = 0 ; i < QUERY_COUNT ; ++i )
+	{
+		struct _range r ;
+		r.chrId = RandomInt( 0, chrCnt - 1 ) ;
+		r.start = RandomInt( 0, chrLen - EXON_RANGE_LENGTH ) ;
+		exonRanges.push_back( r ) ;
+	}
+	genome.AddKmer( 0, 0, KMER_SET_LENGTH - 1, kmerSize, kmerSet ) ;
+	kmerSet.Build() ;
+
+	// The states of the kmer codes
+	for ( i = 0 ; i < KMER_STATE_COUNT ; ++i )
+	{
+		kmerStates64[i] = KmerCode<uint64_t>( kmerSize ) ;
+		kmerStates128[i] = KmerCode<unsigned __int128>( 2 * kmerSize + 1 ) ;
+		int from = RandomInt( 0, sequence.length() - 100 ) ;
+		for ( j = 0 ; j < 100 ; ++j )
+		{
+			kmerStates64[i].Append( sequence[ from + j ] ) ;
+			kmerStates128[i].Append( sequence[ from + j ] ) ;
+		}
+	}
+
+	// The alignments for Support::Add, sorted by coordinate as in a BAM file.
+	int64_t pos = 0 ;
+	for ( i = 0 ; i < QUERY_COUNT ; ++i )
+	{
+		struct _alignmentSummary s ;
+		pos += RandomInt( 0, 3 ) ;
+		s.start = pos ;
+		s.end = pos + 99 + ( RandomInt( 0, 3 ) == 0 ? RandomInt( 100, 5000 ) : 0 ) ;
+		s.strandWeight = 1 ;
+		s.nm = RandomInt( 0, 3 ) == 0 ? 1 : 0 ;
+		s.strand = (int)RandomInt( -1, 1 ) ;
+		s.unique = RandomInt( 0, 9 ) > 0 ;
+		s.hasSA = false ;
+		summaries.push_back( s ) ;
+	}
+
+	// The gene blocks with 1-6 exons, separated by intergenic gaps.
+	ExonBlockArray exons ;
+	GeneBlockArray genes ;
+	for ( i = 0 ; i < chrCnt ; ++i )
+	{
+		pos = RandomInt( 0, 10000 ) ;
+		while ( 1 )
+		{
+			int exonCnt = RandomInt( 1, 6 ) ;
+			std::vector<struct _block> geneExons ;
+			int64_t p = pos ;
+			for ( j = 0 ; j < exonCnt ; ++j )
+			{
+				struct _block b ;
+				b.chrId = i ;
+				b.contigId = i ;
+				b.start = p ;
+				b.end = p + RandomInt( 80, 400 ) - 1 ;
+				b.leftSplice = j > 0 ? b.start : -1 ;
+				b.rightSplice = j < exonCnt - 1 ? b.end : -1 ;
+				geneExons.push_back( b ) ;
+				p = b.end + 1 + RandomInt( 100, 3000 ) ;
+			}
+			if ( geneExons.back().end >= chrLen )
+				break ;
+
+			for ( j = 0 ; j < exonCnt ; ++j )
+			{
+				exons.push_back( geneExons[j] ) ;
+				if ( j == 0 )
+					genes.push_back( i, i, geneExons[j].start, geneExons[j].end, exons.size() - 1 ) ;
+				else
+					genes.AddExon( exons.size() - 1 ) ;
+			}
+			genes.end.back() = geneExons.back().end ;
+			pos = geneExons.back().end + 1 + RandomInt( 1000, 10000 ) ;
+		}
+	}
+	blocks.SetBlocks( exons, genes ) ;
+
+	for ( i = 0 ; i < QUERY_COUNT ; ++i )
+	{
+		struct _query q ;
+		q.chrId = RandomInt( 0, chrCnt - 1 ) ;
+		q.pos = RandomInt( 0, chrLen - 1 ) ;
+		q.geneBlockId = -1 ;
+		randomQueries.push_back( q ) ;
+
+		// A position in a random exon of a random gene block.
+		q.geneBlockId = RandomInt( 0, genes.size() - 1 ) ;
+		q.chrId = genes.chrId[ q.geneBlockId ] ;
+		int e = genes.GetExonId( q.geneBlockId, RandomInt( 0, genes.GetExonCount( q.geneBlockId ) - 1 ) ) ;
+		q.pos = RandomInt( exons.start[e], exons.end[e] ) ;
+		exonQueries.push_back( q ) ;
+	}
+	sortedQueries = randomQueries ;
+	for ( i = 0 ; i < QUERY_COUNT ; ++i )
+		sortedQueries[i].chrId = (int64_t)i * chrCnt / QUERY_COUNT ;
+	for ( i = 0 ; i < QUERY_COUNT ; )
+	{
+		for ( j = i ; j < QUERY_COUNT && sortedQueries[j].chrId == sortedQueries[i].chrId ; ++j )
+			;
+		std::vector<int64_t> p ;
+		for ( int k = i ; k < j ; ++k )
+			p.push_back( sortedQueries[k].pos ) ;
+		std::sort( p.begin(), p.end() ) ;
+		for ( int k = i ; k < j ; ++k )
+			sortedQueries[k].pos = p[k - i] ;
+		i = j ;
+	}
+
+	// The contig graph as in rascaf-join: the adjacent contigs of a scaffold are connected,
+	// and the connections are added on top of them.
+	contigCnt = chrCnt * 1000 ;
+	int connectionCnt = contigCnt / 4 ;
+	contigGraph = new ContigGraph( contigCnt, contigCnt + connectionCnt ) ;
+	for ( i = 0 ; i < contigCnt - 1 ; ++i )
+		if ( ( i + 1 ) % 20 != 0 )
+			contigGraph->AddEdge( i, 1, i + 1, 0 ) ;
+	for ( i = 0 ; i < connectionCnt ; ++i )
+		contigGraph->AddEdge( RandomInt( 0, contigCnt - 1 ), RandomInt( 0, 1 ), RandomInt( 0, contigCnt - 1 ), RandomInt( 0, 1 ) ) ;
+	for ( i = 0 ; i < QUERY_COUNT ; ++i )
+		contigOrder.push_back( RandomInt( 0, contigCnt - 1 ) ) ;
+}
+
+// The kernels. Each runs n operations and returns a value depending on all of them,
+// so the compiler can not drop the work.
+int64_t Bench_KmerAppend64( int64_t n )
+{
+	KmerCode<uint64_t> code( kmerSize ) ;
+	int64_t len = sequence.length() ;
+	int64_t i, j ;
+	for ( i = 0, j = 0 ; i < n ; ++i, ++j )
+	{
+		if ( j >= len )
+			j = 0 ;
+		code.Append( sequence[j] ) ;
+	}
+	return code.GetCode() ;
+}
+
+int64_t Bench_KmerAppend128( int64_t n )
+{
+	KmerCode<unsigned __int128> code( 2 * kmerSize + 1 ) ;
+	int64_t len = sequence.length() ;
+	int64_t i, j ;
+	for ( i = 0, j = 0 ; i < n ; ++i, ++j )
+	{
+		if ( j >= len )
+			j = 0 ;
+		code.Append( sequence[j] ) ;
+	}
+	return (int64_t)code.GetCode() ;
+}
+
+int64_t Bench_KmerCanonical64( int64_t n )
+{
+	uint64_t ret = 0 ;
+	for ( int64_t i = 0 ; i < n ; ++i )
+		ret += kmerStates64[ i & ( KMER_STATE_COUNT - 1 ) ].GetCanonicalKmerCode() ;
+	return ret ;
+}
+
+int64_t Bench_KmerCanonical128( int64_t n )
+{
+	unsigned __int128 ret = 0 ;
+	for ( int64_t i = 0 ; i < n ; ++i )
+		ret += kmerStates128[ i & ( KMER_STATE_COUNT - 1 ) ].GetCanonicalKmerCode() ;
+	return (int64_t)ret ;
+}
+
+int64_t Bench_BitSequenceSet( int64_t n )
+{
+	int len = bitSequence.GetLength() ;
+	int64_t i ;
+	int j ;
+	for ( i = 0, j = 0 ; i < n ; ++i, ++j )
+	{
+		if ( j >= len )
+			j = 0 ;
+		bitSequence.Set( sequence[j], j ) ;
+	}
+	return bitSequence.Get( len - 1 ) ;
+}
+
+int64_t Bench_BitSequenceGet( int64_t n )
+{
+	int len = bitSequence.GetLength() ;
+	int64_t i, ret = 0 ;
+	int j ;
+	for ( i = 0, j = 0 ; i < n ; ++i, ++j )
+	{
+		if ( j >= len )
+			j = 0 ;
+		ret += bitSequence.Get( j ) ;
+	}
+	return ret ;
+}
+
+int64_t Bench_BitSequenceGetRandom( int64_t n )
+{
+	int64_t ret = 0 ;
+	for ( int64_t i = 0 ; i < n ; ++i )
+		ret += bitSequence.Get( randomQueries[ i & ( QUERY_COUNT - 1 ) ].pos & ( ( 1 << 22 ) - 1 ) ) ;
+	return ret ;
+}
+
+// An operation is a base written.
+int64_t Bench_BitSequencePrint( int64_t n )
+{
+	static FILE *fp = NULL ;
+	if ( fp == NULL )
+	{
+		fp = fopen( "/dev/null", "w" ) ;
+		if ( fp == NULL )
+		{
+			fprintf( stderr, "Can not open /dev/null.\n" ) ;
+			exit( 1 ) ;
+		}
+	}
+	int len = bitSequence.GetLength() ;
+	int64_t i ;
+	int start = 0 ;
+	bool rc = false ;
+	for ( i = 0 ; i < n ; )
+	{
+		int end = start + 9999 ;
+		if ( end >= len )
+			end = len - 1 ;
+		if ( end - start + 1 > n - i )
+			end = start + ( n - i ) - 1 ;
+		bitSequence.Print( fp, start, end, rc ) ;
+		i += end - start + 1 ;
+		start = end + 1 < len ? end + 1 : 0 ;
+		rc = !rc ;
+	}
+	return start ;
+}
+
+// An operation is a base whose kmer is added, the array is built for every KMER_SET_LENGTH bases
+// as for a gene block in ValidateGeneBlockEdges.
+int64_t Bench_GenomeAddKmer( int64_t n )
+{
+	KmerArray<uint64_t> kmers ;
+	int64_t i, ret = 0 ;
+	int r = 0 ;
+	int rangeCnt = KMER_SET_LENGTH / EXON_RANGE_LENGTH ;
+	for ( i = 0 ; i < n ; )
+	{
+		kmers.Clear() ;
+		for ( int j = 0 ; j < rangeCnt && i < n ; ++j, ++r )
+		{
+			const struct _range &e = exonRanges[ r & ( QUERY_COUNT - 1 ) ] ;
+			genome.AddKmer( e.chrId, e.start, e.start + EXON_RANGE_LENGTH - 1, kmerSize, kmers ) ;
+			i += EXON_RANGE_LENGTH ;
+		}
+		kmers.Build() ;
+		ret += kmers.Size() ;
+	}
+	return ret ;
+}
+
+// An operation is a base whose kmer is looked up.
+int64_t Bench_GenomeGetKmerCoverage( int64_t n )
+{
+	int64_t i, ret = 0 ;
+	int r = 0 ;
+	for ( i = 0 ; i < n ; i += EXON_RANGE_LENGTH, ++r )
+	{
+		const struct _range &e = exonRanges[ r & ( QUERY_COUNT - 1 ) ] ;
+		ret += genome.GetKmerCoverage( e.chrId, e.start, e.start + EXON_RANGE_LENGTH - 1, kmerSize, kmerSet ) ;
+	}
+	return ret ;
+}
+
+int64_t Bench_SupportAdd( int64_t n )
+{
+	for ( int64_t i = 0 ; i < n ; ++i )
+		supports[ ( i >> 4 ) & ( SUPPORT_COUNT - 1 ) ].Add( summaries[ i & ( QUERY_COUNT - 1 ) ] ) ;
+	return supports[0].GetCount() ;
+}
+
+int64_t Bench_FindGeneBlockSorted( int64_t n )
+{
+	int64_t ret = 0 ;
+	for ( int64_t i = 0 ; i < n ; ++i )
+	{
+		const struct _query &q = sortedQueries[ i & ( QUERY_COUNT - 1 ) ] ;
+		ret += blocks.FindGeneBlock( q.chrId, q.pos ) ;
+	}
+	return ret ;
+}
+
+int64_t Bench_FindGeneBlockRandom( int64_t n )
+{
+	int64_t ret = 0 ;
+	for ( int64_t i = 0 ; i < n ; ++i )
+	{
+		const struct _query &q = randomQueries[ i & ( QUERY_COUNT - 1 ) ] ;
+		ret += blocks.FindGeneBlock( q.chrId, q.pos ) ;
+	}
+	return ret ;
+}
+
+int64_t Bench_GetExonBlockInGeneBlock( int64_t n )
+{
+	int64_t ret = 0 ;
+	for ( int64_t i = 0 ; i < n ; ++i )
+	{
+		const struct _query &q = exonQueries[ i & ( QUERY_COUNT - 1 ) ] ;
+		ret += blocks.GetExonBlockInGeneBlock( q.geneBlockId, q.chrId, q.pos ) ;
+	}
+	return ret ;
+}
+
+int64_t Bench_ContigGraphGetNeighbors( int64_t n )
+{
+	struct _pair neighbors[64] ;
+	int64_t ret = 0 ;
+	for ( int64_t i = 0 ; i < n ; ++i )
+	{
+		int cnt = contigGraph->GetNeighbors( contigOrder[ i & ( QUERY_COUNT - 1 ) ], i & 1, neighbors, 64 ) ;
+		ret += cnt > 0 ? neighbors[0].a : cnt ;
+	}
+	return ret ;
+}
+
+struct _bench
+{
+	const char *name ;
+	int64_t (*func)( int64_t n ) ;
+} ;
+
+struct _bench benches[] = {
+	{ "KmerCode<uint64_t>::Append", Bench_KmerAppend64 },
+	{ "KmerCode<__int128>::Append", Bench_KmerAppend128 },
+	{ "KmerCode<uint64_t>::GetCanonicalKmerCode", Bench_KmerCanonical64 },
+	{ "KmerCode<__int128>::GetCanonicalKmerCode", Bench_KmerCanonical128 },
+	{ "BitSequence::Set", Bench_BitSequenceSet },
+	{ "BitSequence::Get", Bench_BitSequenceGet },
+	{ "BitSequence::Get(random)", Bench_BitSequenceGetRandom },
+	{ "BitSequence::Print", Bench_BitSequencePrint },
+	{ "Genome::AddKmer", Bench_GenomeAddKmer },
+	{ "Genome::GetKmerCoverage", Bench_GenomeGetKmerCoverage },
+	{ "Support::Add", Bench_SupportAdd },
+	{ "Blocks::FindGeneBlock(sorted)", Bench_FindGeneBlockSorted },
+	{ "Blocks::FindGeneBlock(random)", Bench_FindGeneBlockRandom },
+	{ "Blocks::GetExonBlockInGeneBlock", Bench_GetExonBlockInGeneBlock },
+	{ "ContigGraph::GetNeighbors", Bench_ContigGraphGetNeighbors },
+	{ NULL, NULL }
+} ;
+
+volatile int64_t sink ;
+
+int main( int argc, char *argv[] )
+{
+	int i, j ;
+	double minTime = 0.2 ;
+	int repeat = 3 ;
+	const char *filter = NULL ;
+
+	chrCnt = 64 ;
+	chrLen = 1000000 ;
+	rngState = 17 ;
+	for ( i = 1 ; i < argc ; ++i )
+	{
+		if ( i + 1 >= argc )
+		{
+			fprintf( stderr, "%s", usage ) ;
+			exit( 1 ) ;
+		}
+		if ( !strcmp( "-time", argv[i] ) )
+			minTime = atoi( argv[++i] ) / 1000.0 ;
+		else if ( !strcmp( "-repeat", argv[i] ) )
+			repeat = atoi( argv[++i] ) ;
+		else if ( !strcmp( "-filter", argv[i] ) )
+			filter = argv[++i] ;
+		else if ( !strcmp( "-chr", argv[i] ) )
+			chrCnt = atoi( argv[++i] ) ;
+		else if ( !strcmp( "-chrLen", argv[i] ) )
+			chrLen = atoi( argv[++i] ) ;
+		else if ( !strcmp( "-seed", argv[i] ) )
+			rngState = strtoull( argv[++i], NULL, 10 ) ;
+		else
+		{
+			fprintf( stderr, "Unknown option: %s\n%s", argv[i], usage ) ;
+			exit( 1 ) ;
+		}
+	}
+	if ( chrCnt < 1 || chrLen < 20000 || repeat < 1 )
+	{
+		fprintf( stderr, "-chr should be at least 1, -chrLen at least 20000 and -repeat at least 1.\n" ) ;
+		exit( 1 ) ;
+	}
+
+	double start = GetTime() ;
+	BuildSyntheticData() ;
+	fprintf( stderr, "Built the synthetic data in %.2lf seconds.\n", GetTime() - start ) ;
+	OpenPerfCounters() ;
+
+	printf( "%-42s %12s %10s", "kernel", "ops", "ns/op" ) ;
+	for ( j = 0 ; j < PERF_COUNTER_COUNT ; ++j )
+		printf( " %12s", perfCounterNames[j] ) ;
+	printf( "\n" ) ;
+	for ( i = 0 ; benches[i].name != NULL ; ++i )
+	{
+		if ( filter != NULL && strstr( benches[i].name, filter ) == NULL )
+			continue ;
+
+		// Warm up and find the number of operations taking about minTime.
+		int64_t n = 1024 ;
+		double elapsed ;
+		while ( 1 )
+		{
+			start = GetTime() ;
+			sink = benches[i].func( n ) ;
+			elapsed = GetTime() - start ;
+			if ( elapsed >= minTime / 8 || n >= ( (int64_t)1 << 40 ) )
+				break ;
+			n *= 2 ;
+		}
+		if ( elapsed > 0 )
+			n = std::max( n, (int64_t)( n * minTime / elapsed ) ) ;
+
+		double best = -1 ;
+		int64_t bestCounters[ PERF_COUNTER_COUNT ] ;
+		for ( int r = 0 ; r < repeat ; ++r )
+		{
+			int64_t counters[ PERF_COUNTER_COUNT ] ;
+			StartPerfCounters() ;
+			start = GetTime() ;
+			sink = benches[i].func( n ) ;
+			elapsed = GetTime() - start ;
+			StopPerfCounters( counters ) ;
+			if ( best < 0 || elapsed < best )
+			{
+				best = elapsed ;
+				memcpy( bestCounters, counters, sizeof( counters ) ) ;
+			}
+		}
+
+		printf( "%-42s %12lld %10.3lf", benches[i].name, (long long)n, best * 1e9 / n ) ;
+		for ( j = 0 ; j < PERF_COUNTER_COUNT ; ++j )
+		{
+			if ( bestCounters[j] < 0 )
+				printf( " %12s", "-" ) ;
+			else
+				printf( " %12.4lf", (double)bestCounters[j] / n ) ;
+		}
+		printf( "\n" ) ;
+		fflush( stdout ) ;
+	}
+	return 0 ;
+}
@@ -0,0 +1,547 @@
+// Simulate a fragmented assembly of a genome with genes and the RNA-seq alignments on it, for benchmarking
+// Li Song
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "sam.h"
+
+char usage[] = "usage: simulate-assembly [options]\n"
+	       "options:\n"
+	       "\t-o STRING (required): prefix of the output files $prefix.fa, $prefix.bam and $prefix.truth(the true connections)\n"
+	       "\t-g INT: number of genes (default: 1000)\n"
+	       "\t-n50 INT: the N50 of the contigs (default: 20000)\n"
+	       "\t-scaf INT: the largest number of contigs in a scaffold of the assembly (default: 3)\n"
+	       "\t-d FLOAT: the scale of the read depth, the fragments per 100bp of a transcript with medium expression (default: 1.0)\n"
+	       "\t-rl INT: read length (default: 100)\n"
+	       "\t-fl INT: mean fragment length (default: 300)\n"
+	       "\t-fs INT: standard deviation of the fragment length (default: 40)\n"
+	       "\t-seed INT: random seed (default: 17)\n" ;
+
+struct _interval
+{
+	int64_t a, b ; // inclusive
+} ;
+
+struct _gene
+{
+	std::vector<struct _interval> exons ;
+	char strand ;
+	double expression ;
+} ;
+
+struct _piece
+{
+	int64_t start, end ; // [start, end) on the genome
+	bool flip ;
+	int scafId ;
+	int64_t offset ; // where the piece starts in its scaffold
+	int contigId ;
+} ;
+
+struct _read
+{
+	int tid ;
+	int64_t pos ;
+	int mtid ;
+	int64_t mpos ;
+	int flag ;
+	int fragId ;
+	char xs ;
+	std::vector<struct _interval> blocks ; // on the scaffold
+} ;
+
+uint64_t rngState ;
+
+uint64_t NextRandom()
+{
+	// splitmix64
+	uint64_t z = ( rngState += 0x9e3779b97f4a7c15ULL ) ;
+	z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL ;
+	z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL ;
+	return z ^ ( z >> 31 ) ;
+}
+
+// Uniform in [a, b]
+int64_t RandomInt( int64_t a, int64_t b )
+{
+	return a + (int64_t)( NextRandom() % (uint64_t)( b - a + 1 ) ) ;
+}
+
+double RandomDouble()
+{
+	return ( NextRandom() >> 11 ) * ( 1.0 / 9007199254740992.0 ) ;
+}
+
+double RandomGauss( double mean, double sd )
+{
+	double u = RandomDouble() ;
+	double v = RandomDouble() ;
+	if ( u < 1e-300 )
+		u = 1e-300 ;
+	return mean + sd * sqrt( -2 * log( u ) ) * cos( 2 * M_PI * v ) ;
+}
+
+void AppendRandomSequence( std::string &s, int64_t len )
+{
+	for ( int64_t i = 0 ; i < len ; ++i )
+		s.push_back( "ACGT"[ NextRandom() & 3 ] ) ;
+}
+
+char Complement( char c )
+{
+	switch ( c )
+	{
+		case 'A': return 'T' ;
+		case 'C': return 'G' ;
+		case 'G': return 'C' ;
+		case 'T': return 'A' ;
+	}
+	return 'N' ;
+}
+
+bool CompRead( const struct _read &a, const struct _read &b )
+{
+	if ( a.tid != b.tid )
+		return a.tid < b.tid ;
+	if ( a.pos != b.pos )
+		return a.pos < b.pos ;
+	return a.fragId < b.fragId ;
+}
+
+// Return the piece containing the genome position.
+int GetPieceId( const std::vector<struct _piece> &pieces, int64_t x )
+{
+	int l = 0, r = pieces.size() - 1 ;
+	while ( l < r )
+	{
+		int m = ( l + r + 1 ) / 2 ;
+		if ( pieces[m].start <= x )
+			l = m ;
+		else
+			r = m - 1 ;
+	}
+	return l ;
+}
+
+// Map the genomic blocks to the scaffold coordinate. Return false if they do not lie in one piece.
+bool Project( const std::vector<struct _piece> &pieces, std::vector<struct _interval> &blocks, int &tid, bool &flip )
+{
+	int p = GetPieceId( pieces, blocks[0].a ) ;
+	if ( GetPieceId( pieces, blocks.back().b ) != p )
+		return false ;
+	const struct _piece &piece = pieces[p] ;
+	int cnt = blocks.size() ;
+	tid = piece.scafId ;
+	flip = piece.flip ;
+	for ( int i = 0 ; i < cnt ; ++i )
+	{
+		if ( !flip )
+		{
+			blocks[i].a = piece.offset + blocks[i].a - piece.start ;
+			blocks[i].b = piece.offset + blocks[i].b - piece.start ;
+		}
+		else
+		{
+			int64_t a = piece.offset + piece.end - 1 - blocks[i].b ;
+			int64_t b = piece.offset + piece.end - 1 - blocks[i].a ;
+			blocks[i].a = a ;
+			blocks[i].b = b ;
+		}
+	}
+	if ( flip )
+		std::reverse( blocks.begin(), blocks.end() ) ;
+	return true ;
+}
+
+// The genomic blocks of the transcript positions [t0, t1).
+void GetTranscriptBlocks( const std::vector<int64_t> &exonStarts, const struct _gene &gene, int64_t t0, int64_t t1,
+	std::vector<struct _interval> &blocks )
+{
+	blocks.clear() ;
+	int cnt = gene.exons.size() ;
+	for ( int i = 0 ; i < cnt ; ++i )
+	{
+		int64_t s = exonStarts[i] ;
+		int64_t e = s + gene.exons[i].b - gene.exons[i].a + 1 ;
+		if ( e <= t0 || s >= t1 )
+			continue ;
+		struct _interval in ;
+		in.a = gene.exons[i].a + ( t0 > s ? t0 - s : 0 ) ;
+		in.b = gene.exons[i].a + ( t1 < e ? t1 - s : e - s ) - 1 ;
+		blocks.push_back( in ) ;
+	}
+}
+
+void WriteRead( bamFile fp, const struct _read &r, const std::vector<std::string> &scaffolds, bam1_t *b )
+{
+	int i ;
+	char qname[32] ;
+	sprintf( qname, "r%d", r.fragId ) ;
+	int lqname = strlen( qname ) + 1 ;
+	int ncigar = 2 * r.blocks.size() - 1 ;
+	int lqseq = 0 ;
+	int cnt = r.blocks.size() ;
+	for ( i = 0 ; i < cnt ; ++i )
+		lqseq += r.blocks[i].b - r.blocks[i].a + 1 ;
+	int laux = 4 + 4 + ( cnt > 1 ? 4 : 0 ) ;
+
+	int dataLen = lqname + 4 * ncigar + ( lqseq + 1 ) / 2 + lqseq + laux ;
+	if ( b->m_data < dataLen )
+	{
+		b->m_data = dataLen * 2 ;
+		b->data = (uint8_t *)realloc( b->data, b->m_data ) ;
+	}
+	b->data_len = dataLen ;
+	b->l_aux = laux ;
+
+	bam1_core_t &c = b->core ;
+	c.tid = r.tid ;
+	c.pos = r.pos ;
+	c.bin = bam_reg2bin( r.blocks[0].a, r.blocks.back().b + 1 ) ;
+	c.qual = 60 ;
+	c.l_qname = lqname ;
+	c.flag = r.flag ;
+	c.n_cigar = ncigar ;
+	c.l_qseq = lqseq ;
+	c.mtid = r.mtid ;
+	c.mpos = r.mpos ;
+	c.isize = 0 ;
+
+	uint8_t *p = b->data ;
+	memcpy( p, qname, lqname ) ;
+	p += lqname ;
+	uint32_t *cigar = (uint32_t *)p ;
+	for ( i = 0 ; i < cnt ; ++i )
+	{
+		if ( i > 0 )
+			*cigar++ = ( ( r.blocks[i].a - r.blocks[i - 1].b - 1 ) << BAM_CIGAR_SHIFT ) | BAM_CREF_SKIP ;
+		*cigar++ = ( ( r.blocks[i].b - r.blocks[i].a + 1 ) << BAM_CIGAR_SHIFT ) | BAM_CMATCH ;
+	}
+	p = (uint8_t *)cigar ;
+	memset( p, 0, ( lqseq + 1 ) / 2 ) ;
+	int k = 0 ;
+	const std::string &s = scaffolds[ r.tid ] ;
+	for ( i = 0 ; i < cnt ; ++i )
+		for ( int64_t j = r.blocks[i].a ; j <= r.blocks[i].b ; ++j, ++k )
+			p[k / 2] |= bam_nt16_table[ (int)s[j] ] << ( 4 * ( 1 - k % 2 ) ) ;
+	p += ( lqseq + 1 ) / 2 ;
+	memset( p, 30, lqseq ) ;
+	p += lqseq ;
+
+	p[0] = 'N' ; p[1] = 'H' ; p[2] = 'C' ; p[3] = 1 ;
+	p[4] = 'N' ; p[5] = 'M' ; p[6] = 'C' ; p[7] = 0 ;
+	if ( cnt > 1 )
+	{
+		p[8] = 'X' ; p[9] = 'S' ; p[10] = 'A' ; p[11] = r.xs ;
+	}
+	bam_write1( fp, b ) ;
+}
+
+int main( int argc, char *argv[] )
+{
+	int i, j ;
+	char *prefix = NULL ;
+	int geneCnt = 1000 ;
+	int64_t n50 = 20000 ;
+	int maxScafSize = 3 ;
+	double depth = 1.0 ;
+	int readLen = 100 ;
+	int fragMean = 300 ;
+	int fragSd = 40 ;
+	rngState = 17 ;
+
+	for ( i = 1 ; i < argc ; ++i )
+	{
+		if ( !strcmp( "-o", argv[i] ) && i + 1 < argc )
+			prefix = argv[++i] ;
+		else if ( !strcmp( "-g", argv[i] ) && i + 1 < argc )
+			geneCnt = atoi( argv[++i] ) ;
+		else if ( !strcmp( "-n50", argv[i] ) && i + 1 < argc )
+			n50 = atol( argv[++i] ) ;
+		else if ( !strcmp( "-scaf", argv[i] ) && i + 1 < argc )
+			maxScafSize = atoi( argv[++i] ) ;
+		else if ( !strcmp( "-d", argv[i] ) && i + 1 < argc )
+			depth = atof( argv[++i] ) ;
+		else if ( !strcmp( "-rl", argv[i] ) && i + 1 < argc )
+			readLen = atoi( argv[++i] ) ;
+		else if ( !strcmp( "-fl", argv[i] ) && i + 1 < argc )
+			fragMean = atoi( argv[++i] ) ;
+		else if ( !strcmp( "-fs", argv[i] ) && i + 1 < argc )
+			fragSd = atoi( argv[++i] ) ;
+		else if ( !strcmp( "-seed", argv[i] ) && i + 1 < argc )
+			rngState = atol( argv[++i] ) ;
+		else
+		{
+			fprintf( stderr, "Unknown option: %s\n%s", argv[i], usage ) ;
+			exit( 1 ) ;
+		}
+	}
+	if ( prefix == NULL || geneCnt <= 0 || n50 <= 0 || maxScafSize <= 0 || readLen <= 0 )
+	{
+		fprintf( stderr, "%s", usage ) ;
+		exit( 1 ) ;
+	}
+
+	// The genome: genes separated by intergenic regions, a few exons are copies from gene families
+	std::string genome ;
+	std::vector<struct _gene> genes ;
+	std::vector<std::string> families ;
+	for ( i = 0 ; i < 5 ; ++i )
+	{
+		std::string s ;
+		AppendRandomSequence( s, 150 ) ;
+		families.push_back( s ) ;
+	}
+	const double expressionLevels[] = { 0.2, 1, 3, 10, 40 } ;
+	for ( i = 0 ; i < geneCnt ; ++i )
+	{
+		AppendRandomSequence( genome, RandomInt( 1000, 6000 ) ) ;
+		struct _gene gene ;
+		int exonCnt = RandomInt( 1, 7 ) ;
+		for ( j = 0 ; j < exonCnt ; ++j )
+		{
+			struct _interval e ;
+			e.a = genome.length() ;
+			if ( RandomDouble() < 0.05 )
+				genome += families[ RandomInt( 0, 4 ) ] ;
+			else
+				AppendRandomSequence( genome, RandomInt( 80, 400 ) ) ;
+			e.b = genome.length() - 1 ;
+			gene.exons.push_back( e ) ;
+			if ( j < exonCnt - 1 )
+				AppendRandomSequence( genome, RandomInt( 80, 2500 ) ) ;
+		}
+		gene.strand = ( NextRandom() & 1 ) ? '+' : '-' ;
+		gene.expression = expressionLevels[ RandomInt( 0, 4 ) ] * depth ;
+		genes.push_back( gene ) ;
+	}
+	AppendRandomSequence( genome, 3000 ) ;
+	int64_t genomeLen = genome.length() ;
+
+	// Cut the genome into contigs. The lengths are exponential, whose N50 is about 1.678 times the mean.
+	std::vector<struct _piece> pieces ;
+	double meanLen = n50 / 1.678 ;
+	int64_t minLen = n50 / 20 < 200 ? 200 : n50 / 20 ;
+	for ( int64_t start = 0 ; start < genomeLen ; )
+	{
+		int64_t len = (int64_t)( -meanLen * log( 1 - RandomDouble() ) ) ;
+		if ( len < minLen )
+			len = minLen ;
+		struct _piece piece ;
+		piece.start = start ;
+		piece.end = start + len < genomeLen ? start + len : genomeLen ;
+		if ( genomeLen - piece.end < minLen )
+			piece.end = genomeLen ;
+		piece.flip = RandomDouble() < 0.4 ;
+		pieces.push_back( piece ) ;
+		start = piece.end ;
+	}
+	int pieceCnt = pieces.size() ;
+
+	// Group the consecutive contigs into the scaffolds of the assembly, and shuffle the scaffolds.
+	std::vector< std::vector<int> > groups ;
+	for ( i = 0 ; i < pieceCnt ; )
+	{
+		int k = RandomInt( 1, maxScafSize ) ;
+		std::vector<int> g ;
+		for ( j = 0 ; j < k && i < pieceCnt ; ++j, ++i )
+			g.push_back( i ) ;
+		groups.push_back( g ) ;
+	}
+	for ( i = groups.size() - 1 ; i > 0 ; --i )
+		std::swap( groups[i], groups[ RandomInt( 0, i ) ] ) ;
+
+	char buffer[1024] ;
+	sprintf( buffer, "%s.fa", prefix ) ;
+	FILE *fpFa = fopen( buffer, "w" ) ;
+	if ( fpFa == NULL )
+	{
+		fprintf( stderr, "Can not open %s.\n", buffer ) ;
+		exit( 1 ) ;
+	}
+	std::vector<std::string> scaffolds ;
+	int groupCnt = groups.size() ;
+	int contigId = 0 ;
+	for ( i = 0 ; i < groupCnt ; ++i )
+	{
+		std::string s ;
+		int cnt = groups[i].size() ;
+		for ( j = 0 ; j < cnt ; ++j )
+		{
+			struct _piece &piece = pieces[ groups[i][j] ] ;
+			if ( j > 0 )
+				s.append( RandomInt( 20, 200 ), 'N' ) ;
+			piece.scafId = i ;
+			piece.offset = s.length() ;
+			piece.contigId = contigId++ ;
+			if ( !piece.flip )
+				s.append( genome, piece.start, piece.end - piece.start ) ;
+			else
+			{
+				for ( int64_t k = piece.end - 1 ; k >= piece.start ; --k )
+					s.push_back( Complement( genome[k] ) ) ;
+			}
+		}
+		fprintf( fpFa, ">scaf%d\n", i ) ;
+		int64_t len = s.length() ;
+		for ( int64_t k = 0 ; k < len ; k += 60 )
+			fprintf( fpFa, "%s\n", s.substr( k, 60 ).c_str() ) ;
+		scaffolds.push_back( s ) ;
+	}
+	fclose( fpFa ) ;
+
+	// The true connections: the consecutive contigs along each gene.
+	sprintf( buffer, "%s.truth", prefix ) ;
+	FILE *fpTruth = fopen( buffer, "w" ) ;
+	if ( fpTruth == NULL )
+	{
+		fprintf( stderr, "Can not open %s.\n", buffer ) ;
+		exit( 1 ) ;
+	}
+	std::vector< std::pair<int, int> > truth ;
+	for ( i = 0 ; i < geneCnt ; ++i )
+	{
+		int prev = -1 ;
+		int cnt = genes[i].exons.size() ;
+		for ( j = 0 ; j < cnt ; ++j )
+		{
+			int a = GetPieceId( pieces, genes[i].exons[j].a ) ;
+			int b = GetPieceId( pieces, genes[i].exons[j].b ) ;
+			for ( int p = a ; p <= b ; ++p )
+			{
+				if ( prev != -1 && prev != p )
+					truth.push_back( std::make_pair( std::min( pieces[prev].contigId, pieces[p].contigId ),
+						std::max( pieces[prev].contigId, pieces[p].contigId ) ) ) ;
+				prev = p ;
+			}
+		}
+	}
+	std::sort( truth.begin(), truth.end() ) ;
+	truth.erase( std::unique( truth.begin(), truth.end() ), truth.end() ) ;
+	int truthCnt = truth.size() ;
+	std::vector<int> contigScafIds( pieceCnt ) ;
+	for ( i = 0 ; i < pieceCnt ; ++i )
+		contigScafIds[ pieces[i].contigId ] = pieces[i].scafId ;
+	// The third column tells whether the two contigs are already in the same scaffold of the assembly.
+	for ( i = 0 ; i < truthCnt ; ++i )
+		fprintf( fpTruth, "%d %d %d\n", truth[i].first, truth[i].second, 
+			contigScafIds[ truth[i].first ] == contigScafIds[ truth[i].second ] ? 1 : 0 ) ;
+	fclose( fpTruth ) ;
+
+	// The fragments from the transcripts. A mate crossing two contigs would not align, so its pair is dropped.
+	std::vector<struct _read> reads ;
+	std::vector<int64_t> exonStarts ;
+	std::vector<struct _interval> blocks ;
+	int fragId = 0 ;
+	for ( i = 0 ; i < geneCnt ; ++i )
+	{
+		struct _gene &gene = genes[i] ;
+		int cnt = gene.exons.size() ;
+		int64_t tlen = 0 ;
+		exonStarts.clear() ;
+		for ( j = 0 ; j < cnt ; ++j )
+		{
+			exonStarts.push_back( tlen ) ;
+			tlen += gene.exons[j].b - gene.exons[j].a + 1 ;
+		}
+		if ( tlen < 2 * readLen )
+			continue ;
+		int fragCnt = (int)( gene.expression * tlen / 100 ) ;
+		for ( j = 0 ; j < fragCnt ; ++j )
+		{
+			int64_t fl = (int64_t)RandomGauss( fragMean, fragSd ) ;
+			if ( fl < readLen )
+				fl = readLen ;
+			if ( fl > tlen )
+				fl = tlen ;
+			int64_t st = RandomInt( 0, tlen - fl ) ;
+
+			struct _read mates[2] ;
+			bool flip[2] ;
+			GetTranscriptBlocks( exonStarts, gene, st, st + readLen, mates[0].blocks ) ;
+			GetTranscriptBlocks( exonStarts, gene, st + fl - readLen, st + fl, mates[1].blocks ) ;
+			if ( !Project( pieces, mates[0].blocks, mates[0].tid, flip[0] )
+				|| !Project( pieces, mates[1].blocks, mates[1].tid, flip[1] ) )
+				continue ;
+			for ( int k = 0 ; k < 2 ; ++k )
+			{
+				mates[k].pos = mates[k].blocks[0].a ;
+				mates[k].fragId = fragId ;
+				mates[k].xs = ( gene.strand == '+' ) != flip[k] ? '+' : '-' ;
+			}
+			for ( int k = 0 ; k < 2 ; ++k )
+			{
+				bool reverse = ( k == 1 ) != flip[k] ;
+				bool mateReverse = ( k == 0 ) != flip[1 - k] ;
+				mates[k].flag = BAM_FPAIRED | BAM_FPROPER_PAIR | ( reverse ? BAM_FREVERSE : 0 )
+					| ( mateReverse ? BAM_FMREVERSE : 0 ) | ( k == 0 ? BAM_FREAD1 : BAM_FREAD2 ) ;
+				mates[k].mtid = mates[1 - k].tid ;
+				mates[k].mpos = mates[1 - k].pos ;
+				reads.push_back( mates[k] ) ;
+			}
+			++fragId ;
+		}
+	}
+	std::sort( reads.begin(), reads.end(), CompRead ) ;
+
+	// Write the coordinate-sorted BAM file.
+	bam_header_t *header = bam_header_init() ;
+	header->n_targets = groupCnt ;
+	header->target_name = (char **)calloc( groupCnt, sizeof( char * ) ) ;
+	header->target_len = (uint32_t *)calloc( groupCnt, sizeof( uint32_t ) ) ;
+	std::string text = "@HD\tVN:1.0\tSO:coordinate\n" ;
+	for ( i = 0 ; i < groupCnt ; ++i )
+	{
+		sprintf( buffer, "scaf%d", i ) ;
+		header->target_name[i] = strdup( buffer ) ;
+		header->target_len[i] = scaffolds[i].length() ;
+		sprintf( buffer, "@SQ\tSN:scaf%d\tLN:%d\n", i, (int)scaffolds[i].length() ) ;
+		text += buffer ;
+	}
+	header->l_text = text.length() ;
+	header->text = strdup( text.c_str() ) ;
+
+	sprintf( buffer, "%s.bam", prefix ) ;
+	bamFile fpBam = bam_open( buffer, "w" ) ;
+	if ( fpBam == NULL )
+	{
+		fprintf( stderr, "Can not open %s.\n", buffer ) ;
+		exit( 1 ) ;
+	}
+	bam_header_write( fpBam, header ) ;
+	bam1_t *b = bam_init1() ;
+	int readCnt = reads.size() ;
+	for ( i = 0 ; i < readCnt ; ++i )
+		WriteRead( fpBam, reads[i], scaffolds, b ) ;
+	bam_destroy1( b ) ;
+	bam_close( fpBam ) ;
+	bam_header_destroy( header ) ;
+
+	// The N50 of the contigs
+	std::vector<int64_t> lens ;
+	for ( i = 0 ; i < pieceCnt ; ++i )
+		lens.push_back( pieces[i].end - pieces[i].start ) ;
+	std::sort( lens.begin(), lens.end() ) ;
+	int64_t sum = 0 ;
+	int64_t realN50 = 0 ;
+	for ( i = pieceCnt - 1 ; i >= 0 ; --i )
+	{
+		sum += lens[i] ;
+		if ( 2 * sum >= genomeLen )
+		{
+			realN50 = lens[i] ;
+			break ;
+		}
+	}
+	fprintf( stderr, "Simulated %" PRId64 "bp in %d contigs (N50 %" PRId64 ") and %d scaffolds, %d genes, %d alignments, %d true connections.\n",
+		genomeLen, pieceCnt, realN50, groupCnt, geneCnt, readCnt, truthCnt ) ;
+	return 0 ;
+}
@@ -15,19 +15,31 @@
 #include <assert.h>
 #include <math.h>
 #include <set>
+#include <algorithm>
 #include <inttypes.h>
 
 
 #include "defs.h"
 #include "support.hpp" 
 #include "genome.hpp"
+#include "EdgeHash.hpp"
+#include "ThreadPool.hpp"
+#include "Snapshot.hpp"
 
 extern int minimumSupport ;
 extern int minimumEffectiveLength ;
 extern int kmerSize ;
+extern int numOfThreads ;
 extern bool VERBOSE ;
 extern FILE *fpOut ;
 extern bool aggressiveMode ;
+extern double fragLengthQuantile ;
+
+#define GENE_BLOCK_BIN_BITS 16
+#define FRAG_SAMPLE_SIZE 200000
+#define FRAG_HIST_MAX_LENGTH 100000 // longer insert sizes are counted in the last bin of the histogram
+#define GRAPH_BATCH_SIZE 16384 // the number of reads in a batch when building the gene block graph
+#define GRAPH_RECORD_REPEAT 4 // the _graphEdgeRecord::type of the edges of the repeat graph
 
 struct _block
 {
@@ -38,13 +50,107 @@ struct _block
 	Support support ;
 } ;
 
-struct _geneBlock
+// The exon blocks stored as parallel arrays, so the passes scanning the coordinates
+// do not drag the supports into the cache. The element i is the exon block i.
+class ExonBlockArray
 {
-	std::vector<int> exonBlockIds ;
-	int64_t start, end ;
-	int chrId ;
-	int contigId ;
-	Support support ;
+public:
+	std::vector<int> chrId ;
+	std::vector<int> contigId ;
+	std::vector<int64_t> start, end ;
+	std::vector<int64_t> leftSplice, rightSplice ;
+	std::vector<Support> support ;
+
+	int size()
+	{
+		return start.size() ;
+	}
+
+	void clear()
+	{
+		chrId.clear() ;
+		contigId.clear() ;
+		start.clear() ;
+		end.clear() ;
+		leftSplice.clear() ;
+		rightSplice.clear() ;
+		support.clear() ;
+	}
+
+	void push_back( const struct _block &b )
+	{
+		chrId.push_back( b.chrId ) ;
+		contigId.push_back( b.contigId ) ;
+		start.push_back( b.start ) ;
+		end.push_back( b.end ) ;
+		leftSplice.push_back( b.leftSplice ) ;
+		rightSplice.push_back( b.rightSplice ) ;
+		support.push_back( b.support ) ;
+	}
+
+	// Append the element i of another array
+	void push_back( const ExonBlockArray &in, int i )
+	{
+		chrId.push_back( in.chrId[i] ) ;
+		contigId.push_back( in.contigId[i] ) ;
+		start.push_back( in.start[i] ) ;
+		end.push_back( in.end[i] ) ;
+		leftSplice.push_back( in.leftSplice[i] ) ;
+		rightSplice.push_back( in.rightSplice[i] ) ;
+		support.push_back( in.support[i] ) ;
+	}
+} ;
+
+// The gene blocks stored as parallel arrays. 
+// The exon blocks of gene block i are exonIds[ exonOffset[i] ... exonOffset[i + 1] - 1 ].
+class GeneBlockArray
+{
+public:
+	std::vector<int> chrId ;
+	std::vector<int> contigId ;
+	std::vector<int64_t> start, end ;
+	std::vector<Support> support ;
+	std::vector<int> exonOffset ;
+	std::vector<int> exonIds ;
+
+	GeneBlockArray()
+	{
+		exonOffset.push_back( 0 ) ;
+	}
+
+	int size()
+	{
+		return start.size() ;
+	}
+
+	// Create a new gene block with one exon block
+	void push_back( int c, int ctg, int64_t s, int64_t e, int exonId )
+	{
+		chrId.push_back( c ) ;
+		contigId.push_back( ctg ) ;
+		start.push_back( s ) ;
+		end.push_back( e ) ;
+		support.push_back( Support() ) ;
+		exonIds.push_back( exonId ) ;
+		exonOffset.push_back( exonIds.size() ) ;
+	}
+
+	// Add an exon block to the last gene block
+	void AddExon( int exonId )
+	{
+		exonIds.push_back( exonId ) ;
+		++exonOffset.back() ;
+	}
+
+	int GetExonCount( int i )
+	{
+		return exonOffset[i + 1] - exonOffset[i] ;
+	}
+
+	int GetExonId( int i, int j )
+	{
+		return exonIds[ exonOffset[i] + j ] ;
+	}
 } ;
 
 struct _cigar
@@ -57,7 +163,7 @@ struct _cigar
 struct _edge
 {
 	int u, v ; // node u and v are connected
-	Support support ;
+	EdgeSupport support ;
 } ;
 
 // bi-directional edge
@@ -76,18 +182,178 @@ struct _mateEdge
 			 // Only when two semiValid is false, the whole connection fails.
 } ;
 
+// The compact edge of the gene block graph after cleaning, 
+// only keeps the summary of the support we use.
+struct _compactMateEdge
+{
+	int u, v ;
+	int supportUse ;
+	int support ; // the count of support[ supportUse ]
+	bool unique ; // whether support[ supportUse ] is mostly from unique alignments
+} ;
+
+// An edge of the repeat graph, connecting the gene blocks by the CC and CP fields
+struct _repeatEdge
+{
+	int u, v ;
+	int support ;
+} ;
+
+// A read pair sampled for the fragment length model
+struct _fragSample
+{
+	int chrId ;
+	int readLength ;
+	int64_t lastStart, lastEnd ; // the coordinate of the last segment of the read
+	int64_t mPos ;
+} ;
+
+// A read of the batch for building the gene block graph
+struct _graphRead
+{
+	int chrId ;
+	int64_t start ;
+	int tag ; // the first gene block ending at or after start
+	int mChrId ;
+	int64_t mPos ;
+	int cChrId ; // the position from the CC and CP fields
+	int64_t cPos ;
+	bool hasRepeat ;
+	bool isReverse, isMateReverse ;
+	int status ; // GRAPH_READ_*
+	struct _alignmentSummary summary ;
+} ;
+
+// An edge found from a read before it is merged into the graphs
+struct _graphEdgeRecord
+{
+	int u, v ;
+	int readId ; // the index of the read in the batch
+	int type ; // 0-3: the direction tag of a gene block graph edge, GRAPH_RECORD_REPEAT: a repeat graph edge
+} ;
+
+bool CompGraphEdgeRecord( const struct _graphEdgeRecord &a, const struct _graphEdgeRecord &b )
+{
+	bool ra = ( a.type == GRAPH_RECORD_REPEAT ) ;
+	bool rb = ( b.type == GRAPH_RECORD_REPEAT ) ;
+	if ( ra != rb )
+		return rb ;
+	if ( a.u != b.u )
+		return a.u < b.u ;
+	if ( a.v != b.v )
+		return a.v < b.v ;
+	return a.readId < b.readId ;
+}
+
+bool CompGraphEdgeRecordByRead( const struct _graphEdgeRecord &a, const struct _graphEdgeRecord &b )
+{
+	if ( a.readId != b.readId )
+		return a.readId < b.readId ;
+	return a.type < b.type ;
+}
+
 struct _geneBlockBubble
 {
 	int u ;
 	int j1, j2 ; 
 } ;
 
+// The rules of CleanGeneBlockGraph invalidating an edge, an edge is counted by the first rule invalidating it.
+#define CLEAN_RULE_AMBIGUOUS_EXTENSION 0
+#define CLEAN_RULE_SHORT_AMBIGUOUS_BLOCK 1
+#define CLEAN_RULE_AMBIGUOUS_SUPPORT 2
+#define CLEAN_RULE_LOW_SUPPORT 3
+#define CLEAN_RULE_STRAND 4
+#define CLEAN_RULE_REPEAT_FAMILY 5
+#define CLEAN_RULE_KMER_FAMILY 6
+#define CLEAN_RULE_ONE_SIDE 7
+#define CLEAN_RULE_SEMI_VALID 8
+#define CLEAN_RULE_SYMMETRY 9
+#define CLEAN_RULE_SHORT_GENE_BLOCK 10
+#define CLEAN_RULE_COUNT 11
+
+const char *cleanRuleNames[] = { "ambiguousExtension", "shortAmbiguousBlock", "ambiguousSupport", "lowSupport", "strand",
+	"repeatFamily", "kmerFamily", "oneSide", "semiValid", "symmetry", "shortGeneBlock" } ;
+
+// What a read of BuildGeneBlockGraph gives
+#define GRAPH_READ_EDGE 0
+#define GRAPH_READ_NO_BLOCK 1 // the read or its mate is not in an exon block of a gene block
+#define GRAPH_READ_SAME_BLOCK 2 // the mates are in the same gene block
+#define GRAPH_READ_FAR_MATE 3 // the insert size is too large
+
+// The counters of building and cleaning the gene block graph for -stats
+struct _graphStat
+{
+	int64_t noBlock ;
+	int64_t sameBlock ;
+	int64_t farMate ;
+	int64_t edgeReads ; // the reads supporting an edge of the gene block graph
+	int64_t edges ; // the edges added to the gene block graph
+	int64_t repeatEdges ; // the edges added to the repeat graph
+	int64_t clippedEdges ; // the edges added by the clipped alignments
+	int64_t invalidated[ CLEAN_RULE_COUNT ] ;
+} ;
+
 class Blocks
 {
 	private:
-		std::vector<struct _block> exonBlocks ;
+		ExonBlockArray exonBlocks ;
 		std::map<int, int> exonBlocksChrIdOffset ;
-		std::map<int, struct _pair> geneBlocksChrIdOffset ;
+		GeneBlockArray geneBlocks ;
+
+		std::vector<struct _pair> geneBlocksChrIdOffset ; // indexed by chr id, the range of gene blocks on it. a=-1 if none.
+
+		// Gene blocks are binned by every 2^GENE_BLOCK_BIN_BITS bp of a chromosome. geneBlockBin[ geneBlockBinOffset[chrId] + b ]
+		// is the first gene block on the chromosome ending at or after the start of bin b. 
+		std::vector<int> geneBlockBinOffset ;
+		std::vector<int> geneBlockBin ;
+		int prevFoundGeneBlock ;
+
+		// Reservoir sample of the read pairs over the whole exon block pass.
+		// The pairs within one exon block decide the fragment length model.
+		std::vector<struct _fragSample> fragSamples ;
+		int64_t fragCandidateCnt ;
+		uint64_t randSeed ;
+		std::vector<int> fragLengthHist ; // the histogram of the insert sizes
+
+		// A linear congruential generator, so the sampling is reproducible.
+		uint64_t NextRandom()
+		{
+			randSeed = randSeed * 6364136223846793005ull + 1442695040888963407ull ;
+			return randSeed >> 33 ;
+		}
+
+		void SampleFragment( Alignments &alignments )
+		{
+			int i ;
+			int segCnt = alignments.segCnt ;
+			struct _pair *segments = alignments.segments ;
+			int mChrId ;
+			int64_t mPos ;
+
+			alignments.GetMatePosition( mChrId, mPos ) ;
+			if ( mChrId != alignments.GetChromId() || mPos < segments[0].a )
+				return ;
+
+			struct _fragSample sample ;
+			sample.chrId = mChrId ;
+			sample.readLength = 0 ;
+			for ( i = 0 ; i < segCnt ; ++i )
+				sample.readLength += segments[i].b - segments[i].a + 1 ;
+			sample.lastStart = segments[ segCnt - 1 ].a ;
+			sample.lastEnd = segments[ segCnt - 1 ].b ;
+			sample.mPos = mPos ;
+
+			++fragCandidateCnt ;
+			if ( (int)fragSamples.size() < FRAG_SAMPLE_SIZE )
+				fragSamples.push_back( sample ) ;
+			else
+			{
+				int64_t r = NextRandom() % fragCandidateCnt ;
+				if ( r < FRAG_SAMPLE_SIZE )
+					fragSamples[r] = sample ;
+			}
+		}
 
 		int GetFather( int tag, int *father )
 		{
@@ -97,15 +363,143 @@ class Blocks
 		}
 
 		int *repeatFather ;
+		std::vector<struct _repeatEdge> repeatEdges ; // the edges of the repeat graph in the order of u
+
+		// Get the sets of repeated gene blocks
+		void BuildRepeatFather()
+		{
+			int i ;
+			int geneBlockCnt = geneBlocks.size() ;
+			int edgeCnt = repeatEdges.size() ;
+
+			if ( repeatFather != NULL )
+				delete[] repeatFather ;
+			repeatFather = new int[ geneBlockCnt ] ;
+			for ( i = 0 ; i < geneBlockCnt ; ++i )
+				repeatFather[i] = i ;
+
+			for ( i = 0 ; i < edgeCnt ; ++i )
+			{
+				//TODO: check the threshold
+				if ( repeatEdges[i].support >= minimumSupport ) 
+				{
+					int fi = GetFather( repeatEdges[i].u, repeatFather ) ;
+					int fj = GetFather( repeatEdges[i].v, repeatFather ) ;
+					repeatFather[fj] = fi ;
+				}
+			}
+		}
+
+		// Indexed the same way as geneBlocks.exonIds.
+		std::vector<int64_t> geneBlockExonStart ;
+		std::vector<int64_t> geneBlockExonEnd ;
+		std::vector<int64_t> geneBlockExonLenSum ; // prefix sum of the exon lengths between the splice sites.
+
+		// Build the map for the offsets of chr id in the exonBlock list.
+		void BuildExonBlockChrIdOffset()
+		{
+			int cnt = exonBlocks.size() ;
+			exonBlocksChrIdOffset.clear() ;
+			if ( cnt == 0 )
+				return ;
+			exonBlocksChrIdOffset[ exonBlocks.chrId[0]] = 0 ;
+			for ( int i = 1 ; i < cnt ; ++i )
+			{
+				if ( exonBlocks.chrId[i] != exonBlocks.chrId[i - 1] )
+					exonBlocksChrIdOffset[ exonBlocks.chrId[i] ] = i ;
+			}
+		}
+
+		// Flatten the coordinates of the exons in each gene block, so the queries 
+		// from the mate pairs do not need to go through exonBlocks.
+		void BuildGeneBlockExonIndex()
+		{
+			int i, j ;
+			int geneBlockCnt = geneBlocks.size() ;
+			int total = geneBlocks.exonIds.size() ;
+
+			geneBlockExonStart.resize( total ) ;
+			geneBlockExonEnd.resize( total ) ;
+			geneBlockExonLenSum.resize( total + 1 ) ;
+			geneBlockExonLenSum[0] = 0 ;
+			for ( i = 0 ; i < geneBlockCnt ; ++i )
+			{
+				int cnt = geneBlocks.GetExonCount( i ) ;
+				int offset = geneBlocks.exonOffset[i] ;
+				for ( j = 0 ; j < cnt ; ++j )
+				{
+					int e = geneBlocks.GetExonId( i, j ) ; 
+					int l = exonBlocks.leftSplice[e] ;
+					int r = exonBlocks.rightSplice[e] ;
+					if ( l == -1 )
+						l = exonBlocks.start[e] ;
+					if ( r == -1 )
+						r = exonBlocks.end[e] ;
+					geneBlockExonStart[ offset + j ] = exonBlocks.start[e] ;
+					geneBlockExonEnd[ offset + j ] = exonBlocks.end[e] ;
+					geneBlockExonLenSum[ offset + j + 1 ] = geneBlockExonLenSum[ offset + j ] + r - l + 1 ;
+				}
+			}
+		}
+
+		// Build the per-chromosome offsets and the bins for FindGeneBlock.
+		void BuildGeneBlockLocator()
+		{
+			int i, j, k ;
+			int geneBlockCnt = geneBlocks.size() ;
+			int chrCnt = 0 ;
+			for ( i = 0 ; i < geneBlockCnt ; ++i )
+				if ( geneBlocks.chrId[i] + 1 > chrCnt )
+					chrCnt = geneBlocks.chrId[i] + 1 ;
+
+			geneBlocksChrIdOffset.resize( chrCnt ) ;
+			for ( i = 0 ; i < chrCnt ; ++i )
+				geneBlocksChrIdOffset[i].a = geneBlocksChrIdOffset[i].b = -1 ;
+			for ( i = 0 ; i < geneBlockCnt ; ++i )
+			{
+				if ( i == 0 || geneBlocks.chrId[i] != geneBlocks.chrId[i - 1] )
+					geneBlocksChrIdOffset[ geneBlocks.chrId[i] ].a = i ;
+				geneBlocksChrIdOffset[ geneBlocks.chrId[i] ].b = i ;
+			}
+
+			geneBlockBinOffset.resize( chrCnt + 1 ) ;
+			geneBlockBin.clear() ;
+			for ( i = 0 ; i < chrCnt ; ++i )
+			{
+				geneBlockBinOffset[i] = geneBlockBin.size() ;
+				if ( geneBlocksChrIdOffset[i].a == -1 )
+					continue ;
+				int from = geneBlocksChrIdOffset[i].a ;
+				int to = geneBlocksChrIdOffset[i].b ;
+				int binCnt = ( geneBlocks.end[to] >> GENE_BLOCK_BIN_BITS ) + 1 ;
+				
+				for ( j = 0, k = from ; j < binCnt ; ++j )
+				{
+					while ( k < to && geneBlocks.end[k] < ( (int64_t)j << GENE_BLOCK_BIN_BITS ) )
+						++k ;
+					geneBlockBin.push_back( k ) ;
+				}
+			}
+			geneBlockBinOffset[i] = geneBlockBin.size() ;
+			prevFoundGeneBlock = -1 ;
+		}
+
+		// The index of the first gene block on the chromosome, -1 if there is none.
+		int GetGeneBlockChrOffset( int chrId )
+		{
+			if ( chrId < 0 || chrId >= (int)geneBlocksChrIdOffset.size() )
+				return -1 ;
+			return geneBlocksChrIdOffset[ chrId ].a ;
+		}
 
 		// Get the exonic length of a gene block
 		int GetEffectiveLength( int tag )
 		{
-			int cnt = geneBlocks[tag].exonBlockIds.size() ;
+			int cnt = geneBlocks.GetExonCount( tag ) ;
 			int i ;
 			int ret = 0 ;
 			for ( i = 0 ; i < cnt ; ++i )
-				ret += exonBlocks[ geneBlocks[tag].exonBlockIds[i] ].end - exonBlocks[ geneBlocks[tag].exonBlockIds[i] ].start + 1 ;
+				ret += exonBlocks.end[ geneBlocks.GetExonId( tag, i ) ] - exonBlocks.start[ geneBlocks.GetExonId( tag, i ) ] + 1 ;
 			return ret ;
 		}
 
@@ -180,36 +574,85 @@ class Blocks
 			return -1 ;
 		}
 	public:
-		std::vector<struct _geneBlock> geneBlocks ;
 		std::vector<struct _mateEdge> *geneBlockGraph ;
 
+		EdgeHash geneBlockGraphIndex ; // (u,v)->the index of the edge in geneBlockGraph[u], only used when building the graph
+
+		// The gene block graph frozen in CSR form at the end of CleanGeneBlockGraph. The edges of 
+		// gene block u are geneBlockEdges[ geneBlockEdgeOffset[u] ... geneBlockEdgeOffset[u + 1] - 1 ].
+		int *geneBlockEdgeOffset ;
+		struct _compactMateEdge *geneBlockEdges ;
+
 		int readLength ;
 		int fragLength ;
 		int fragStd ;
+		int fragLengthBound ; // the largest insert size for a pair connecting two gene blocks
+
+		struct _graphStat graphStat ;
 
-		Blocks() { geneBlockGraph = NULL ; repeatFather = NULL ; } 	
+		Blocks() 
+		{ 
+			geneBlockGraph = NULL ; repeatFather = NULL ; prevFoundGeneBlock = -1 ; 
+			geneBlockEdgeOffset = NULL ; geneBlockEdges = NULL ;
+			fragCandidateCnt = 0 ; randSeed = 17 ;
+			memset( &graphStat, 0, sizeof( graphStat ) ) ;
+		} 	
 		~Blocks() 
 		{
 			if ( repeatFather != NULL )
 				delete[] repeatFather ;
 			if ( geneBlockGraph != NULL )
 				delete[] geneBlockGraph ;
+			if ( geneBlockEdgeOffset != NULL )
+				delete[] geneBlockEdgeOffset ;
+			if ( geneBlockEdges != NULL )
+				delete[] geneBlockEdges ;
+		}
+
+		// Take the exon blocks and the gene blocks built elsewhere, e.g. the synthetic ones of the micro-benchmark.
+		// The exon blocks of a gene block should be consecutive and sorted by coordinate.
+		void SetBlocks( const ExonBlockArray &exons, const GeneBlockArray &genes )
+		{
+			exonBlocks = exons ;
+			geneBlocks = genes ;
+			BuildExonBlockChrIdOffset() ;
+			BuildGeneBlockExonIndex() ;
+			BuildGeneBlockLocator() ;
+		}
+
+		// Move the active blocks ending before pos to the final list. 
+		void RetireActiveExonBlocks( std::map<int64_t, struct _block> &activeBlocks, int64_t pos, bool all = false )
+		{
+			while ( !activeBlocks.empty() && ( all || activeBlocks.begin()->second.end < pos ) )
+			{
+				exonBlocks.push_back( activeBlocks.begin()->second ) ;
+				activeBlocks.erase( activeBlocks.begin() ) ;
+			}
 		}
 
 		int BuildExonBlocks( Alignments &alignments, Genome &genome )
 		{
-			unsigned int tag = 0 ;
+			// Since the alignments are sorted, only the blocks ending after the start of the 
+			// current read can still change. Those active blocks are kept in a balanced tree 
+			// keyed by the start, and the others are appended to exonBlocks in order.
+			std::map<int64_t, struct _block> activeBlocks ;
+			std::map<int64_t, struct _block>::iterator it, nextIt ;
+			int activeChrId = -1 ;
+
 			while ( alignments.Next() )
 			{
-				int i, j, k ;
+				int i ;
 				int segCnt = alignments.segCnt ;
 				struct _pair *segments = alignments.segments ;
 
-				while ( tag < exonBlocks.size() && ( exonBlocks[tag].end < segments[0].a - 1 
-							|| exonBlocks[tag].chrId != alignments.GetChromId() ) )  
+				if ( alignments.GetChromId() != activeChrId )
 				{
-					++tag ;
+					RetireActiveExonBlocks( activeBlocks, 0, true ) ;
+					activeChrId = alignments.GetChromId() ;
 				}
+				else
+					RetireActiveExonBlocks( activeBlocks, segments[0].a - 1 ) ;
+				SampleFragment( alignments ) ;
 
 				for ( i = 0 ; i < segCnt ; ++i )
 				{
@@ -222,15 +665,21 @@ class Blocks
 					else if ( i > 0 && i < segCnt == 1 )
 						alignments.SetStrandWeight( 1.0 / ( segCnt - 1 ) ) ;
 
-					for ( j = tag ; j < (int)exonBlocks.size() ; ++j )
+					// Find the first block whose end >= segments[i].a - 1.
+					// The blocks are disjoint, so it is either the block containing segments[i].a - 1 
+					// or the first block starting after that.
+					it = activeBlocks.upper_bound( segments[i].a - 1 ) ;
+					if ( it != activeBlocks.begin() )
 					{
-						if ( exonBlocks[j].end >= segments[i].a - 1 )
-							break ;
+						std::map<int64_t, struct _block>::iterator prevIt = it ;
+						--prevIt ;
+						if ( prevIt->second.end >= segments[i].a - 1 )
+							it = prevIt ;
 					}
 
-					if ( j >= (int)exonBlocks.size() )
+					if ( it == activeBlocks.end() || it->second.start > segments[i].b + 1 )
 					{
-						// Append a new block
+						// No overlap, add a new block 
 						struct _block newSeg ;
 						newSeg.chrId = alignments.GetChromId() ;
 						newSeg.start = segments[i].a ;
@@ -244,161 +693,108 @@ class Blocks
 						if ( i < segCnt - 1 )
 							newSeg.rightSplice = segments[i].b ;
 
-						exonBlocks.push_back( newSeg ) ;
+						activeBlocks[ newSeg.start ] = newSeg ;
 					}
-					else if ( exonBlocks[j].end < segments[i].b || 
-							( exonBlocks[j].start > segments[i].a && exonBlocks[j].start <= segments[i].b + 1 ) ) 
-					{
-						// If overlaps with a current exon block, so we extend it
-						if ( exonBlocks[j].end < segments[i].b )
+					else if ( it->second.end < segments[i].b )
+					{
+						// extends toward right 
+						struct _block &block = it->second ;
+						block.end = segments[i].b ;
+						block.support.Add( alignments ) ;
+						if ( i > 0 && ( block.leftSplice == -1 || segments[i].a < block.leftSplice ) )
+							block.leftSplice = segments[i].a ;
+						if ( i < segCnt - 1 && segments[i].b > block.rightSplice )
+							block.rightSplice = segments[i].b ;
+
+						// Merge with next few exon blocks
+						nextIt = it ;
+						++nextIt ;
+						while ( nextIt != activeBlocks.end() && nextIt->second.start <= block.end + 1 )
 						{
-							// extends toward right 
-							exonBlocks[j].end = segments[i].b ;
-							exonBlocks[j].support.Add( alignments ) ;
-							if ( i > 0 && ( exonBlocks[j].leftSplice == -1 || segments[i].a < exonBlocks[j].leftSplice ) )
-								exonBlocks[j].leftSplice = segments[i].a ;
-							if ( i < segCnt - 1 && segments[i].b > exonBlocks[j].rightSplice )
-								exonBlocks[j].rightSplice = segments[i].b ;
-
-							// Merge with next few exon blocks
-							for ( k = j + 1 ; k < (int)exonBlocks.size() ; ++k )
-							{
-								if ( exonBlocks[k].start <= exonBlocks[j].end + 1 )
-								{
-									if ( exonBlocks[k].end > exonBlocks[j].end )
-										exonBlocks[j].end = exonBlocks[k].end ;
+							struct _block &next = nextIt->second ;
+							if ( next.end > block.end )
+								block.end = next.end ;
 
-									if ( exonBlocks[k].leftSplice != -1 && ( exonBlocks[j].leftSplice == -1 || exonBlocks[k].leftSplice < exonBlocks[j].leftSplice ) )
-										exonBlocks[j].leftSplice = exonBlocks[k].leftSplice ;
-									if ( exonBlocks[k].rightSplice != -1 && exonBlocks[k].rightSplice > exonBlocks[j].rightSplice )
-										exonBlocks[j].rightSplice = exonBlocks[k].rightSplice ;
-
-									exonBlocks[j].support.Add( exonBlocks[k].support ) ;
-								}
-								else
-									break ;
-							}
+							if ( next.leftSplice != -1 && ( block.leftSplice == -1 || next.leftSplice < block.leftSplice ) )
+								block.leftSplice = next.leftSplice ;
+							if ( next.rightSplice != -1 && next.rightSplice > block.rightSplice )
+								block.rightSplice = next.rightSplice ;
 
-							if ( k > j + 1 )
-							{
-								// Remove the merged blocks
-								int a, b ;
-								for ( a = j + 1, b = k ; b < (int)exonBlocks.size() ; ++a, ++b )
-									exonBlocks[a] = exonBlocks[b] ;
-								for ( a = 0 ; a < k - ( j + 1 ) ; ++a )
-									exonBlocks.pop_back() ;
-							}
+							block.support.Add( next.support ) ;
+							activeBlocks.erase( nextIt++ ) ;
 						}
-						else if ( exonBlocks[j].start > segments[i].a && exonBlocks[j].start <= segments[i].b + 1 ) 
+					}
+					else if ( it->second.start > segments[i].a )
+					{
+						// extends toward left, which changes the key.
+						struct _block block = it->second ;
+						activeBlocks.erase( it ) ;
+
+						block.start = segments[i].a ;
+						block.support.Add( alignments ) ;
+						if ( i > 0 && ( block.leftSplice == -1 || segments[i].a < block.leftSplice ) )
+							block.leftSplice = segments[i].a ;
+						if ( i < segCnt - 1 && segments[i].b > block.rightSplice )
+							block.rightSplice = segments[i].b ;
+
+						// Merge with few previous exon blocks. The merged block keeps 
+						// the end and the splice sites of the leftmost one.
+						while ( !activeBlocks.empty() )
 						{
-							// extends toward left
-							exonBlocks[j].start = segments[i].a ;
-							exonBlocks[j].support.Add( alignments ) ;
-							if ( i > 0 && ( exonBlocks[j].leftSplice == -1 || segments[i].a < exonBlocks[j].leftSplice ) )
-								exonBlocks[j].leftSplice = segments[i].a ;
-							if ( i < segCnt - 1 && segments[i].b > exonBlocks[j].rightSplice )
-								exonBlocks[j].rightSplice = segments[i].b ;
-
-							// Merge with few previous exon blocks
-							for ( k = j - 1 ; k >= 0 ; --k )
-							{
-								if ( exonBlocks[k].end >= exonBlocks[k + 1].start - 1 )
-								{
-									if ( exonBlocks[k + 1].start < exonBlocks[k].start )
-									{
-										exonBlocks[k].start = exonBlocks[k + 1].start ;
-									}
-
-									if ( exonBlocks[k].leftSplice != -1 && ( exonBlocks[j].leftSplice == -1 || exonBlocks[k].leftSplice < exonBlocks[j].leftSplice ) )
-										exonBlocks[j].leftSplice = exonBlocks[k].leftSplice ;
-									if ( exonBlocks[k].rightSplice != -1 && exonBlocks[k].rightSplice > exonBlocks[j].rightSplice )
-										exonBlocks[j].rightSplice = exonBlocks[k].rightSplice ;
-
-									exonBlocks[k].support.Add( exonBlocks[k + 1].support ) ;
-								}
-								else
-									break ;
-							}
-
-							if ( k < j - 1 )
-							{
-								int a, b ;
-								for ( a = k + 2, b = j + 1 ; b < (int)exonBlocks.size() ; ++a, ++b )
-									exonBlocks[a] = exonBlocks[b] ;
-								for ( a = 0 ; a < ( j - 1 ) - k ; ++a )
-									exonBlocks.pop_back() ;
-
-							}
+							it = activeBlocks.lower_bound( block.start ) ;
+							if ( it == activeBlocks.begin() )
+								break ;
+							--it ;
+							if ( it->second.end < block.start - 1 )
+								break ;
+							struct _block prev = it->second ;
+							activeBlocks.erase( it ) ;
+							if ( block.start < prev.start )
+								prev.start = block.start ;
+							prev.support.Add( block.support ) ;
+							block = prev ;
 						}
-					}
-					else if ( exonBlocks[j].start > segments[i].b + 1 )
-					{
-						int size = exonBlocks.size() ;
-						int a ;
-						// No overlap, insert a new block
-						struct _block newSeg ;
-						newSeg.chrId = alignments.GetChromId() ;
-						newSeg.start = segments[i].a ;
-						newSeg.end = segments[i].b ;
-						newSeg.support.Add( alignments ) ;
-
-						newSeg.leftSplice = -1 ;
-						newSeg.rightSplice = -1 ;
-						if ( i > 0 )
-							newSeg.leftSplice = segments[i].a ; 
-						if ( i < segCnt - 1 )
-							newSeg.rightSplice = segments[i].b ;
-
-						// Insert at position j
-						exonBlocks.push_back( newSeg ) ;	
-						for ( a = size ; a > j ; --a )
-							exonBlocks[a] = exonBlocks[a - 1] ;
-						exonBlocks[a] = newSeg ;
+						activeBlocks[ block.start ] = block ;
 					}
 					else
 					{
-						// The segment is contained in j
-						exonBlocks[j].support.Add( alignments ) ;
+						// The segment is contained in the block
+						it->second.support.Add( alignments ) ;
 					}
 				}
 			}
+			RetireActiveExonBlocks( activeBlocks, 0, true ) ;
 
 			/*for ( int i = 0 ; i < (int)exonBlocks.size() ; ++i )
 			  {
-			  printf( "%d %d %d\n", exonBlocks[i].start, exonBlocks[i].end, exonBlocks[i].support.GetCount() ) ;
+			  printf( "%d %d %d\n", exonBlocks.start[i], exonBlocks.end[i], exonBlocks.support[i].GetCount() ) ;
 			  }*/	
 
 			if ( exonBlocks.size() > 0 )
 			{
-				// Build the map for the offsets of chr id in the exonBlock list.
-				exonBlocksChrIdOffset[ exonBlocks[0].chrId] = 0 ;
-				int cnt = exonBlocks.size() ;
-				for ( int i = 1 ; i < cnt ; ++i )
-				{
-					if ( exonBlocks[i].chrId != exonBlocks[i - 1].chrId )
-						exonBlocksChrIdOffset[ exonBlocks[i].chrId ] = i ;
-				}
+				BuildExonBlockChrIdOffset() ;
 
 				// Put the contig id.
+				int cnt = exonBlocks.size() ;
 				if ( genome.IsOpen() )
 				{
 					for ( int i = 0 ; i < cnt ; ++i )
 					{
-						int id1 = genome.GetContigId( exonBlocks[i].chrId, exonBlocks[i].start ) ;
-						int id2 = genome.GetContigId( exonBlocks[i].chrId, exonBlocks[i].end ) ;
+						int id1 = genome.GetContigId( exonBlocks.chrId[i], exonBlocks.start[i] ) ;
+						int id2 = genome.GetContigId( exonBlocks.chrId[i], exonBlocks.end[i] ) ;
 
 						if ( id1 == -1 && id2 == -1 )
-							exonBlocks[i].contigId = -1 ; // TODO: should not happen, remove it if necessary
+							exonBlocks.contigId[i] = -1 ; // TODO: should not happen, remove it if necessary
 						else if ( id1 != -1 )
-							exonBlocks[i].contigId = id1 ;
+							exonBlocks.contigId[i] = id1 ;
 						else
-							exonBlocks[i].contigId = id2 ;
+							exonBlocks.contigId[i] = id2 ;
 					}
 				}
 				else
 				{
 					for ( int i = 0 ; i < cnt ; ++i )
-						exonBlocks[i].contigId = exonBlocks[i].chrId ;
+						exonBlocks.contigId[i] = exonBlocks.chrId[i] ;
 				}
 			}
 			return exonBlocks.size() ;
@@ -408,8 +804,8 @@ class Blocks
 		// Notice that how to control the number of support
 		int ExtendExonBlocks( Blocks &otherBlocks )
 		{
-			std::vector<struct _block> origExonBlocks( exonBlocks ) ; 
-			std::vector<struct _block> &otherExonBlocks = otherBlocks.exonBlocks ;
+			ExonBlockArray origExonBlocks( exonBlocks ) ; 
+			ExonBlockArray &otherExonBlocks = otherBlocks.exonBlocks ;
 
 
 			exonBlocks.clear() ;
@@ -423,25 +819,25 @@ class Blocks
 				if ( i >= origSize && j >= otherSize )
 					break ;
 
-				if ( i < origSize && ( j >= otherSize || origExonBlocks[i].chrId < otherExonBlocks[j].chrId ||
-						( origExonBlocks[i].chrId == otherExonBlocks[j].chrId && origExonBlocks[i].start <= otherExonBlocks[j].start ) ) )
+				if ( i < origSize && ( j >= otherSize || origExonBlocks.chrId[i] < otherExonBlocks.chrId[j] ||
+						( origExonBlocks.chrId[i] == otherExonBlocks.chrId[j] && origExonBlocks.start[i] <= otherExonBlocks.start[j] ) ) )
 				{
-					if ( ret >= 0 && exonBlocks[ret].chrId == origExonBlocks[i].chrId && origExonBlocks[i].start <= exonBlocks[ret].end )	
+					if ( ret >= 0 && exonBlocks.chrId[ret] == origExonBlocks.chrId[i] && origExonBlocks.start[i] <= exonBlocks.end[ret] )	
 					{
 						// merge into the current block
 						if ( !containOrig )
-							exonBlocks[ret].support = origExonBlocks[i].support ;
+							exonBlocks.support[ret] = origExonBlocks.support[i] ;
 						else
 						{
-							exonBlocks[ret].support.Add( origExonBlocks[i].support ) ;
+							exonBlocks.support[ret].Add( origExonBlocks.support[i] ) ;
 						}
-						if ( origExonBlocks[i].end > exonBlocks[ret].end )
-							exonBlocks[ret].end = origExonBlocks[i].end ;
+						if ( origExonBlocks.end[i] > exonBlocks.end[ret] )
+							exonBlocks.end[ret] = origExonBlocks.end[i] ;
 						containOrig = true ;
 					}
 					else
 					{
-						exonBlocks.push_back( origExonBlocks[i] ) ;
+						exonBlocks.push_back( origExonBlocks, i ) ;
 						containOrig = true ;
 						++ret ;
 					}
@@ -449,19 +845,19 @@ class Blocks
 				}
 				else
 				{
-					if ( ret >= 0 && exonBlocks[ret].chrId == otherExonBlocks[j].chrId && otherExonBlocks[j].start <= exonBlocks[ret].end )	
+					if ( ret >= 0 && exonBlocks.chrId[ret] == otherExonBlocks.chrId[j] && otherExonBlocks.start[j] <= exonBlocks.end[ret] )	
 					{
 						// merge into the current block
 						if ( !containOrig )
-							exonBlocks[ret].support.Add( otherExonBlocks[j].support ) ;
-						if ( otherExonBlocks[j].end > exonBlocks[ret].end )
-							exonBlocks[ret].end = otherExonBlocks[j].end ;
+							exonBlocks.support[ret].Add( otherExonBlocks.support[j] ) ;
+						if ( otherExonBlocks.end[j] > exonBlocks.end[ret] )
+							exonBlocks.end[ret] = otherExonBlocks.end[j] ;
 						containOrig = false ;
 					}
 					else
 					{
-						exonBlocks.push_back( otherExonBlocks[j] ) ;
-						//exonBlocks[ret + 1].support.Clear() ;
+						exonBlocks.push_back( otherExonBlocks, j ) ;
+						//exonBlocks.support[ret + 1].Clear() ;
 						containOrig = false ;
 						++ret ;
 					}
@@ -471,93 +867,68 @@ class Blocks
 
 			// Rebuild the map for the offsets of chr id in the exonBlock list.
 			if ( ret >= 0 )
-			{
-				exonBlocksChrIdOffset.clear() ;
-
-				exonBlocksChrIdOffset[ exonBlocks[0].chrId] = 0 ;
-				int cnt = exonBlocks.size() ;
-				for ( int i = 1 ; i < cnt ; ++i )
-				{
-					if ( exonBlocks[i].chrId != exonBlocks[i - 1].chrId )
-						exonBlocksChrIdOffset[ exonBlocks[i].chrId ] = i ;
-				}
-			}
+				BuildExonBlockChrIdOffset() ;
 
 			return ret + 1 ;
 		}
 
-		void GetAlignmentsInfo( Alignments &alignments )
+		// Compute the read length and the fragment length model from the pairs
+		// sampled in BuildExonBlocks. Only the pairs falling in one exon block are used.
+		void GetAlignmentsInfo()
 		{
-			int tag = 0 ;
+			int i ;
 			int64_t totalReadLength = 0 ;
 			int readCnt = 0 ;
 			int64_t sum = 0 ;
 			int64_t sqSum = 0 ;
 			int exonBlockCnt = exonBlocks.size() ;
+			int sampleCnt = fragSamples.size() ;
 
-			while ( alignments.Next() && readCnt < 100000 )	
+			fragLengthHist.clear() ;
+			for ( i = 0 ; i < sampleCnt ; ++i )
 			{
-				int i, j, k ;
-				int segCnt = alignments.segCnt ;
-				struct _pair *segments = alignments.segments ;
+				struct _fragSample &sample = fragSamples[i] ;
 
-				if ( tag < exonBlockCnt && alignments.GetChromId() != exonBlocks[tag].chrId )
+				// The first exon block on the chromosome ending at or after the last segment.
+				int l = 0, r = exonBlockCnt - 1, m ;
+				while ( l <= r )
 				{
-					std::map<int, int>::iterator it ;
-
-					it = exonBlocksChrIdOffset.find( alignments.GetChromId() ) ;
-
-					if ( it != exonBlocksChrIdOffset.end() )
-					{
-						if ( tag < it->second )
-							tag = it->second ;
-						else
-							continue ;
-					}
+					m = ( l + r ) / 2 ;
+					if ( exonBlocks.chrId[m] < sample.chrId || 
+						( exonBlocks.chrId[m] == sample.chrId && exonBlocks.end[m] < sample.lastEnd ) )
+						l = m + 1 ;
 					else
-						continue ; // skip this read
-				}
-
-				while ( tag < exonBlockCnt && exonBlocks[tag].end < segments[0].a && 
-						exonBlocks[tag].chrId == alignments.GetChromId() )
-				{
-					++tag ;
+						r = m - 1 ;
 				}
-
-				int64_t mPos ;
-				int mChrId ;
-
-				k = -1 ;
-				for ( j = tag ; j < exonBlockCnt && exonBlocks[j].end < segments[segCnt - 1].b 
-						&& exonBlocks[j].chrId == alignments.GetChromId() ; ++j )	
-					;
-				if ( j < exonBlockCnt && exonBlocks[j].chrId == alignments.GetChromId() && exonBlocks[j].start <= segments[ segCnt - 1 ].a )
-				{
-					k = j ;
-				}
-				if ( k == -1 )
+				int j = l ;
+				if ( j >= exonBlockCnt || exonBlocks.chrId[j] != sample.chrId || exonBlocks.start[j] > sample.lastStart )
 					continue ;
-				alignments.GetMatePosition( mChrId, mPos ) ;
-
-				if ( mChrId != alignments.GetChromId() || mPos < exonBlocks[j].start || mPos > exonBlocks[j].end || mPos < segments[0].a )
+				if ( sample.mPos < exonBlocks.start[j] || sample.mPos > exonBlocks.end[j] )
 					continue ;
-				int rl = 0 ;
-				for ( i = 0 ; i < segCnt ; ++i )
-				{
-					rl += segments[i].b - segments[i].a + 1 ;
-				}
-				totalReadLength += rl ;
-				int tmp = 2 * rl + mPos - segments[ segCnt - 1 ].a - 1 ;
+
+				totalReadLength += sample.readLength ;
+				int tmp = 2 * sample.readLength + sample.mPos - sample.lastStart - 1 ;
 				sum += tmp ;
 				sqSum += tmp * tmp ;
 				++readCnt ;
+
+				if ( tmp < 0 )
+					tmp = 0 ;
+				else if ( tmp > FRAG_HIST_MAX_LENGTH )
+					tmp = FRAG_HIST_MAX_LENGTH ;
+				if ( tmp >= (int)fragLengthHist.size() )
+					fragLengthHist.resize( tmp + 1, 0 ) ;
+				++fragLengthHist[tmp] ;
 			}
+			std::vector<struct _fragSample>().swap( fragSamples ) ;
 
 			assert( readCnt > 30 ) ;
 
 			readLength = totalReadLength / readCnt ;
 			fragLength = sum / readCnt ;
 			fragStd = sqrt( (double)sqSum / readCnt - fragLength * fragLength ) ;
+
+			SetFragLengthBound() ;
 			//fprintf( stderr, "Fragment length: %d std: %d\n", (int)fragLength, (int)fragStd ) ;
 			/*readLength = 100 ;
 			  fragLength = 200 ;
@@ -565,65 +936,215 @@ class Blocks
 		}
 
 
-		int BuildGeneBlocks( Alignments &alignments, Genome &genome )
+		// Add the alignment to the edge (u,v) of the exon block graph in the window starting at windowStart.
+		void AddExonBlockEdge( int u, int v, Alignments &alignments, std::vector< std::vector<struct _edge> > &adj, 
+			EdgeHash &adjIndex, int windowStart )
 		{
-			int i, j, k ;
-			int exonBlockCnt = exonBlocks.size() ;
-			int tag = 0 ;
+			int j = adjIndex.Find( u, v ) ;
+			if ( j != -1 )
+				adj[u - windowStart][j].support.Add( alignments ) ; 
+			else
+			{
+				struct _edge newP ;
+				newP.u = u ;
+				newP.v = v ;
+				newP.support.Add( alignments ) ;
 
+				adjIndex.Insert( u, v, adj[u - windowStart].size() ) ;
+				adj[u - windowStart].push_back( newP ) ;
+			}
+		}
 
-			//struct _adjGraph *adj = (struct _adjGraph *)malloc( exonBlockCnt * sizeof( *adj ) )  ;
-			std::vector<struct _edge> *adj = new std::vector<struct _edge>[exonBlockCnt] ;
-			int *father = new int[ exonBlockCnt] ;
+		// Cluster the exon blocks in [from, to) into gene blocks. adj[i - from] holds the edges of
+		// exon block i, and the edges never leave the window.
+		void BuildGeneBlocksInWindow( int from, int to, std::vector< std::vector<struct _edge> > &adj, 
+			Genome &genome, int &currentFather )
+		{
+			int i, j ;
+			int cnt = to - from ;
+			if ( cnt <= 0 )
+				return ;
 
-			for ( i = 0 ; i < exonBlockCnt ; ++i )
-			{
+			// The fathers are stored as the indices in the window.
+			int *father = new int[ cnt ] ;
+			for ( i = 0 ; i < cnt ; ++i )
 				father[i] = i ;
-			}
 
-			while ( alignments.Next() )
+			// Clustering the exon blocks
+			for ( i = from ; i < to ; ++i )
 			{
-				int i, j, k ;
-				int segCnt = alignments.segCnt ;
-				struct _pair *segments = alignments.segments ;
-
-				if ( tag < exonBlockCnt && alignments.GetChromId() != exonBlocks[tag].chrId )
+				int size = adj[i - from].size() ;
+				for ( j = 0 ; j < size ; ++j ) 
 				{
-					std::map<int, int>::iterator it ;
-
-					it = exonBlocksChrIdOffset.find( alignments.GetChromId() ) ;
-
-					if ( it != exonBlocksChrIdOffset.end() )
-					{
-						if ( tag < it->second )
-							tag = it->second ;
-						else
-							continue ;
-					}
+					//Filter out the connections 
+					if ( exonBlocks.chrId[i] != exonBlocks.chrId[j] && 
+						( !adj[i - from][j].support.IsGood() /*|| adj[i][j].support.GetCount() < minimumSupport */ ) )
+						continue ;
+					
+					int a = GetFather( i - from, father ) ;
+					int b = GetFather( adj[i - from][j].v - from, father ) ;
+					if ( a <= b )
+						father[b] = a ;
 					else
-						continue ; // skip this read
+						father[a] = b ;
 				}
+			}
+			//filter out gene blocks.
+			// We do this in this stage because we will break the gene blocks
+			// when we actually build them due to interleaved genes.
+			struct _pair *geneBlockGoodCnt = new struct _pair[ cnt ] ;
+			bool *validGeneBlock = new bool[ cnt ] ;
 
-				while ( tag < exonBlockCnt && exonBlocks[tag].end < segments[0].a && 
-						exonBlocks[tag].chrId == alignments.GetChromId() )
-				{
-					++tag ;
-				}
+			memset( geneBlockGoodCnt, 0, sizeof( geneBlockGoodCnt[0] ) * cnt ) ;
 
-				//printf( "%s %d\n", __func__, tag ) ;
-				// Find which blocks this read is compatible with
-				int segmentBlocks[MAX_SEG_COUNT] ;
-				//printf( "%d\n", segCnt ) ;
+			for ( i = 0 ; i < cnt ; ++i )
+			{
+				int f = GetFather( i, father ) ;
+				// TODO: we can also look at each exon block.
+				if ( exonBlocks.support[i + from].IsGood() )
+					++geneBlockGoodCnt[f].a ;
+				++geneBlockGoodCnt[f].b ;
+			}
+
+			for ( i = 0 ; i < cnt ; ++i )
+			{
+				if ( father[i] == i )
+				{
+					if ( geneBlockGoodCnt[i].a >= 1 
+							&&  geneBlockGoodCnt[i].a >= 0.2 * geneBlockGoodCnt[i].b )
+						validGeneBlock[i] = true ;
+					else
+						validGeneBlock[i] = false ;
+
+					// Possible pseudo-gene
+					/*if ( geneBlockGoodCnt[i].b == 1 && !exonBlocks.support[i].IsUnique() )
+					  {
+					  validGeneBlock[i] = false ;
+					  }*/
+				}
+			}
+			delete []geneBlockGoodCnt ;
+
+			for ( i = from ; i < to ; ++i )
+			{
+				int f = GetFather( i - from, father ) ;
+				// Ignore the invalid gene blocks.
+				if ( !validGeneBlock[f] )
+					continue ;
+				f += from ;
+				// We split the cluster if the blocks are interleaved.
+				struct _contig prevCtg ;
+				if ( i > 0 )
+					prevCtg = genome.GetContigInfo( exonBlocks.contigId[i - 1] ) ;
+				struct _contig ctg = genome.GetContigInfo( exonBlocks.contigId[i] ) ;
+				if ( f != currentFather || 
+						( i > 0 && ctg.chrId != prevCtg.chrId ) ||
+						/*( i > 0 && exonBlocks.contigId[i] != exonBlocks.contigId[i - 1] && prevCtg.end - prevCtg.start + 1 >= minimumEffectiveLength && 
+								ctg.end - ctg.start + 1 >= minimumEffectiveLength && exonBlocks.end[i] - exonBlocks.start[i - 1] + 1 >= minimumEffectiveLength &&
+								exonBlocks.end[i] - exonBlocks.start[i] >= minimumEffectiveLength ) )*/
+						// The gap is much shorter than the read length which does not allow another contig to put between
+						( i > 0 && exonBlocks.contigId[i] != exonBlocks.contigId[i - 1] ) ) //&& ctg.start - prevCtg.end - 1 >= 5 ) ) 
+				{
+					// Create a new gene block
+					geneBlocks.push_back( exonBlocks.chrId[i], exonBlocks.contigId[i], 
+						exonBlocks.start[i], exonBlocks.end[i], i ) ;
+					currentFather = f ; 
+				}
+				else
+				{
+					// Update the gene block
+					j = geneBlocks.size() - 1 ;
+					assert( j >= 0 ) ;
+					geneBlocks.AddExon( i ) ;
+					if ( exonBlocks.start[i] < geneBlocks.start[j] )
+						geneBlocks.start[j] = exonBlocks.start[i] ;
+					if ( exonBlocks.end[i] > geneBlocks.end[j] )
+						geneBlocks.end[j] = exonBlocks.end[i] ;
+				}
+			}
+			delete[] father ;
+			delete[] validGeneBlock ;
+		}
+
+		// The index after the last exon block on the chromosome of exon block i.
+		int GetExonBlockChrEnd( int i )
+		{
+			std::map<int, int>::iterator it = exonBlocksChrIdOffset.upper_bound( exonBlocks.chrId[i] ) ;
+			if ( it == exonBlocksChrIdOffset.end() )
+				return exonBlocks.size() ;
+			return it->second ;
+		}
+
+		// The alignments are sorted, so the exon blocks of a chromosome can be clustered into
+		// gene blocks once the reads move to the next chromosome. Only the edges of the exon blocks 
+		// on the current chromosome are kept.
+		int BuildGeneBlocks( Alignments &alignments, Genome &genome )
+		{
+			int i, j ;
+			int exonBlockCnt = exonBlocks.size() ;
+			int tag = 0 ;
+			int windowStart = 0 ;
+			int windowEnd = exonBlockCnt > 0 ? GetExonBlockChrEnd( 0 ) : 0 ;
+			int currentFather = -1 ;
+
+			std::vector< std::vector<struct _edge> > adj( windowEnd ) ; // adj[i - windowStart] is the edges of exon block i
+			EdgeHash adjIndex ; // (u,v)->the index of the edge in adj[u - windowStart]
+
+			while ( alignments.Next() )
+			{
+				int i, j, k ;
+				int segCnt = alignments.segCnt ;
+				struct _pair *segments = alignments.segments ;
+
+				if ( tag < exonBlockCnt && alignments.GetChromId() != exonBlocks.chrId[tag] )
+				{
+					std::map<int, int>::iterator it ;
+
+					it = exonBlocksChrIdOffset.find( alignments.GetChromId() ) ;
+
+					if ( it != exonBlocksChrIdOffset.end() )
+					{
+						if ( tag < it->second )
+							tag = it->second ;
+						else
+							continue ;
+					}
+					else
+						continue ; // skip this read
+				}
+
+				while ( tag < exonBlockCnt && exonBlocks.end[tag] < segments[0].a && 
+						exonBlocks.chrId[tag] == alignments.GetChromId() )
+				{
+					++tag ;
+				}
+
+				if ( tag >= windowEnd && tag < exonBlockCnt )
+				{
+					// No more edges for the exon blocks before the chromosome of tag.
+					int chrStart = exonBlocksChrIdOffset[ exonBlocks.chrId[tag] ] ;
+					adj.resize( chrStart - windowStart ) ;
+					BuildGeneBlocksInWindow( windowStart, chrStart, adj, genome, currentFather ) ;
+
+					std::vector< std::vector<struct _edge> >().swap( adj ) ;
+					adjIndex.Clear() ;
+					windowStart = chrStart ;
+					windowEnd = GetExonBlockChrEnd( chrStart ) ;
+					adj.resize( windowEnd - windowStart ) ;
+				}
+
+				// Find which blocks this read is compatible with
+				int segmentBlocks[MAX_SEG_COUNT] ;
 				k = tag ;
 				for ( i = 0 ; i < segCnt ; ++i )
 				{
 					segmentBlocks[i] = -1 ;
-					for ( j = k ; j < exonBlockCnt && exonBlocks[j].end < segments[i].b 
-							&& exonBlocks[j].chrId == alignments.GetChromId() ; ++j )	
+					for ( j = k ; j < exonBlockCnt && exonBlocks.end[j] < segments[i].b 
+							&& exonBlocks.chrId[j] == alignments.GetChromId() ; ++j )	
 						;
-					if ( j < exonBlockCnt && exonBlocks[j].chrId == alignments.GetChromId() )
+					if ( j < exonBlockCnt && exonBlocks.chrId[j] == alignments.GetChromId() )
 					{
-						if ( exonBlocks[j].start <= segments[i].a && exonBlocks[j].end >= segments[i].b )
+						if ( exonBlocks.start[j] <= segments[i].a && exonBlocks.end[j] >= segments[i].b )
 						{
 							segmentBlocks[i] = j ;
 						}
@@ -631,40 +1152,13 @@ class Blocks
 					k = j ;
 				}
 				
-				/*if ( !strcmp( alignments.GetReadId(),  "Id_5023627" ) )
-				{
-					for ( i = 0 ; i < segCnt ; ++i )
-					{
-						printf( "%d\n", segmentBlocks[i] ) ;
-					}
-				}*/
 				// Connect those exon blocks
 				// Notice that the segmentBlocks are already sorted.
-				//continue ;
 				for ( i = 0 ; i < segCnt - 1 ; ++i )
 				{
 					if ( segmentBlocks[i] == -1 || segmentBlocks[i + 1] == -1 )
 						continue ;
-
-					int size = adj[ segmentBlocks[i] ].size() ;
-					for ( j = size - 1 ; j >= 0 ; --j )
-					{
-						if ( adj[ segmentBlocks[i] ][j].v == segmentBlocks[i + 1] )
-						{
-							adj[segmentBlocks[i]][j].support.Add( alignments ) ; 
-							break ;
-						}
-					}
-
-					if ( j < 0 )
-					{
-						struct _edge newP ;
-						newP.u = segmentBlocks[i] ;
-						newP.v = segmentBlocks[i + 1] ;
-						newP.support.Add( alignments ) ;
-
-						adj[ segmentBlocks[i] ].push_back( newP ) ;
-					}
+					AddExonBlockEdge( segmentBlocks[i], segmentBlocks[i + 1], alignments, adj, adjIndex, windowStart ) ;
 				}
 
 				// Also connect the exon blocks by the mate-pair information.
@@ -674,7 +1168,7 @@ class Blocks
 						break ;
 				}
 				
-				if ( segmentBlocks[i] != -1 )
+				if ( i < segCnt && segmentBlocks[i] != -1 )
 				{
 					int mChrId ;
 					int64_t mPos ;
@@ -685,191 +1179,48 @@ class Blocks
 						&& alignments.IsReverse() != alignments.IsMateReverse() && mPos < segments[0].a )
 					{
 						int k = segmentBlocks[i] ;
-						for ( ; k >= 0 ; --k )
+						for ( ; k >= 0 && exonBlocks.chrId[k] == mChrId ; --k )
 						{
-							if ( exonBlocks[k].start <= mPos && mPos <= exonBlocks[k].end )
+							if ( exonBlocks.start[k] <= mPos && mPos <= exonBlocks.end[k] )
 							{
-								int size = adj[ segmentBlocks[i] ].size() ;
-								for ( j = size - 1 ; j >= 0 ; --j )
-								{
-									if ( adj[ segmentBlocks[i] ][j].v == k )
-									{
-										adj[segmentBlocks[i]][j].support.Add( alignments ) ; 
-										break ;
-									}
-								}
-
-								if ( j < 0 )
-								{
-									struct _edge newP ;
-									newP.u = segmentBlocks[i] ;
-									newP.v = k ;
-									newP.support.Add( alignments ) ;
-									adj[ segmentBlocks[i] ].push_back( newP ) ;
-								}
+								AddExonBlockEdge( segmentBlocks[i], k, alignments, adj, adjIndex, windowStart ) ;
 								break ;
 							}
-							if ( exonBlocks[k].chrId != mChrId || mPos > exonBlocks[k].end )
+							if ( mPos > exonBlocks.end[k] )
 								break ;
 						}
 					}
 				}
 			}
-			// Clustering the exon blocks
-			for ( i = 0 ; i < exonBlockCnt ; ++i )
-			{
-				int size = adj[i].size() ;
-				for ( j = 0 ; j < size ; ++j ) 
-				{
-					//Filter out the connections 
-					if ( exonBlocks[i].chrId != exonBlocks[j].chrId && 
-						( !adj[i][j].support.IsGood() /*|| adj[i][j].support.GetCount() < minimumSupport */ ) )
-						continue ;
-					
-					int a = GetFather( i, father ) ;
-					int b = GetFather( adj[i][j].v, father ) ;
-					if ( a <= b )
-						father[b] = a ;
-					else
-						father[a] = b ;
-				}
-			}
-			//printf( "father: %d %d\n", GetFather( 7343, father) , GetFather( 7344, father ),  ) ;
-			//filter out gene blocks.
-			// We do this in this stage because we will break the gene blocks
-			// when we actually build them due to interleaved genes.
-			//Support *geneBlockSupports = new Support[ exonBlockCnt ] ;
-			struct _pair *geneBlockGoodCnt = new struct _pair[ exonBlockCnt ] ;
-			bool *validGeneBlock = new bool[ exonBlockCnt ] ;
-
-			memset( geneBlockGoodCnt, 0, sizeof( geneBlockGoodCnt[0] ) * exonBlockCnt ) ;
-
-			for ( i = 0 ; i < exonBlockCnt ; ++i )
-			{
-				int f = GetFather( i, father ) ;
-				// TODO: we can also look at each exon block.
-				//geneBlockSupports[f].Add( exonBlocks[i].support ) ;
-				if ( exonBlocks[i].support.IsGood() )
-					++geneBlockGoodCnt[f].a ;
-				++geneBlockGoodCnt[f].b ;
-
-				//if ( f == 5 )
-				//	printf( "%d %d %d\n",i, geneBlockGoodCnt[f].a, geneBlockGoodCnt[f].b ) ;
-			}
-
-			for ( i = 0 ; i < exonBlockCnt ; ++i )
-			{
-				if ( father[i] == i )
-				{
-					if ( geneBlockGoodCnt[i].a >= 1 
-							&&  geneBlockGoodCnt[i].a >= 0.2 * geneBlockGoodCnt[i].b )
-						validGeneBlock[i] = true ;
-					else
-						validGeneBlock[i] = false ;
-
-					// Possible pseudo-gene
-					/*if ( geneBlockGoodCnt[i].b == 1 && !exonBlocks[i].support.IsUnique() )
-					  {
-					  validGeneBlock[i] = false ;
-					  }*/
-				}
-				//if ( i == 5 )
-				//	printf( "%d %d %d: %d\n",i, geneBlockGoodCnt[i].a, geneBlockGoodCnt[i].b, validGeneBlock[i] ) ;
-			}
-			delete []geneBlockGoodCnt ;
-
-			int geneBlockCnt = 0 ;
-			int currentFather = -1 ;
-			for ( i = 0 ; i < exonBlockCnt ; ++i )
-			{
-				// Ignore the invalid gene blocks.
-				if ( !validGeneBlock[ GetFather(i, father ) ] )
-					continue ;
-				// We split the cluster if the blocks are interleaved.
-				/*if ( i == 7344 )
-				{
-					printf( "%d: %d %d\n", i, GetFather( i, father ), currentFather ) ;
-				}*/
-				struct _contig prevCtg ;
-				if ( i > 0 )
-					prevCtg = genome.GetContigInfo( exonBlocks[i - 1].contigId ) ;
-				struct _contig ctg = genome.GetContigInfo( exonBlocks[i].contigId ) ;
-				if ( GetFather( i, father ) != currentFather || 
-						( i > 0 && ctg.chrId != prevCtg.chrId ) ||
-						/*( i > 0 && exonBlocks[i].contigId != exonBlocks[i - 1].contigId && prevCtg.end - prevCtg.start + 1 >= minimumEffectiveLength && 
-								ctg.end - ctg.start + 1 >= minimumEffectiveLength && exonBlocks[i].end - exonBlocks[i - 1].start + 1 >= minimumEffectiveLength &&
-								exonBlocks[i].end - exonBlocks[i].start >= minimumEffectiveLength ) )*/
-						// The gap is much shorter than the read length which does not allow another contig to put between
-						( i > 0 && exonBlocks[i].contigId != exonBlocks[i - 1].contigId ) ) //&& ctg.start - prevCtg.end - 1 >= 5 ) ) 
-				{
-					// Create a new gene block
-					struct _geneBlock newBlock ;
-
-					newBlock.chrId = exonBlocks[i].chrId ;
-					newBlock.contigId = exonBlocks[i].contigId ;
-					newBlock.start = exonBlocks[i].start ;
-					newBlock.end = exonBlocks[i].end ;
-					newBlock.exonBlockIds.push_back( i ) ;
-					geneBlocks.push_back( newBlock ) ;
-
-					++geneBlockCnt ;
-					currentFather = GetFather( i, father ) ; 
-				}
-				else
-				{
-					// Update the gene block
-					/*int f = GetFather( i, father ) ;
-					  for ( j = geneBlockCnt - 1 ; j >= 0 ; --j )
-					  {
-					  if ( geneBlocks[j].exonBlockIds[0] == f )
-					  break ;
-					  }
-					 */
-					j = geneBlockCnt - 1 ;
-					assert( j >= 0 ) ;
-					geneBlocks[j].exonBlockIds.push_back( i ) ;
-					if ( exonBlocks[i].start < geneBlocks[j].start )
-						geneBlocks[j].start = exonBlocks[i].start ;
-					if ( exonBlocks[i].end > geneBlocks[j].end )
-						geneBlocks[j].end = exonBlocks[i].end ;
-				}
-			}
-			delete[] adj ;
-			delete[] father ;
-			delete[] validGeneBlock ;
+			adj.resize( exonBlockCnt - windowStart ) ;
+			BuildGeneBlocksInWindow( windowStart, exonBlockCnt, adj, genome, currentFather ) ;
+			std::vector< std::vector<struct _edge> >().swap( adj ) ;
+			int geneBlockCnt = geneBlocks.size() ;
 
 			// Determine the strand of the gene block
 			for ( i = 0 ; i < geneBlockCnt ; ++i )
 			{
-				int cnt = geneBlocks[i].exonBlockIds.size() ;
+				int cnt = geneBlocks.GetExonCount( i ) ;
 				Support support ;
 				for ( j = 0 ; j < cnt ; ++j )
-					support.Add( exonBlocks[ geneBlocks[i].exonBlockIds[j] ].support ) ;
-				geneBlocks[i].support = support ;
+					support.Add( exonBlocks.support[ geneBlocks.GetExonId( i, j ) ] ) ;
+				geneBlocks.support[i] = support ;
 			}
+			BuildGeneBlockExonIndex() ;
 
-			geneBlocksChrIdOffset[ geneBlocks[0].chrId ].a = 0 ;
-			for (  i = 1 ; i < geneBlockCnt ; ++i )
-			{
-				if (  geneBlocks[i].chrId != geneBlocks[i - 1].chrId )
-				{
-					geneBlocksChrIdOffset[ geneBlocks[i].chrId ].a = i ;
-					geneBlocksChrIdOffset[ geneBlocks[i - 1].chrId].b = i - 1 ;
-				}
-			}
-			geneBlocksChrIdOffset[ geneBlocks[i - 1].chrId ].b = i - 1 ;
+			BuildGeneBlockLocator() ;
 
 			if ( VERBOSE )
 			{
 				fprintf( fpOut, "Gene blocks:\n" ) ;
 				for ( i = 0 ; i< geneBlocks.size() ; ++i )
 				{
-					fprintf( fpOut, "geneblock %d: %s %"PRId64" %"PRId64"\n", i, alignments.GetChromName( geneBlocks[i].chrId ), geneBlocks[i].start + 1, geneBlocks[i].end + 1 ) ; 
-					int size = geneBlocks[i].exonBlockIds.size() ;
+					fprintf( fpOut, "geneblock %d: %s %"PRId64" %"PRId64"\n", i, alignments.GetChromName( geneBlocks.chrId[i] ), geneBlocks.start[i] + 1, geneBlocks.end[i] + 1 ) ; 
+					int size = geneBlocks.GetExonCount( i ) ;
 					for ( j = 0 ; j < size ; ++j )
 					{
-						int id = geneBlocks[i].exonBlockIds[j] ;
-						fprintf( fpOut, "\t%d %d: %"PRId64" %"PRId64"\n", j, id, exonBlocks[id].start + 1, exonBlocks[id].end + 1 ) ;
+						int id = geneBlocks.GetExonId( i, j ) ;
+						fprintf( fpOut, "\t%d %d: %"PRId64" %"PRId64"\n", j, id, exonBlocks.start[id] + 1, exonBlocks.end[id] + 1 ) ;
 					}
 				}
 			}
@@ -883,8 +1234,7 @@ class Blocks
 
 		int GetGeneBlockEffectiveSequence( int ind, int flip, char *buffer, Genome &genome )
 		{
-			std::vector<int> &exonBlockIds = geneBlocks[ind].exonBlockIds ;
-			int ecnt = exonBlockIds.size() ;
+			int ecnt = geneBlocks.GetExonCount( ind ) ;
 			int i ;
 			int ret = 0 ;
 
@@ -892,24 +1242,24 @@ class Blocks
 			{
 				for ( i = 0 ; i < ecnt ; ++i )
 				{
-					struct _block &eblock = exonBlocks[ exonBlockIds[i] ] ;
-					int chrId = eblock.chrId ;
+					int id = geneBlocks.GetExonId( ind, i ) ;
+					int chrId = exonBlocks.chrId[id] ;
 
-					for ( int l = eblock.start ; l <= eblock.end ; ++l, ++ret )
+					for ( int l = exonBlocks.start[id] ; l <= exonBlocks.end[id] ; ++l, ++ret )
 					{
 						buffer[ret] = genome.GetNucleotide( chrId, l ) ;
 					}
-					//printf( "++ %d %d %d\n", ret, (int)eblock.start, (int)eblock.end ) ;
+					//printf( "++ %d %d %d\n", ret, (int)exonBlocks.start[id], (int)exonBlocks.end[id] ) ;
 				}
 			}
 			else
 			{
 				for ( i = ecnt - 1 ; i >= 0 ; --i )
 				{
-					struct _block &eblock = exonBlocks[ exonBlockIds[i] ] ;
-					int chrId = eblock.chrId ;
+					int id = geneBlocks.GetExonId( ind, i ) ;
+					int chrId = exonBlocks.chrId[id] ;
 
-					for ( int l = eblock.end ; l >= eblock.start ; --l, ++ret )
+					for ( int l = exonBlocks.end[id] ; l >= exonBlocks.start[id] ; --l, ++ret )
 					{
 						//if ( chrId == 74619 || chrId == 91834 )
 						//	printf( "%c", genome.GetNucleotide( chrId, l ) ) ;
@@ -919,12 +1269,12 @@ class Blocks
 						else
 							buffer[ret] = 'N' ;
 					}
-					//printf( "-- %d %d %d\n", ret, (int)eblock.start, (int)eblock.end ) ;
+					//printf( "-- %d %d %d\n", ret, (int)exonBlocks.start[id], (int)exonBlocks.end[id] ) ;
 				}
 
 			}
 			buffer[ret] = '\0' ;
-			//if ( exonBlocks[ exonBlockIds[0] ].chrId == 74619 || exonBlocks[ exonBlockIds[0] ].chrId == 91834 )
+			//if ( exonBlocks.chrId[ geneBlocks.GetExonId( ind, 0 ) ] == 74619 || exonBlocks.chrId[ geneBlocks.GetExonId( ind, 0 ) ] == 91834 )
 			//	printf( "(%d %lld)\n%s\n", ret, buffer, buffer ) ;
 			return ret ;
 		}
@@ -934,194 +1284,311 @@ class Blocks
 			return geneBlocks.size() ;
 		}
 
-		void BuildGeneBlockGraph( Alignments &alignments )	
+		int GetGeneBlockChrId( int ind )
 		{
-			int i, j, k ;
-			int tag = 0 ;
-			int geneBlockCnt = geneBlocks.size() ;
-			
-			std::vector<struct _edge> *repeatGraph = new std::vector<struct _edge>[ geneBlockCnt ] ;
-			geneBlockGraph = new std::vector<struct _mateEdge>[ geneBlockCnt ] ;
-			repeatFather = new int[geneBlockCnt ] ;
+			return geneBlocks.chrId[ind] ;
+		}
 
-			for ( i = 0 ; i < geneBlockCnt ; ++i )
+		int GetGeneBlockContigId( int ind )
+		{
+			return geneBlocks.contigId[ind] ;
+		}
+
+		int64_t GetGeneBlockStart( int ind )
+		{
+			return geneBlocks.start[ind] ;
+		}
+
+		int64_t GetGeneBlockEnd( int ind )
+		{
+			return geneBlocks.end[ind] ;
+		}
+
+		int GetGeneBlockExonCount( int ind )
+		{
+			return geneBlocks.GetExonCount( ind ) ;
+		}
+
+		// The first gene block on the chromosome ending at or after pos, -1 if there is none.
+		int FindNextGeneBlock( int chrId, int64_t pos )
+		{
+			if ( chrId < 0 || chrId >= (int)geneBlocksChrIdOffset.size() || geneBlocksChrIdOffset[chrId].a == -1 )
+				return -1 ;
+			if ( pos < 0 )
+				return geneBlocksChrIdOffset[chrId].a ;
+
+			int64_t bin = pos >> GENE_BLOCK_BIN_BITS ;
+			int binCnt = geneBlockBinOffset[chrId + 1] - geneBlockBinOffset[chrId] ;
+			if ( bin >= binCnt )
+				return -1 ;
+			int k = geneBlockBin[ geneBlockBinOffset[chrId] + bin ] ;
+			int to = geneBlocksChrIdOffset[chrId].b ;
+			while ( k <= to && geneBlocks.end[k] < pos )
+				++k ;
+			if ( k > to )
+				return -1 ;
+			return k ;
+		}
+
+		// Find the edges of the gene block graph and the repeat graph from read r of the batch.
+		// prevFound is the cache of FindGeneBlock owned by the calling thread.
+		// Return the GRAPH_READ_* status of the read.
+		int CollectGeneBlockGraphEdges( int r, struct _graphRead &read, std::vector<struct _graphEdgeRecord> &records, int &prevFound )
+		{
+			int ret = GRAPH_READ_FAR_MATE ;
+			int tag = read.tag ;
+			int tagE = GetExonBlockInGeneBlock( tag, geneBlocks.chrId[tag], read.start ) ;
+			if ( tagE == -1 )
+				return GRAPH_READ_NO_BLOCK ;
+			// Test the mates
+			// Notice that, we add the information twice.
+			int k = FindGeneBlock( read.mChrId, read.mPos, prevFound ) ;
+			// Skip the read if it does not compatible, or the two mates are in the
+			// same gene block.
+			if ( k == -1 ) 
+				return GRAPH_READ_NO_BLOCK ;
+			if ( k == tag )
+				return GRAPH_READ_SAME_BLOCK ;
+			int kE = GetExonBlockInGeneBlock( k, read.mChrId, read.mPos ) ;
+			if ( kE == -1 )
+				return GRAPH_READ_NO_BLOCK ;
+
+			struct _graphEdgeRecord record ;
+			record.readId = r ;
+
+			// Add the edge
+			int directionTag = read.isReverse ? 2 : 0 ;
+			directionTag |= ( read.isMateReverse ? 1 : 0 ) ;
+
+			// Test the insert size
+			int insert1 = GetGeneBlockResidual( tag, tagE, read.start, read.isReverse ? -1 : 1 ) ;
+			int insert2 = GetGeneBlockResidual( k, kE, read.mPos, read.isMateReverse ? -1 : 1 ) ;
+			if ( insert1 + insert2 <= fragLengthBound ) 
 			{
-				repeatFather[i] = i ;	
+				record.u = tag ;
+				record.v = k ;
+				record.type = directionTag ;
+				records.push_back( record ) ;
+				ret = GRAPH_READ_EDGE ;
 			}
 
-			while ( alignments.Next() )
+			// The part for the repeat graph, using CC and CP field
+			if ( read.hasRepeat )
 			{
-				struct _pair *segments = alignments.segments ;
-				if ( tag < geneBlockCnt && alignments.GetChromId() != geneBlocks[tag].chrId )
+				k = FindGeneBlock( read.cChrId, read.cPos, prevFound ) ;
+				if ( k != -1 && GetExonBlockInGeneBlock( k, read.mChrId, read.mPos ) != -1 ) 
 				{
-					std::map<int, struct _pair>::iterator it ;
+					record.u = tag ;
+					record.v = k ;
+					record.type = GRAPH_RECORD_REPEAT ;
+					records.push_back( record ) ;
+				}
+			}
+			return ret ;
+		}
 
-					it = geneBlocksChrIdOffset.find( alignments.GetChromId() ) ;
+		struct _collectEdgesArg
+		{
+			Blocks *blocks ;
+			struct _graphRead *reads ;
+			std::vector<struct _graphEdgeRecord> *records ; // one buffer for each thread
+			int *prevFound ;
+		} ;
 
-					if ( it != geneBlocksChrIdOffset.end() )
-					{
-						if ( tag < it->second.a )
-							tag = it->second.a ;
-						else
-							continue ;
-					}
-					else
-						continue ; // skip this read
-				}
+		static void CollectGeneBlockGraphEdges_Thread( int taskId, int threadId, void *arg )
+		{
+			struct _collectEdgesArg *a = (struct _collectEdgesArg *)arg ;
+			a->reads[ taskId ].status = a->blocks->CollectGeneBlockGraphEdges( taskId, a->reads[ taskId ], a->records[ threadId ], 
+				a->prevFound[ threadId ] ) ;
+		}
+
+		// Merge the edges found from a batch into the gene block graph and the repeat graph.
+		// The new edges are created in the order of their first reads, and each support takes 
+		// its reads in order, which is the same as adding the reads one by one.
+		void MergeGeneBlockGraphEdges( std::vector<struct _graphEdgeRecord> &records, struct _graphRead *reads, 
+			std::vector<struct _edge> *repeatGraph, EdgeHash &repeatGraphIndex )
+		{
+			int i, j, k ;
+			int cnt = records.size() ;
+			std::vector<struct _graphEdgeRecord> newEdges ;
+
+			std::sort( records.begin(), records.end(), CompGraphEdgeRecord ) ;
+			for ( i = 0 ; i < cnt ; i = j )
+			{
+				bool repeat = ( records[i].type == GRAPH_RECORD_REPEAT ) ;
+				for ( j = i + 1 ; j < cnt && records[j].u == records[i].u && records[j].v == records[i].v 
+					&& ( records[j].type == GRAPH_RECORD_REPEAT ) == repeat ; ++j )
+					;
+				if ( ( repeat ? repeatGraphIndex : geneBlockGraphIndex ).Find( records[i].u, records[i].v ) == -1 )
+					newEdges.push_back( records[i] ) ;
+			}
 
-				while ( tag < geneBlockCnt && geneBlocks[tag].end < segments[0].a && 
-						geneBlocks[tag].chrId == alignments.GetChromId() )
+			std::sort( newEdges.begin(), newEdges.end(), CompGraphEdgeRecordByRead ) ;
+			k = newEdges.size() ;
+			for ( i = 0 ; i < k ; ++i )
+			{
+				int u = newEdges[i].u ;
+				int v = newEdges[i].v ;
+				if ( newEdges[i].type == GRAPH_RECORD_REPEAT )
 				{
-					++tag ;
+					struct _edge newE ;
+					newE.u = u ;
+					newE.v = v ;
+					repeatGraphIndex.Insert( u, v, repeatGraph[u].size() ) ;
+					repeatGraph[u].push_back( newE ) ;
+					++graphStat.repeatEdges ;
 				}
+				else
+				{
+					struct _mateEdge newE ;
+					newE.u = u ;
+					newE.v = v ;
+					newE.valid = true ;
+					geneBlockGraphIndex.Insert( u, v, geneBlockGraph[u].size() ) ;
+					geneBlockGraph[u].push_back( newE ) ;
+					++graphStat.edges ;
+				}
+			}
 
-				/*if ( !strcmp( alignments.GetReadId(), "Id_10718637" ) )
-				  {
-				  printf( "%d %lld: %d %lld %lld %d\n", alignments.GetChromId(), segments[0].a, tag, geneBlocks[tag].start, geneBlocks[tag].end, geneBlocks[tag].chrId ) ;
-				  }*/
-				if ( tag >= geneBlockCnt || geneBlocks[tag].chrId != alignments.GetChromId() )
-					continue ;
-				int tagE = GetExonBlockInGeneBlock( tag, geneBlocks[tag].chrId, segments[0].a ) ;
-				if ( tagE == -1 )
-					continue ;
-				// Test the mates
-				// Notice that, we add the information twice.
-				int mChrId ;
-				int64_t mPos ;
-				int kE ;
-				alignments.GetMatePosition( mChrId, mPos ) ;
-				k = FindGeneBlock( mChrId, mPos ) ;
+			for ( i = 0 ; i < cnt ; i = j )
+			{
+				int u = records[i].u ;
+				int v = records[i].v ;
+				if ( records[i].type == GRAPH_RECORD_REPEAT )
+				{
+					EdgeSupport &support = repeatGraph[u][ repeatGraphIndex.Find( u, v ) ].support ;
+					for ( j = i ; j < cnt && records[j].u == u && records[j].v == v && records[j].type == GRAPH_RECORD_REPEAT ; ++j )
+						support.Add( reads[ records[j].readId ].summary ) ;
+				}
+				else
+				{
+					struct _mateEdge &e = geneBlockGraph[u][ geneBlockGraphIndex.Find( u, v ) ] ;
+					for ( j = i ; j < cnt && records[j].u == u && records[j].v == v && records[j].type != GRAPH_RECORD_REPEAT ; ++j )
+						e.support[ records[j].type ].Add( reads[ records[j].readId ].summary ) ;
+				}
+			}
+		}
 
-				/*if ( !strcmp( alignments.GetReadId(), "Id_30314187" ) )
-				  {
-				  printf( "m: %d %lld: %d %lld %lld %d\n", mChrId, mPos, k, geneBlocks[k].start, geneBlocks[k].end, geneBlocks[k].chrId ) ;
-				  }*/
-				// Skip the read if it does not compatible, or the two mates are in the
-				// same gene block.
-				if ( k == -1 || k == tag ) 
+		// Decode up to GRAPH_BATCH_SIZE reads that may connect two gene blocks. 
+		// Return the number of reads, and set finish at the end of the alignments.
+		int ReadGeneBlockGraphBatch( Alignments &alignments, struct _graphRead *reads, bool &finish )
+		{
+			int readCnt = 0 ;
+			while ( readCnt < GRAPH_BATCH_SIZE )
+			{
+				if ( !alignments.Next() )
+				{
+					finish = true ;
+					break ;
+				}
+				struct _graphRead &read = reads[ readCnt ] ;
+				read.chrId = alignments.GetChromId() ;
+				read.start = alignments.segments[0].a ;
+				alignments.GetMatePosition( read.mChrId, read.mPos ) ;
+
+				// Most pairs are within one gene block, so skip them before
+				// taking the other fields of the alignment.
+				read.tag = FindNextGeneBlock( read.chrId, read.start ) ;
+				if ( read.tag == -1 )
+				{
+					++graphStat.noBlock ;
 					continue ;
-				kE = GetExonBlockInGeneBlock( k, mChrId, mPos ) ;
-				if ( kE == -1 )
+				}
+				if ( read.mChrId == read.chrId 
+					&& geneBlocks.start[ read.tag ] <= read.mPos && read.mPos <= geneBlocks.end[ read.tag ] )
+				{
+					++graphStat.sameBlock ;
 					continue ;
-				//if ( tag == 281 && k == 279 )
-				//{
-				//		printf( "%d %d %s\n", tag, k, alignments.GetReadId() ) ;		
-				//}
-
-				// Add the edge
-				int cnt = geneBlockGraph[tag].size() ;
-				int directionTag = 0 ;
-
-				// TODO: may need to change to hash table for edge representation
-				directionTag = alignments.IsReverse() ? 2 : 0 ;
-				directionTag |= ( alignments.IsMateReverse() ? 1 : 0 ) ;
-
-				// Test the strand. 
-				// Defered to clean block graph stage.
-				/*if ( geneBlocks[tag].support.GetStrand() != 0 && geneBlocks[k].support.GetStrand() != 0 )	
-				  {
-				  int s1 = geneBlocks[tag].support.GetStrand() ;
-				  int s2 = geneBlocks[k].support.GetStrand() ;
+				}
+				read.hasRepeat = alignments.GetRepeatPosition( read.cChrId, read.cPos ) ;
+				read.isReverse = alignments.IsReverse() ;
+				read.isMateReverse = alignments.IsMateReverse() ;
+				alignments.GetSummary( read.summary ) ;
+				++readCnt ;
+			}
+			return readCnt ;
+		}
 
-				  if ( alignments.IsReverse() == alignments.IsMateReverse() )
-				  {
-				  if ( s1 == s2 )
-				  continue ;
-				  }
-				  else
-				  {
-				  if ( s1 != s2 )
-				  continue ;
-				  }
-				  }*/
+		// The reads are decoded in batches. The gene blocks of the reads in a batch are located
+		// in parallel while the next batch is decoded, each thread keeping the edges in its own buffer, 
+		// and then the buffers are merged into the graphs. The graph is the same for any number of threads.
+		void BuildGeneBlockGraph( Alignments &alignments )	
+		{
+			int i, j ;
+			int geneBlockCnt = geneBlocks.size() ;
+			
+			std::vector<struct _edge> *repeatGraph = new std::vector<struct _edge>[ geneBlockCnt ] ;
+			EdgeHash repeatGraphIndex ;
+			geneBlockGraph = new std::vector<struct _mateEdge>[ geneBlockCnt ] ;
+			geneBlockGraphIndex.Clear() ;
+			repeatEdges.clear() ;
+
+			ThreadPool pool( numOfThreads ) ;
+			int threadCnt = pool.GetThreadCount() ;
+			// Two read buffers, so the next batch is decoded while the threads work on the current one.
+			struct _graphRead *reads[2] ;
+			reads[0] = new struct _graphRead[ GRAPH_BATCH_SIZE ] ;
+			reads[1] = new struct _graphRead[ GRAPH_BATCH_SIZE ] ;
+			std::vector<struct _graphEdgeRecord> *records = new std::vector<struct _graphEdgeRecord>[ threadCnt ] ;
+			std::vector<struct _graphEdgeRecord> batchRecords ;
+			int *prevFound = new int[ threadCnt ] ;
+			for ( i = 0 ; i < threadCnt ; ++i )
+				prevFound[i] = -1 ;
+
+			struct _collectEdgesArg arg ;
+			arg.blocks = this ;
+			arg.records = records ;
+			arg.prevFound = prevFound ;
+
+			bool finish = false ;
+			int cur = 0 ;
+			int readCnt = ReadGeneBlockGraphBatch( alignments, reads[cur], finish ) ;
+			while ( readCnt > 0 )
+			{
+				arg.reads = reads[cur] ;
+				pool.Start( readCnt, NULL, CollectGeneBlockGraphEdges_Thread, &arg ) ;
+				int nextReadCnt = finish ? 0 : ReadGeneBlockGraphBatch( alignments, reads[1 - cur], finish ) ;
+				pool.Wait() ;
 
-				// Test the insert size
-				int insert1 = GetGeneBlockResidual( tag, tagE, segments[0].a, alignments.IsReverse() ? -1 : 1 ) ;
-				int insert2 = GetGeneBlockResidual( k, kE, mPos, alignments.IsMateReverse() ? -1 : 1 ) ;
-				/*if ( !strcmp( alignments.GetReadId(), "Id_10718637" ) )
-				{
-					printf( "%d %d\n", insert1 + insert2, fragLength + 2 * fragStd ) ;
-				}*/
-				if ( insert1 + insert2 <= fragLength + 2 * fragStd ) // 400 here is to take short alternative splicing events into account.
+				for ( i = 0 ; i < readCnt ; ++i )
 				{
-					// Add or update the edge
-					/*if ( tag == 1084 && k == 392 )
-					  {
-					  printf( "%s\n", alignments.GetReadId() ) ;
-					  }*/
-					for ( i = 0 ; i < cnt ; ++i )
-					{
-						if ( geneBlockGraph[tag][i].v == k )
-						{
-							geneBlockGraph[tag][i].support[ directionTag ].Add( alignments ) ;
-							break ;
-						}
-					}
-
-					if ( i >= cnt )
+					switch ( reads[cur][i].status )
 					{
-						struct _mateEdge newE ;
-						newE.u = tag ;
-						newE.v = k ;
-						//memset( newE.support, 0, sizeof( newE.support ) ) ;
-
-						newE.support[ directionTag ].Add( alignments ) ;
-						newE.valid = true ;
-
-						geneBlockGraph[tag].push_back( newE ) ;
+						case GRAPH_READ_EDGE: ++graphStat.edgeReads ; break ;
+						case GRAPH_READ_NO_BLOCK: ++graphStat.noBlock ; break ;
+						case GRAPH_READ_SAME_BLOCK: ++graphStat.sameBlock ; break ;
+						default: ++graphStat.farMate ; break ;
 					}
 				}
 
-				// The part for the repeat graph, using CC and CP field
-				int64_t cPos ;
-				int cChrId ;
-				if ( alignments.GetRepeatPosition( cChrId, cPos ) )
+				batchRecords.clear() ;
+				for ( i = 0 ; i < threadCnt ; ++i )
 				{
-					k = FindGeneBlock( cChrId, cPos ) ;
-
-					// Skip the read if it does not compatible, or the two mates are in the
-					// same gene block.
-					if ( k != -1 && GetExonBlockInGeneBlock( k, mChrId, mPos ) != -1 ) 
-					{
-						// Add or update the edge
-						cnt = repeatGraph[tag].size() ;
-						for ( i = 0 ; i < cnt ; ++i )
-						{
-							if ( repeatGraph[tag][i].v == k )
-							{
-								repeatGraph[tag][i].support.Add( alignments ) ;
-								break ;
-							}
-						}
-
-						if ( i >= cnt )
-						{
-							struct _edge newE ;
-							newE.u = tag ;
-							newE.v = k ;
-							//memset( newE.support, 0, sizeof( newE.support ) ) ;
-
-							newE.support.Add( alignments ) ;
-							repeatGraph[tag].push_back( newE ) ;
-						}
-
-					}
+					batchRecords.insert( batchRecords.end(), records[i].begin(), records[i].end() ) ;
+					records[i].clear() ;
 				}
+				MergeGeneBlockGraphEdges( batchRecords, reads[cur], repeatGraph, repeatGraphIndex ) ;
+
+				cur = 1 - cur ;
+				readCnt = nextReadCnt ;
 			}
+			delete[] reads[0] ;
+			delete[] reads[1] ;
+			delete[] records ;
+			delete[] prevFound ;
 
-			// Get the sets of repeated gene blocks
+			// Keep the counts of the repeat graph, the sets of repeated gene blocks 
+			// depend on minimumSupport and are built when cleaning the graph.
 			for ( i = 0 ; i < geneBlockCnt ; ++i )
 			{
 				int cnt = repeatGraph[i].size() ;
 				for ( j = 0 ; j < cnt ; ++j )
 				{
-					//TODO: check the threshold
-					if ( repeatGraph[i][j].support.GetCount() >= minimumSupport ) 
-					{
-						int fi = GetFather( i, repeatFather ) ;
-						int fj = GetFather( repeatGraph[i][j].v, repeatFather ) ;
-						repeatFather[fj] = fi ;
-					}
+					struct _repeatEdge e ;
+					e.u = i ;
+					e.v = repeatGraph[i][j].v ;
+					e.support = repeatGraph[i][j].support.GetCount() ;
+					repeatEdges.push_back( e ) ;
 				}
 			}
 
@@ -1144,16 +1611,14 @@ class Blocks
 				if ( segments[0].b - segments[0].a + 1 <= int( 1.5 * kmerSize ) ) 
 					continue ;
 
-				if ( tag < geneBlockCnt && alignments.GetChromId() != geneBlocks[tag].chrId )
+				if ( tag < geneBlockCnt && alignments.GetChromId() != geneBlocks.chrId[tag] )
 				{
-					std::map<int, struct _pair>::iterator it ;
-
-					it = geneBlocksChrIdOffset.find( alignments.GetChromId() ) ;
+					int offset = GetGeneBlockChrOffset( alignments.GetChromId() ) ;
 
-					if ( it != geneBlocksChrIdOffset.end() )
+					if ( offset != -1 )
 					{
-						if ( tag < it->second.a )
-							tag = it->second.a ;
+						if ( tag < offset )
+							tag = offset ;
 						else
 							continue ;
 					}
@@ -1161,16 +1626,16 @@ class Blocks
 						continue ; // skip this read
 				}
 
-				while ( tag < geneBlockCnt && geneBlocks[tag].end < start && 
-						geneBlocks[tag].chrId == alignments.GetChromId() )
+				while ( tag < geneBlockCnt && geneBlocks.end[tag] < start && 
+						geneBlocks.chrId[tag] == alignments.GetChromId() )
 				{
 					++tag ;
 				}
 
-				if ( tag >= geneBlockCnt || geneBlocks[tag].chrId != alignments.GetChromId() )
+				if ( tag >= geneBlockCnt || geneBlocks.chrId[tag] != alignments.GetChromId() )
 					continue ;
 				int tagG = tag ;
-				int tagE = GetExonBlockInGeneBlock( tagG, geneBlocks[tag].chrId, start ) ;
+				int tagE = GetExonBlockInGeneBlock( tagG, geneBlocks.chrId[tag], start ) ;
 				if ( tagE == -1 )
 					continue ;
 
@@ -1184,7 +1649,7 @@ class Blocks
 
 				/*if ( !strcmp( alignments.GetReadId(), "Id_30063560" ) )
 				  {
-				  printf( "m: %d %lld: %d %lld %lld %d\n", mChrId, mPos, k, geneBlocks[k].start, geneBlocks[k].end, geneBlocks[k].chrId ) ;
+				  printf( "m: %d %lld: %d %lld %lld %d\n", mChrId, mPos, k, geneBlocks.start[k], geneBlocks.end[k], geneBlocks.chrId[k] ) ;
 				  }*/
 				// Skip the read if it does not compatible, or the two mates are in the
 				// same gene block.
@@ -1193,7 +1658,7 @@ class Blocks
 				bool skippable = false ;
 				if ( k == -1 || k == tagG )
 					skippable = true ;
-				if ( skippable || geneBlocks[tagG].contigId == geneBlocks[k].contigId )
+				if ( skippable || geneBlocks.contigId[tagG] == geneBlocks.contigId[k] )
 				{
 					if ( skippable && alignments.IsSupplementary() )
 						continue ;
@@ -1253,11 +1718,11 @@ class Blocks
 							if ( gb == -1 )
 								continue ;
 							if ( ( skippable && gb != tagG ) || 
-								( !skippable && geneBlocks[gb].contigId != geneBlocks[k].contigId ) )
+								( !skippable && geneBlocks.contigId[gb] != geneBlocks.contigId[k] ) )
 							{
 								start = hPos ;
 								tagG = gb ;
-								tagE = GetExonBlockInGeneBlock( tagG, geneBlocks[tagG].chrId, start ) ;
+								tagE = GetExonBlockInGeneBlock( tagG, geneBlocks.chrId[tagG], start ) ;
 								isReverse = ( hit[2].c_str() )[0] == '+' ? false : true ;
 								if ( tagE == -1 )
 									continue ;
@@ -1282,7 +1747,6 @@ class Blocks
 				// Add the edge
 				int directionTag = 0 ;
 
-				// TODO: may need to change to hash table for edge representation
 				directionTag = isReverse ? 2 : 0 ;
 				directionTag |= ( alignments.IsMateReverse() ? 1 : 0 ) ;
 
@@ -1298,25 +1762,20 @@ class Blocks
 					k = tmp ;
 					directionTag ^= 3 ;
 				}
-				int cnt = geneBlockGraph[tagG].size() ;
-				if ( insert1 + insert2 <= fragLength + 2 * fragStd )
+				if ( insert1 + insert2 <= fragLengthBound )
 				{
 					// Add or update the edge
 					/*if ( tagG == 1801 && k == 2338 )
 					  {
 					  printf( "%s\n", alignments.GetReadId() ) ;
 					  }*/
-					for ( i = 0 ; i < cnt ; ++i )
+					i = geneBlockGraphIndex.Find( tagG, k ) ;
+					if ( i != -1 )
 					{
-						if ( geneBlockGraph[tagG][i].v == k )
-						{
-							// TODO: should I use a different counter for clipped reads?
-							geneBlockGraph[tagG][i].support[ directionTag ].Add( alignments, reverseMateRole ) ;
-							break ;
-						}
+						// TODO: should I use a different counter for clipped reads?
+						geneBlockGraph[tagG][i].support[ directionTag ].Add( alignments, reverseMateRole ) ;
 					}
-
-					if ( i >= cnt )
+					else
 					{
 						struct _mateEdge newE ;
 						newE.u = tagG ;
@@ -1326,7 +1785,9 @@ class Blocks
 						newE.support[ directionTag ].Add( alignments, reverseMateRole ) ;
 						newE.valid = true ;
 
+						geneBlockGraphIndex.Insert( tagG, k, geneBlockGraph[tagG].size() ) ;
 						geneBlockGraph[tagG].push_back( newE ) ;
+						++graphStat.clippedEdges ;
 					}
 				}
 			}
@@ -1335,108 +1796,460 @@ class Blocks
 		// -1: if we can not find one
 		int GetExonBlockInGeneBlock( int geneBlockInd, int32_t chrId, int64_t pos )
 		{
-			int i ;
-			int exonCnt = geneBlocks[ geneBlockInd ].exonBlockIds.size() ;
+			if ( chrId != geneBlocks.chrId[geneBlockInd] )
+				return -1 ;
+
+			// The exons are sorted and disjoint, so find the last one starting at or before pos.
+			int offset = geneBlocks.exonOffset[ geneBlockInd ] ;
+			int l = offset ;
+			int r = geneBlocks.exonOffset[ geneBlockInd + 1 ] - 1 ;
+			int m ;
+			while ( l <= r )
+			{
+				m = ( l + r ) / 2 ;
+				if ( geneBlockExonStart[m] <= pos )
+					l = m + 1 ;
+				else
+					r = m - 1 ;
+			}
+			if ( r < offset || pos > geneBlockExonEnd[r] )
+				return -1 ;
+			return r - offset ;
+		}
+
+		// The total length of the exons after (direction=1) or before (direction=-1) exon eid.
+		int GetGeneBlockResidual( int gid, int eid, int pos, int direction )
+		{
+			int offset = geneBlocks.exonOffset[gid] ;
+			if ( direction == 1 )
+				return geneBlockExonLenSum[ geneBlocks.exonOffset[gid + 1] ] - geneBlockExonLenSum[ offset + eid + 1 ] ;
+			else
+				return geneBlockExonLenSum[ offset + eid ] - geneBlockExonLenSum[ offset ] ;
+		}
+
+
+		int FindGeneBlock( int chrId, int64_t pos ) 
+		{
+			return FindGeneBlock( chrId, pos, prevFoundGeneBlock ) ;
+		}
+
+		// prevFound caches the last gene block found. The gene blocks are disjoint, so the cache 
+		// does not change the result and each thread can use its own.
+		int FindGeneBlock( int chrId, int64_t pos, int &prevFound ) 
+		{
+			int l, r, m ;
+
+			if ( chrId < 0 || chrId >= (int)geneBlocksChrIdOffset.size() || geneBlocksChrIdOffset[chrId].a == -1 || pos < 0 )
+				return -1 ;
 
-			if ( chrId != geneBlocks[geneBlockInd].chrId )
+			// The queries from the same region often hit the same gene block.
+			if ( prevFound != -1 && geneBlocks.chrId[ prevFound ] == chrId 
+				&& geneBlocks.start[ prevFound ] <= pos && geneBlocks.end[ prevFound ] >= pos )
+				return prevFound ;
+
+			// Narrow down the search to the gene blocks overlapping the bin.
+			int64_t bin = pos >> GENE_BLOCK_BIN_BITS ;
+			int binCnt = geneBlockBinOffset[chrId + 1] - geneBlockBinOffset[chrId] ;
+			if ( bin >= binCnt )
 				return -1 ;
+			l = geneBlockBin[ geneBlockBinOffset[chrId] + bin ] ;
+			if ( bin + 1 < binCnt )
+				r = geneBlockBin[ geneBlockBinOffset[chrId] + bin + 1 ] ;
+			else
+				r = geneBlocksChrIdOffset[chrId].b ;
 
-			for ( i = 0 ; i < exonCnt ; ++i )
+			while ( l <= r )
 			{
-				int k = geneBlocks[ geneBlockInd ].exonBlockIds[i] ;
-				if ( exonBlocks[k].start > pos ) 
-					return -1 ;
-				else if ( pos >= exonBlocks[k].start && pos <= exonBlocks[k].end )	
-					return i ;
+				m = ( l + r ) / 2 ;
+				if ( geneBlocks.start[m] <= pos && geneBlocks.end[m] >= pos )
+				{
+					prevFound = m ;
+					return m ;
+				}
+
+				if ( geneBlocks.start[m] > pos )
+					r = m - 1 ;
+				else
+					l = m + 1 ;
 			}
+
 			return -1 ;
 		}
 
-		int GetGeneBlockResidual( int gid, int eid, int pos, int direction )
+		// Take the exons into account, compute the length of exons betwee
+		int GetGeneBlockEffectiveCoverage( int geneBlockId, int start, int end )
 		{
-			// TODO: cache the previous result
+			int size = geneBlocks.GetExonCount( geneBlockId ) ;
 			int i ;
-			int cnt = geneBlocks[gid].exonBlockIds.size() ;
 			int ret = 0 ;
-			for ( i = eid + direction ; i >= 0 && i < cnt ; i += direction )
+			for ( i = 0 ; i < size ; ++i )
 			{
-				struct _block &e = exonBlocks[ geneBlocks[gid].exonBlockIds[i] ] ; 
-				int l = e.leftSplice ;
-				int r = e.rightSplice ;
-				if ( l == -1 )
-					l = e.start ;
-				if ( r == -1 )
-					r = e.end ;
-				ret += r - l + 1 ; 
+				int s = exonBlocks.start[ geneBlocks.GetExonId( geneBlockId, i ) ] ;
+				int e = exonBlocks.end[ geneBlocks.GetExonId( geneBlockId, i ) ] ;
+				if ( s <= start && end <= e )
+				{
+					ret = end - start + 1 ;	
+					break ;
+				}
+				else
+				{
+					if ( s <= start && e >= start )
+					{
+						ret += e - start + 1 ;
+					}
+					else if ( start <= s && end >= e )
+					{
+						ret += e - s + 1 ;
+					}
+					else if ( s <= end && e >= end  )
+					{
+						ret += end - s + 1 ;
+						break ;
+					}
+				}
 			}
-
-
 			return ret ;
 		}
 
-
-		int FindGeneBlock( int chrId, int64_t pos ) 
+		// Test each edge of gene block i, and set the valid and semiValid flags.
+		// It only modifies the edges of i, so the gene blocks can be tested in parallel.
+		// T is the word type for the kmer code. The edges it invalidates are counted in invalidated[ CLEAN_RULE_* ].
+		template <typename T>
+		void ValidateGeneBlockEdges( int i, Genome &genome, struct _pair *geneBlockInfo, KmerArray<T> &kmers, int64_t *invalidated )
 		{
-			int l, r, m ;
+			int j, k ;
+			int cnt = geneBlockGraph[i].size() ;
+			int leni = 0 ;
+			if ( cnt == 0 )
+				return ;
+
+			kmers.Clear() ;
+			if ( genome.IsOpen() )
+			{
+				k = geneBlocks.GetExonCount( i ) ;
+				for ( j = 0 ; j < k ; ++j )
+				{
+					int ii = geneBlocks.GetExonId( i, j ) ;
+					genome.AddKmer( geneBlocks.chrId[i], exonBlocks.start[ii], exonBlocks.end[ii], kmerSize, kmers ) ;
+					leni += exonBlocks.end[ii] - exonBlocks.start[ii] + 1 ;
+				}
+				kmers.Build() ;
+			}
+			
+			for ( j = 0 ; j < cnt ; ++j )
+			{
+				geneBlockGraph[i][j].semiValid = true ;
+
+				//if ( geneBlockGraph[i][j].valid == false )
+				//	continue ;
+				bool valid = geneBlockGraph[i][j].valid ;
+
+				// In aggressive mode, we allow the ambiguous extension
+				if ( aggressiveMode == true )
+					valid = true ;			
+				bool wasValid = valid ;
+				int rule = -1 ;
+
+				//if ( i == 1084 && geneBlockGraph[i][j].v == 392 )
+				/*if ( i == 19160 )
+				  {
+				  printf( "%d %d\n", geneBlockGraph[i][j].v, geneBlockGraph[i][j].supportUse ) ;
+				  }*/
+#ifdef DEBUG
+				if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
+					printf( "1: %d\n", valid ) ;
+#endif
+				// The types of support is ambiguous
+				int v = geneBlockGraph[i][j].v ;
+				if ( geneBlockGraph[i][j].supportUse == -1 )
+				{
+					valid = false ;
+					rule = CLEAN_RULE_AMBIGUOUS_SUPPORT ;
+				}
+
+#ifdef DEBUG
+				if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
+					printf( "2: %d\n", valid ) ;
+#endif
+
+				//printf( "%d %d\n", i, geneBlockGraph[i][j].v ) ;
+				if ( valid == true && geneBlockGraph[i][j].support[ geneBlockGraph[i][j].supportUse ].GetCount() < minimumSupport )
+				{
+					valid = false ;
+					rule = CLEAN_RULE_LOW_SUPPORT ;
+				}
+
+				//geneBlockGraph[i][j].valid = valid ;
+				//continue ;
+#ifdef DEBUG
+				if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
+					printf( "3: %d\n", valid ) ;
+#endif
+
+
+
+				// Test whether the two side has too much different expression level
+				if ( 0 )
+				{
+					if ( valid == true && IsSignificantDifferent_SimpleTest( geneBlockInfo[i].a, geneBlockInfo[i].b, 
+								geneBlockInfo[v].a, geneBlockInfo[v].b ) )
+						valid = false ;
+				}
+
+
+#ifdef DEBUG
+				if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
+					printf( "4: %d\n", valid ) ;
+#endif
+				// Test the strand
+				if ( valid == true && geneBlocks.support[i].GetStrand() != 0 && geneBlocks.support[v].GetStrand() != 0 )
+				{
+					int su = geneBlocks.support[i].GetStrand() ;
+					int sv = geneBlocks.support[v].GetStrand() ;
+					//printf( "%d %d: %d %d\n", i, v, su, sv ) ;
+					int supportUse = geneBlockGraph[i][j].supportUse ;
+
+					if ( su == sv && ( supportUse == 0 || supportUse == 3 ) )
+						valid = false ;
+					else if ( su != sv && ( supportUse == 1 || supportUse == 2 ) )
+						valid = false ;
+					if ( valid == false )
+						rule = CLEAN_RULE_STRAND ;
+
+					if ( valid == false )
+					{
+						int su = geneBlockGraph[i][j].supportUse ; // different from the su, sv in the outer loop
+						int span = GetGeneBlockEffectiveCoverage(i, geneBlockGraph[i][j].support[su].GetLeftMostPos()
+						              	,geneBlockGraph[i][j].support[su].GetRightMostPos() ) ;
+
+						if ( span >= 100 && geneBlockGraph[i][j].support[su].GetCount() > 10 && geneBlockGraph[i][j].support[ su ].IsUnique() )
+						{
+							// Check whether the support's strand is defined.
+							int cnt = geneBlockGraph[v].size() ;
+							bool hasStrandSupportI = true ;
+							bool hasStrandSupportV = true ;
+							hasStrandSupportI = geneBlockGraph[i][j].support[ su ].HasStrandSupport() ;
+
+							for ( k = 0 ; k < cnt ; ++k )
+							{
+								if ( geneBlockGraph[v][k].v == i )
+								{
+									int su = geneBlockGraph[v][k].supportUse ;
+									int tmp = ( su >> 1 ) | ( ( su & 1 ) << 1 ) ;
+									if ( tmp == geneBlockGraph[i][j].supportUse )
+									{
+										hasStrandSupportV = geneBlockGraph[v][k].support[ su ].HasStrandSupport() ;
+										break ;
+									}
+									else
+										k = cnt ;
+								}
+							}
+
+							if ( !hasStrandSupportI || !hasStrandSupportV )
+								valid = true ;
+						}
+					}
+				}
+
+#ifdef DEBUG
+				if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
+					printf( "5: %d: %d %lf %lf\n", valid, geneBlocks.support[i].GetStrand(), geneBlocks.support[i].GetPlusSupport(), geneBlocks.support[i].GetMinusSupport() ) ;
+#endif
+
+				// TODO: a better way to decide this threshold
+				// Test whether the connection is too few comparing with the expression level
+				if ( 0 ) //valid == true && fragLength > 2 * readLength )
+				{
+					int su = geneBlockGraph[i][j].supportUse ;
+					double c = geneBlockGraph[i][j].support[ su ].GetCount() / (double)( fragLength - readLength )  ;
+					int cnt = geneBlockGraph[i][j].support[ su ].GetCount() ;
+					/*if ( ( i == 11500 && geneBlockGraph[i][j].v == 37818 )
+					  || ( i == 37818 && geneBlockGraph[i][j].v == 11500  ) )
+					  {
+					  printf( "%d %d: %lf\n", i, geneBlockGraph[i][j].v, c ) ;
+					  }*/
+					if ( IsSignificantDifferent_SimpleTest( geneBlockInfo[i].a, geneBlockInfo[i].b, cnt, fragLength - 2 * readLength ) &&
+							IsSignificantDifferent_SimpleTest( geneBlockInfo[v].a, geneBlockInfo[v].b, cnt, fragLength - 2 * readLength ) )
+					{
+						//printf( "%lf\n", c) ;
+						//printf( "hi\n" ) ;
+						if ( !( cnt / ( fragLength - 2 * readLength ) > 2 && !geneBlockGraph[i][j].support[ su ].IsUnique() ) )
+							valid = false ;
+					}
+				}
+#ifdef DEBUG
+				if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
+					printf( "6: %d: %lf %lf: %d %d\n", valid,  
+						(double)geneBlockInfo[i].a / geneBlockInfo[i].b,
+						(double)geneBlockInfo[v].a / geneBlockInfo[v].b, 
+						geneBlockGraph[i][j].support[ geneBlockGraph[i][j].supportUse ].GetCount(), ( fragLength - 2 * readLength ) ) ;
+#endif
+
+				// Gene family - use read to fileter
+				if ( valid == true )
+				{
+					// repeatFather is already flattened, so we do not modify it here.
+					int fi = repeatFather[i] ;
+					int fj = repeatFather[ geneBlockGraph[i][j].v ] ;
+					if ( fi == fj )
+					{
+						valid = false ;
+						rule = CLEAN_RULE_REPEAT_FAMILY ;
+					}
+
+					/*if ( ( i == 11500 && geneBlockGraph[i][j].v == 37818 )
+					  || ( i == 37818 && geneBlockGraph[i][j].v == 11500  ) )
+					  {
+					  printf( "%d %d: %d\n", i, geneBlockGraph[i][j].v, valid ) ;
+					  }*/
+				}
+				// Gene family - use kmer to filter
+				if ( genome.IsOpen() && valid == true )
+				{
+					int v = geneBlockGraph[i][j].v ;
+					int m, n ;
+					n = geneBlocks.GetExonCount( v ) ;
+					int lenj = 0 ;
+					int kmerCoverage = 0 ;
+
+					for ( m = 0 ; m < n ; ++m )
+					{
+						int ii = geneBlocks.GetExonId( v, m ) ;
+						//genome.AddKmer( geneBlocks.chrId[v], exonBlocks.start[ii], exonBlocks.end[ii], kmerSize, kmersV ) ;
+						kmerCoverage += genome.GetKmerCoverage( geneBlocks.chrId[v], exonBlocks.start[ii], exonBlocks.end[ii], kmerSize, kmers ) ; 
+						lenj += exonBlocks.end[ii] - exonBlocks.start[ii] + 1 ;
+					}
+
+					//cnt = genome.CompareKmerSets( kmers, kmersV ) ;
+					/*printf( "%d %d: (%s: %d-%d) (%s: %d-%d): %d %d %d\n", i, v, alignments.GetChromName( geneBlocks.chrId[i] ), geneBlocks.start[i], geneBlocks.end[i],
+					  alignments.GetChromName( geneBlocks.chrId[v] ), geneBlocks.start[v], geneBlocks.end[v],
+					  cnt, leni, lenj ) ;*/
+
+					//if ( cnt > 10 || ( cnt > 1 && ( cnt > 0.1 * leni || cnt > 0.1 * lenj ) ) )
+					int su = geneBlockGraph[i][j].supportUse ;
+					int span = GetGeneBlockEffectiveCoverage(i, geneBlockGraph[i][j].support[su].GetLeftMostPos() 
+							,geneBlockGraph[i][j].support[su].GetRightMostPos() ) + readLength - kmerSize + 1 ;
+					if ( span > leni )
+						span = leni ;
+
+					if ( ( kmerCoverage >= (int)( 1.5 * kmerSize ) && ( !geneBlockGraph[i][j].support[ su ].IsUnique() ) ) || 
+						( kmerCoverage >= kmerSize + 2 && ( kmerCoverage > 0.1 * leni || kmerCoverage > 0.1 * lenj || kmerCoverage > 30 * span / readLength ) ) )
+					{
+						valid = false ;
+						rule = CLEAN_RULE_KMER_FAMILY ;
+					}
+#ifdef DEBUG
+					if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
+						printf( "7: %d: kmerCoverage=%d leni=%d lenj=%d span=%d\n", valid, kmerCoverage, leni, lenj, span ) ;
+#endif
+				}
+
+				if (  valid == true )
+				{
+					// Test whether the connection is from the middle of two gene blocks. 
+					// We expect to see the read close to the boundary.
+					// Actually, the test of insert size should take care of this, but the test here makes it more stringent
+					int su = geneBlockGraph[i][j].supportUse ;
 
-			// TODO: cache the previous result.
-			std::map<int, struct _pair>::iterator it = geneBlocksChrIdOffset.find( chrId ) ;
+					if ( su & 2 )
+					{
+						// should close to left boundary
+						int eid = geneBlocks.GetExonId( i, 0 ) ;
+						int boundary = exonBlocks.leftSplice[eid] ;
+						if ( boundary == -1 )
+							boundary = exonBlocks.start[eid] ;
+						int pos = geneBlockGraph[i][j].support[su].GetLeftMostPos() ;
 
-			if ( it == geneBlocksChrIdOffset.end() )
-				return -1 ;
+						if ( pos > boundary + readLength )
+							geneBlockGraph[i][j].semiValid = false ;
+					}
+					else
+					{
+						// should close to right boundary
+						int eid = geneBlocks.GetExonId( i, geneBlocks.GetExonCount( i ) - 1 ) ;
+						int boundary = exonBlocks.rightSplice[eid] ;
+						if ( boundary == -1 )
+							boundary = exonBlocks.end[eid] ;
+						int pos = geneBlockGraph[i][j].support[su].GetRightMostPos() ;
 
-			l = it->second.a ;
-			r = it->second.b ;
+						if ( pos < boundary - readLength )
+							geneBlockGraph[i][j].semiValid = false ;
 
-			while ( l <= r )
-			{
-				m = ( l + r ) / 2 ;
-				if ( geneBlocks[m].start <= pos && geneBlocks[m].end >= pos )
-					return m ;
+					}
 
-				if ( geneBlocks[m].start > pos )
-					r = m - 1 ;
-				else
-					l = m + 1 ;
+					// If all the support mates are from the same position
+					if ( geneBlockGraph[i][j].support[su].GetCoordCnt() == 1 )
+						geneBlockGraph[i][j].semiValid = false ;
+				}
+
+				geneBlockGraph[i][j].valid = valid ;
+				if ( wasValid && !valid )
+					++invalidated[ rule ] ;
+#ifdef DEBUG
+				if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
+					printf( "8: %d\n", valid ) ;
+#endif
 			}
+		}
 
-			return -1 ;
+		template <typename T>
+		struct _validateEdgesArg
+		{
+			Blocks *blocks ;
+			Genome *genome ;
+			struct _pair *geneBlockInfo ;
+			KmerArray<T> *kmers ; // one kmer table for each thread
+			int64_t *invalidated ; // CLEAN_RULE_COUNT counters for each thread
+		} ;
+
+		template <typename T>
+		static void ValidateGeneBlockEdges_Thread( int taskId, int threadId, void *arg )
+		{
+			struct _validateEdgesArg<T> *a = (struct _validateEdgesArg<T> *)arg ;
+			a->blocks->ValidateGeneBlockEdges( taskId, *( a->genome ), a->geneBlockInfo, a->kmers[ threadId ], 
+				a->invalidated + threadId * CLEAN_RULE_COUNT ) ;
 		}
 
-		// Take the exons into account, compute the length of exons betwee
-		int GetGeneBlockEffectiveCoverage( int geneBlockId, int start, int end )
+		template <typename T>
+		void ValidateGeneBlockGraphEdges( Genome &genome, struct _pair *geneBlockInfo )
 		{
-			std::vector<int> &exonIds = geneBlocks[ geneBlockId ].exonBlockIds ;
-			int size = exonIds.size() ;
-			int i ;
-			int ret = 0 ;
-			for ( i = 0 ; i < size ; ++i )
+			int blockCnt = geneBlocks.size() ;
+			int i, j ;
+			ThreadPool pool( numOfThreads ) ;
+			
+			for ( i = 0 ; i < blockCnt ; ++i )
+				GetFather( i, repeatFather ) ;
+
+			// The work of a gene block is roughly the exonic length of itself 
+			// and its neighbors, which is scanned for kmers.
+			int64_t *cost = new int64_t[ blockCnt ] ;
+			for ( i = 0 ; i < blockCnt ; ++i )
 			{
-				int s = exonBlocks[ exonIds[i] ].start ;
-				int e = exonBlocks[ exonIds[i] ].end ;
-				if ( s <= start && end <= e )
-				{
-					ret = end - start + 1 ;	
-					break ;
-				}
-				else
-				{
-					if ( s <= start && e >= start )
-					{
-						ret += e - start + 1 ;
-					}
-					else if ( start <= s && end >= e )
-					{
-						ret += e - s + 1 ;
-					}
-					else if ( s <= end && e >= end  )
-					{
-						ret += end - s + 1 ;
-						break ;
-					}
-				}
+				int cnt = geneBlockGraph[i].size() ;
+				cost[i] = 0 ;
+				if ( cnt == 0 )
+					continue ;
+				cost[i] = GetEffectiveLength( i ) ;
+				for ( j = 0 ; j < cnt ; ++j )
+					cost[i] += GetEffectiveLength( geneBlockGraph[i][j].v ) ;
 			}
-			return ret ;
+
+			struct _validateEdgesArg<T> arg ;
+			arg.blocks = this ;
+			arg.genome = &genome ;
+			arg.geneBlockInfo = geneBlockInfo ;
+			arg.kmers = new KmerArray<T>[ pool.GetThreadCount() ] ;
+			arg.invalidated = new int64_t[ pool.GetThreadCount() * CLEAN_RULE_COUNT ] ;
+			memset( arg.invalidated, 0, sizeof( int64_t ) * pool.GetThreadCount() * CLEAN_RULE_COUNT ) ;
+			pool.Run( blockCnt, cost, ValidateGeneBlockEdges_Thread<T>, &arg ) ;
+
+			for ( i = 0 ; i < pool.GetThreadCount() ; ++i )
+				for ( j = 0 ; j < CLEAN_RULE_COUNT ; ++j )
+					graphStat.invalidated[j] += arg.invalidated[ i * CLEAN_RULE_COUNT + j ] ;
+			delete[] arg.kmers ;
+			delete[] arg.invalidated ;
+			delete[] cost ;
 		}
 
 		// Clean up the graph.
@@ -1446,6 +2259,10 @@ class Blocks
 			int i, j, k ;
 			bool *validGeneBlock = new bool[blockCnt] ;
 			std::vector< struct _geneBlockBubble > bubbles ;
+			
+			// The edges will be removed from now on.
+			geneBlockGraphIndex.Clear() ;
+			BuildRepeatFather() ;
 
 			for ( i = 0 ; i < blockCnt ; ++i )
 			{
@@ -1513,14 +2330,14 @@ class Blocks
 			struct _pair *geneBlockInfo = new struct _pair[blockCnt] ;
 			for ( i = 0 ; i < blockCnt ; ++i )
 			{
-				int cnt = geneBlocks[i].exonBlockIds.size() ;
+				int cnt = geneBlocks.GetExonCount( i ) ;
 				int len = 0 ;
 				int count = 0 ;
 				for ( j = 0 ; j < cnt ; ++j )
 				{
-					k = geneBlocks[i].exonBlockIds[j] ;
-					len += exonBlocks[k].end - exonBlocks[k].start + 1 ;
-					count += exonBlocks[k].support.GetCount() ;
+					k = geneBlocks.GetExonId( i, j ) ;
+					len += exonBlocks.end[k] - exonBlocks.start[k] + 1 ;
+					count += exonBlocks.support[k].GetCount() ;
 				}
 				assert( j > 0 ) ;
 				geneBlockInfo[i].a = count ;
@@ -1538,11 +2355,11 @@ class Blocks
 
 				if ( genome.IsOpen() )
 				{
-					k = geneBlocks[i].exonBlockIds.size() ;
+					k = geneBlocks.GetExonCount( i ) ;
 					for ( j = 0 ; j < k ; ++j )
 					{
-						int ii = geneBlocks[i].exonBlockIds[j] ;
-						leni += exonBlocks[ii].end - exonBlocks[ii].start + 1 ;
+						int ii = geneBlocks.GetExonId( i, j ) ;
+						leni += exonBlocks.end[ii] - exonBlocks.start[ii] + 1 ;
 					}
 				}
 				
@@ -1577,7 +2394,7 @@ class Blocks
 						if ( ( su & 2 ) != test )
 							continue ;
 						// ignore the connection within the same scaffold
-						if ( geneBlocks[ geneBlockGraph[i][j].v ].chrId == geneBlocks[ i ].chrId )
+						if ( geneBlocks.chrId[ geneBlockGraph[i][j].v ] == geneBlocks.chrId[ i ] )
 							continue ;
 
 						if ( geneBlockGraph[i][j].support[ su ].GetCount() > max )
@@ -1651,7 +2468,7 @@ class Blocks
 								
 						}
 						else if ( geneBlockGraph[i][maxtag].supportUse != geneBlockGraph[i][max2tag].supportUse 
-							|| geneBlocks[ geneBlockGraph[i][maxtag].v ].chrId !=  geneBlocks[ geneBlockGraph[i][max2tag].v ].chrId )
+							|| geneBlocks.chrId[ geneBlockGraph[i][maxtag].v ] !=  geneBlocks.chrId[ geneBlockGraph[i][max2tag].v ] )
 							valid = false ;
 					}
 					//if ( max == 0 )
@@ -1671,6 +2488,7 @@ class Blocks
 						//if ( i == 19160 ) //geneBlockGraph[i][j].v == 583 )
 						//	printf( "%d: %d %d %d: %d\n", __LINE__, j, geneBlockGraph[i][j].v, max, geneBlockGraph[i][j].support[ su ].GetCount() ) ;
 						//if ( geneBlockGraph[i][j].support[ su ].GetCount() < max )
+						bool wasValid = geneBlockGraph[i][j].valid ;
 						if ( max > 0 && j != maxtag )
 							geneBlockGraph[i][j].valid = false ;
 
@@ -1680,8 +2498,10 @@ class Blocks
 						if ( valid == false )
 							geneBlockGraph[i][j].valid = false ;
 						else if ( maxtag != -1 && j != maxtag && su == geneBlockGraph[i][maxtag].supportUse && 
-							geneBlocks[ geneBlockGraph[i][j].v ].chrId == geneBlocks[ geneBlockGraph[i][maxtag].v ].chrId)
+							geneBlocks.chrId[ geneBlockGraph[i][j].v ] == geneBlocks.chrId[ geneBlockGraph[i][maxtag].v ])
 							geneBlockGraph[i][maxtag].support[ geneBlockGraph[i][maxtag].supportUse ].Add( geneBlockGraph[i][j].support[ su ] ) ;
+						if ( wasValid && !geneBlockGraph[i][j].valid )
+							++graphStat.invalidated[ CLEAN_RULE_AMBIGUOUS_EXTENSION ] ;
 							
 					}
 					//if ( i == 19160 ) //geneBlockGraph[i][j].v == 583 )
@@ -1695,6 +2515,8 @@ class Blocks
 					{
 						for ( j = 0 ;j < cnt ; ++j )
 						{
+							if ( geneBlockGraph[i][j].valid )
+								++graphStat.invalidated[ CLEAN_RULE_SHORT_AMBIGUOUS_BLOCK ] ;
 							geneBlockGraph[i][j].valid = false ;
 						}
 
@@ -1781,266 +2603,12 @@ class Blocks
 				}
 			}
 
-			for ( i = 0 ; i < blockCnt ; ++i )
-			{
-				int cnt = geneBlockGraph[i].size() ;
-				int leni = 0 ;
-				if ( cnt == 0 )
-					continue ;
-
-				std::map<uint64_t, int> kmers ;
-				if ( genome.IsOpen() )
-				{
-					k = geneBlocks[i].exonBlockIds.size() ;
-					for ( j = 0 ; j < k ; ++j )
-					{
-						int ii = geneBlocks[i].exonBlockIds[j] ;
-						genome.AddKmer( geneBlocks[i].chrId, exonBlocks[ii].start, exonBlocks[ii].end, kmerSize, kmers ) ;
-						leni += exonBlocks[ii].end - exonBlocks[ii].start + 1 ;
-					}
-				}
-				
-				for ( j = 0 ; j < cnt ; ++j )
-				{
-					geneBlockGraph[i][j].semiValid = true ;
-
-					//if ( geneBlockGraph[i][j].valid == false )
-					//	continue ;
-					bool valid = geneBlockGraph[i][j].valid ;
-
-					// In aggressive mode, we allow the ambiguous extension
-					if ( aggressiveMode == true )
-						valid = true ;			
-
-					//if ( i == 1084 && geneBlockGraph[i][j].v == 392 )
-					/*if ( i == 19160 )
-					  {
-					  printf( "%d %d\n", geneBlockGraph[i][j].v, geneBlockGraph[i][j].supportUse ) ;
-					  }*/
-#ifdef DEBUG
-					if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
-						printf( "1: %d\n", valid ) ;
-#endif
-					// The types of support is ambiguous
-					int v = geneBlockGraph[i][j].v ;
-					if ( geneBlockGraph[i][j].supportUse == -1 )
-					{
-						valid = false ;
-					}
-
-#ifdef DEBUG
-					if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
-						printf( "2: %d\n", valid ) ;
-#endif
-
-					//printf( "%d %d\n", i, geneBlockGraph[i][j].v ) ;
-					if ( valid == true && geneBlockGraph[i][j].support[ geneBlockGraph[i][j].supportUse ].GetCount() < minimumSupport )
-						valid = false ;
-
-					//geneBlockGraph[i][j].valid = valid ;
-					//continue ;
-#ifdef DEBUG
-					if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
-						printf( "3: %d\n", valid ) ;
-#endif
-
-
-
-					// Test whether the two side has too much different expression level
-					if ( 0 )
-					{
-						if ( valid == true && IsSignificantDifferent_SimpleTest( geneBlockInfo[i].a, geneBlockInfo[i].b, 
-									geneBlockInfo[v].a, geneBlockInfo[v].b ) )
-							valid = false ;
-					}
-
-
-#ifdef DEBUG
-					if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
-						printf( "4: %d\n", valid ) ;
-#endif
-					// Test the strand
-					if ( valid == true && geneBlocks[i].support.GetStrand() != 0 && geneBlocks[v].support.GetStrand() != 0 )
-					{
-						int su = geneBlocks[i].support.GetStrand() ;
-						int sv = geneBlocks[v].support.GetStrand() ;
-						//printf( "%d %d: %d %d\n", i, v, su, sv ) ;
-						int supportUse = geneBlockGraph[i][j].supportUse ;
-
-						if ( su == sv && ( supportUse == 0 || supportUse == 3 ) )
-							valid = false ;
-						else if ( su != sv && ( supportUse == 1 || supportUse == 2 ) )
-							valid = false ;
-
-						if ( valid == false )
-						{
-							int su = geneBlockGraph[i][j].supportUse ; // different from the su, sv in the outer loop
-							int span = GetGeneBlockEffectiveCoverage(i, geneBlockGraph[i][j].support[su].GetLeftMostPos()
-							              	,geneBlockGraph[i][j].support[su].GetRightMostPos() ) ;
-
-							if ( span >= 100 && geneBlockGraph[i][j].support[su].GetCount() > 10 && geneBlockGraph[i][j].support[ su ].IsUnique() )
-							{
-								// Check whether the support's strand is defined.
-								int cnt = geneBlockGraph[v].size() ;
-								bool hasStrandSupportI = true ;
-								bool hasStrandSupportV = true ;
-								hasStrandSupportI = geneBlockGraph[i][j].support[ su ].HasStrandSupport() ;
-
-								for ( k = 0 ; k < cnt ; ++k )
-								{
-									if ( geneBlockGraph[v][k].v == i )
-									{
-										int su = geneBlockGraph[v][k].supportUse ;
-										int tmp = ( su >> 1 ) | ( ( su & 1 ) << 1 ) ;
-										if ( tmp == geneBlockGraph[i][j].supportUse )
-										{
-											hasStrandSupportV = geneBlockGraph[v][k].support[ su ].HasStrandSupport() ;
-											break ;
-										}
-										else
-											k = cnt ;
-									}
-								}
-
-								if ( !hasStrandSupportI || !hasStrandSupportV )
-									valid = true ;
-							}
-						}
-					}
-
-#ifdef DEBUG
-					if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
-						printf( "5: %d: %d %lf %lf\n", valid, geneBlocks[i].support.GetStrand(), geneBlocks[i].support.plusSupport, geneBlocks[i].support.minusSupport ) ;
-#endif
-
-					// TODO: a better way to decide this threshold
-					// Test whether the connection is too few comparing with the expression level
-					if ( 0 ) //valid == true && fragLength > 2 * readLength )
-					{
-						int su = geneBlockGraph[i][j].supportUse ;
-						double c = geneBlockGraph[i][j].support[ su ].GetCount() / (double)( fragLength - readLength )  ;
-						int cnt = geneBlockGraph[i][j].support[ su ].GetCount() ;
-						/*if ( ( i == 11500 && geneBlockGraph[i][j].v == 37818 )
-						  || ( i == 37818 && geneBlockGraph[i][j].v == 11500  ) )
-						  {
-						  printf( "%d %d: %lf\n", i, geneBlockGraph[i][j].v, c ) ;
-						  }*/
-						if ( IsSignificantDifferent_SimpleTest( geneBlockInfo[i].a, geneBlockInfo[i].b, cnt, fragLength - 2 * readLength ) &&
-								IsSignificantDifferent_SimpleTest( geneBlockInfo[v].a, geneBlockInfo[v].b, cnt, fragLength - 2 * readLength ) )
-						{
-							//printf( "%lf\n", c) ;
-							//printf( "hi\n" ) ;
-							if ( !( cnt / ( fragLength - 2 * readLength ) > 2 && !geneBlockGraph[i][j].support[ su ].IsUnique() ) )
-								valid = false ;
-						}
-					}
-#ifdef DEBUG
-					if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
-						printf( "6: %d: %lf %lf: %d %d\n", valid,  
-							(double)geneBlockInfo[i].a / geneBlockInfo[i].b,
-							(double)geneBlockInfo[v].a / geneBlockInfo[v].b, 
-							geneBlockGraph[i][j].support[ geneBlockGraph[i][j].supportUse ].GetCount(), ( fragLength - 2 * readLength ) ) ;
-#endif
-
-					// Gene family - use read to fileter
-					if ( valid == true )
-					{
-						int fi = GetFather( i, repeatFather ) ;
-						int fj = GetFather( geneBlockGraph[i][j].v, repeatFather ) ;
-						if ( fi == fj )
-							valid = false ;
-
-						/*if ( ( i == 11500 && geneBlockGraph[i][j].v == 37818 )
-						  || ( i == 37818 && geneBlockGraph[i][j].v == 11500  ) )
-						  {
-						  printf( "%d %d: %d\n", i, geneBlockGraph[i][j].v, valid ) ;
-						  }*/
-					}
-					// Gene family - use kmer to filter
-					if ( genome.IsOpen() && valid == true )
-					{
-						int v = geneBlockGraph[i][j].v ;
-						int m, n ;
-						n = geneBlocks[v].exonBlockIds.size() ;
-						int lenj = 0 ;
-						int kmerCoverage = 0 ;
-
-						for ( m = 0 ; m < n ; ++m )
-						{
-							int ii = geneBlocks[v].exonBlockIds[m] ;
-							//genome.AddKmer( geneBlocks[v].chrId, exonBlocks[ii].start, exonBlocks[ii].end, kmerSize, kmersV ) ;
-							kmerCoverage += genome.GetKmerCoverage( geneBlocks[v].chrId, exonBlocks[ii].start, exonBlocks[ii].end, kmerSize, kmers ) ; 
-							lenj += exonBlocks[ii].end - exonBlocks[ii].start + 1 ;
-						}
-
-						//cnt = genome.CompareKmerSets( kmers, kmersV ) ;
-						/*printf( "%d %d: (%s: %d-%d) (%s: %d-%d): %d %d %d\n", i, v, alignments.GetChromName( geneBlocks[i].chrId ), geneBlocks[i].start, geneBlocks[i].end,
-						  alignments.GetChromName( geneBlocks[v].chrId ), geneBlocks[v].start, geneBlocks[v].end,
-						  cnt, leni, lenj ) ;*/
-
-						//if ( cnt > 10 || ( cnt > 1 && ( cnt > 0.1 * leni || cnt > 0.1 * lenj ) ) )
-						int su = geneBlockGraph[i][j].supportUse ;
-						int span = GetGeneBlockEffectiveCoverage(i, geneBlockGraph[i][j].support[su].GetLeftMostPos() 
-								,geneBlockGraph[i][j].support[su].GetRightMostPos() ) + readLength - kmerSize + 1 ;
-						if ( span > leni )
-							span = leni ;
-
-						if ( ( kmerCoverage >= (int)( 1.5 * kmerSize ) && ( !geneBlockGraph[i][j].support[ su ].IsUnique() ) ) || 
-							( kmerCoverage >= kmerSize + 2 && ( kmerCoverage > 0.1 * leni || kmerCoverage > 0.1 * lenj || kmerCoverage > 30 * span / readLength ) ) )
-						{
-							valid = false ;
-						}
-#ifdef DEBUG
-						if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
-							printf( "7: %d: kmerCoverage=%d leni=%d lenj=%d span=%d\n", valid, kmerCoverage, leni, lenj, span ) ;
-#endif
-					}
-
-					if (  valid == true )
-					{
-						// Test whether the connection is from the middle of two gene blocks. 
-						// We expect to see the read close to the boundary.
-						// Actually, the test of insert size should take care of this, but the test here makes it more stringent
-						int su = geneBlockGraph[i][j].supportUse ;
-
-						if ( su & 2 )
-						{
-							// should close to left boundary
-							struct _block &eblock = exonBlocks[ geneBlocks[i].exonBlockIds[0] ] ;
-							int boundary = eblock.leftSplice ;
-							if ( boundary == -1 )
-								boundary = eblock.start ;
-							int pos = geneBlockGraph[i][j].support[su].GetLeftMostPos() ;
-
-							if ( pos > boundary + readLength )
-								geneBlockGraph[i][j].semiValid = false ;
-						}
-						else
-						{
-							// should close to right boundary
-							struct _block &eblock = exonBlocks[ geneBlocks[i].exonBlockIds[ geneBlocks[i].exonBlockIds.size() - 1 ] ] ;
-							int boundary = eblock.rightSplice ;
-							if ( boundary == -1 )
-								boundary = eblock.end ;
-							int pos = geneBlockGraph[i][j].support[su].GetRightMostPos() ;
-
-							if ( pos < boundary - readLength )
-								geneBlockGraph[i][j].semiValid = false ;
-
-						}
-
-						// If all the support mates are from the same position
-						if ( geneBlockGraph[i][j].support[su].GetCoordCnt() == 1 )
-							geneBlockGraph[i][j].semiValid = false ;
-					}
-
-					geneBlockGraph[i][j].valid = valid ;
-#ifdef DEBUG
-					if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
-						printf( "8: %d\n", valid ) ;
-#endif
-				}
-			}
+			// Decide the word type of the kmer code once, so kmer size<=32 
+			// keeps using the 64bit code.
+			if ( kmerSize <= KmerCode<uint64_t>::GetMaxKmerLength() )
+				ValidateGeneBlockGraphEdges<uint64_t>( genome, geneBlockInfo ) ;
+			else
+				ValidateGeneBlockGraphEdges<unsigned __int128>( genome, geneBlockInfo ) ;
 
 			// Remove the one-side edge that makes the graph non-symmetric
 			for ( i = 0 ; i < blockCnt ; ++i )
@@ -2066,7 +2634,10 @@ class Blocks
 						}
 
 						if ( k >= cnt )
+						{
 							geneBlockGraph[i][j].valid = false ;
+							++graphStat.invalidated[ CLEAN_RULE_ONE_SIDE ] ;
+						}
 #ifdef DEBUG
 						if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
 							printf( "9: %d\n", geneBlockGraph[i][j].valid ) ;
@@ -2097,7 +2668,10 @@ class Blocks
 						}
 
 						if ( geneBlockGraph[i][j].semiValid == false && otherSemiValid == false )
+						{
 							geneBlockGraph[i][j].valid = false ;
+							++graphStat.invalidated[ CLEAN_RULE_SEMI_VALID ] ;
+						}
 					}
 #ifdef DEBUG
 					if ( i == DEBUG_U && geneBlockGraph[i][j].v == DEBUG_V )
@@ -2119,9 +2693,10 @@ class Blocks
 						int cnt = geneBlockGraph[v].size() ;
 						for ( k = 0 ; k < cnt ; ++k )
 						{
-							if ( geneBlockGraph[v][k].v == i )
+							if ( geneBlockGraph[v][k].v == i && geneBlockGraph[v][k].valid )
 							{
 								geneBlockGraph[v][k].valid = false ;
+								++graphStat.invalidated[ CLEAN_RULE_SYMMETRY ] ;
 							}
 						}
 					}
@@ -2135,8 +2710,8 @@ class Blocks
 				validGeneBlock[i] = true ;
 
 				int len = GetEffectiveLength( i ) ; ;
-				if ( ( geneBlocks[i].exonBlockIds.size() == 1 && !geneBlocks[i].support.IsUnique() ) ||
-						( len < minimumEffectiveLength && !geneBlocks[i].support.IsUnique() ) ) //|| len <= 100 )
+				if ( ( geneBlocks.GetExonCount( i ) == 1 && !geneBlocks.support[i].IsUnique() ) ||
+						( len < minimumEffectiveLength && !geneBlocks.support[i].IsUnique() ) ) //|| len <= 100 )
 				{
 					k = geneBlockGraph[i].size() ;
 					int cnt[2] = {0, 0} ;
@@ -2160,6 +2735,7 @@ class Blocks
 					//	printf( "%d %d %d\n", len, cnt[0], cnt[1] ) ;
 					if ( ( cnt[0] == 0 || cnt[1] == 0 ) ) //&& uniqueExtension != ( cnt[0] + cnt[1] ) )
 					{
+						graphStat.invalidated[ CLEAN_RULE_SHORT_GENE_BLOCK ] += cnt[0] + cnt[1] ;
 						geneBlockGraph[i].clear() ;
 						validGeneBlock[i] = false ;
 					}
@@ -2210,6 +2786,8 @@ class Blocks
 						geneBlockGraph[i][k] = geneBlockGraph[i][j] ;
 						++k ;
 					}
+					else if ( geneBlockGraph[i][j].valid )
+						++graphStat.invalidated[ CLEAN_RULE_SHORT_GENE_BLOCK ] ;
 				}
 				for ( j = cnt - 1 ; j >= k ; --j )
 				{
@@ -2224,6 +2802,176 @@ class Blocks
 				fprintf( fpOut, "Gene block graph:\n" ) ;
 				OutputGeneBlockGraph( alignments ) ;
 			}
+			FreezeGeneBlockGraph() ;
+		}
+
+		// The graph is read-only from now on, so compact it into the CSR form 
+		// and release the adjacency lists.
+		void FreezeGeneBlockGraph()
+		{
+			int i, j, k ;
+			int blockCnt = geneBlocks.size() ;
+			
+			geneBlockEdgeOffset = new int[ blockCnt + 1 ] ;
+			k = 0 ;
+			for ( i = 0 ; i < blockCnt ; ++i )
+			{
+				geneBlockEdgeOffset[i] = k ;
+				k += geneBlockGraph[i].size() ;
+			}
+			geneBlockEdgeOffset[i] = k ;
+
+			geneBlockEdges = new struct _compactMateEdge[k] ;
+			for ( i = 0 ; i < blockCnt ; ++i )
+			{
+				int cnt = geneBlockGraph[i].size() ;
+				for ( j = 0 ; j < cnt ; ++j )
+				{
+					struct _mateEdge &e = geneBlockGraph[i][j] ;
+					struct _compactMateEdge &ce = geneBlockEdges[ geneBlockEdgeOffset[i] + j ] ;
+					ce.u = e.u ;
+					ce.v = e.v ;
+					ce.supportUse = e.supportUse ;
+					if ( e.supportUse == -1 )
+					{
+						ce.support = 0 ;
+						ce.unique = false ;
+					}
+					else
+					{
+						ce.support = e.support[ e.supportUse ].GetCount() ;
+						ce.unique = e.support[ e.supportUse ].IsUnique() ;
+					}
+				}
+			}
+
+			delete[] geneBlockGraph ;
+			geneBlockGraph = NULL ;
+		}
+
+		void SetFragLengthBound()
+		{
+			if ( fragLengthQuantile > 0 )
+				fragLengthBound = GetFragLengthQuantile( fragLengthQuantile ) ;
+			else
+				fragLengthBound = fragLength + 2 * fragStd ;
+		}
+
+		// The smallest insert size x such that at least a q fraction of the sampled fragments are no longer than x.
+		int GetFragLengthQuantile( double q )
+		{
+			int i ;
+			int size = fragLengthHist.size() ;
+			int64_t total = 0 ;
+			for ( i = 0 ; i < size ; ++i )
+				total += fragLengthHist[i] ;
+			if ( total == 0 )
+				return 0 ;
+
+			int64_t cnt = 0 ;
+			for ( i = 0 ; i < size ; ++i )
+			{
+				cnt += fragLengthHist[i] ;
+				if ( cnt >= q * total )
+					return i ;
+			}
+			return size - 1 ;
+		}
+
+		// Write the state of the blocks after the given stage of the pipeline.
+		// Only the primary data are saved, the indices are rebuilt when loading.
+		void SaveSnapshot( FILE *fp, int stage )
+		{
+			int i ;
+			int geneBlockCnt = geneBlocks.size() ;
+
+			SnapshotWriteVector( fp, exonBlocks.chrId ) ;
+			SnapshotWriteVector( fp, exonBlocks.contigId ) ;
+			SnapshotWriteVector( fp, exonBlocks.start ) ;
+			SnapshotWriteVector( fp, exonBlocks.end ) ;
+			SnapshotWriteVector( fp, exonBlocks.leftSplice ) ;
+			SnapshotWriteVector( fp, exonBlocks.rightSplice ) ;
+			SnapshotWriteVector( fp, exonBlocks.support ) ;
+
+			SnapshotWrite( fp, &readLength, sizeof( readLength ), 1 ) ;
+			SnapshotWrite( fp, &fragLength, sizeof( fragLength ), 1 ) ;
+			SnapshotWrite( fp, &fragStd, sizeof( fragStd ), 1 ) ;
+			SnapshotWriteVector( fp, fragLengthHist ) ;
+			if ( stage < STAGE_GENE_BLOCK )
+				return ;
+
+			SnapshotWriteVector( fp, geneBlocks.chrId ) ;
+			SnapshotWriteVector( fp, geneBlocks.contigId ) ;
+			SnapshotWriteVector( fp, geneBlocks.start ) ;
+			SnapshotWriteVector( fp, geneBlocks.end ) ;
+			SnapshotWriteVector( fp, geneBlocks.support ) ;
+			SnapshotWriteVector( fp, geneBlocks.exonOffset ) ;
+			SnapshotWriteVector( fp, geneBlocks.exonIds ) ;
+			if ( stage < STAGE_GRAPH )
+				return ;
+
+			SnapshotWriteVector( fp, repeatEdges ) ;
+			if ( stage == STAGE_GRAPH )
+			{
+				for ( i = 0 ; i < geneBlockCnt ; ++i )
+					SnapshotWriteVector( fp, geneBlockGraph[i] ) ;
+			}
+			else
+			{
+				SnapshotWrite( fp, geneBlockEdgeOffset, sizeof( int ), geneBlockCnt + 1 ) ;
+				SnapshotWrite( fp, geneBlockEdges, sizeof( struct _compactMateEdge ), geneBlockEdgeOffset[ geneBlockCnt ] ) ;
+			}
+		}
+
+		void LoadSnapshot( FILE *fp, int stage )
+		{
+			int i ;
+			int geneBlockCnt ;
+
+			SnapshotReadVector( fp, exonBlocks.chrId ) ;
+			SnapshotReadVector( fp, exonBlocks.contigId ) ;
+			SnapshotReadVector( fp, exonBlocks.start ) ;
+			SnapshotReadVector( fp, exonBlocks.end ) ;
+			SnapshotReadVector( fp, exonBlocks.leftSplice ) ;
+			SnapshotReadVector( fp, exonBlocks.rightSplice ) ;
+			SnapshotReadVector( fp, exonBlocks.support ) ;
+			BuildExonBlockChrIdOffset() ;
+
+			SnapshotRead( fp, &readLength, sizeof( readLength ), 1 ) ;
+			SnapshotRead( fp, &fragLength, sizeof( fragLength ), 1 ) ;
+			SnapshotRead( fp, &fragStd, sizeof( fragStd ), 1 ) ;
+			SnapshotReadVector( fp, fragLengthHist ) ;
+			SetFragLengthBound() ;
+			if ( stage < STAGE_GENE_BLOCK )
+				return ;
+
+			SnapshotReadVector( fp, geneBlocks.chrId ) ;
+			SnapshotReadVector( fp, geneBlocks.contigId ) ;
+			SnapshotReadVector( fp, geneBlocks.start ) ;
+			SnapshotReadVector( fp, geneBlocks.end ) ;
+			SnapshotReadVector( fp, geneBlocks.support ) ;
+			SnapshotReadVector( fp, geneBlocks.exonOffset ) ;
+			SnapshotReadVector( fp, geneBlocks.exonIds ) ;
+			BuildGeneBlockExonIndex() ;
+			BuildGeneBlockLocator() ;
+			if ( stage < STAGE_GRAPH )
+				return ;
+
+			geneBlockCnt = geneBlocks.size() ;
+			SnapshotReadVector( fp, repeatEdges ) ;
+			if ( stage == STAGE_GRAPH )
+			{
+				geneBlockGraph = new std::vector<struct _mateEdge>[ geneBlockCnt ] ;
+				for ( i = 0 ; i < geneBlockCnt ; ++i )
+					SnapshotReadVector( fp, geneBlockGraph[i] ) ;
+			}
+			else
+			{
+				geneBlockEdgeOffset = new int[ geneBlockCnt + 1 ] ;
+				SnapshotRead( fp, geneBlockEdgeOffset, sizeof( int ), geneBlockCnt + 1 ) ;
+				geneBlockEdges = new struct _compactMateEdge[ geneBlockEdgeOffset[ geneBlockCnt ] ] ;
+				SnapshotRead( fp, geneBlockEdges, sizeof( struct _compactMateEdge ), geneBlockEdgeOffset[ geneBlockCnt ] ) ;
+			}
 		}
 
 		bool IsSignificantDifferent( double a, double b )
@@ -2291,7 +3039,7 @@ class Blocks
 
 			for ( i = 0 ; i < bcnt ; ++i )
 			{
-				fprintf( fpOut, "%d %s %d (%"PRId64" %"PRId64"): ", i, alignments.GetChromName( geneBlocks[i].chrId ), geneBlocks[i].contigId, geneBlocks[i].start + 1, geneBlocks[i].end + 1 ) ;
+				fprintf( fpOut, "%d %s %d (%"PRId64" %"PRId64"): ", i, alignments.GetChromName( geneBlocks.chrId[i] ), geneBlocks.contigId[i], geneBlocks.start[i] + 1, geneBlocks.end[i] + 1 ) ;
 				int cnt = geneBlockGraph[i].size() ;
 				for ( j = 0 ; j < cnt ; ++j )
 				{
@@ -2301,8 +3049,8 @@ class Blocks
 						s = -1 ;
 					else
 						s = geneBlockGraph[i][j].support[ geneBlockGraph[i][j].supportUse ].GetCount() ;
-					fprintf( fpOut, "(%d %s %d (%"PRId64" %"PRId64")):(%d %d) ", v, alignments.GetChromName( geneBlocks[v].chrId ), geneBlocks[v].contigId,
-							geneBlocks[v].start + 1, geneBlocks[v].end + 1,
+					fprintf( fpOut, "(%d %s %d (%"PRId64" %"PRId64")):(%d %d) ", v, alignments.GetChromName( geneBlocks.chrId[v] ), geneBlocks.contigId[v],
+							geneBlocks.start[v] + 1, geneBlocks.end[v] + 1,
 							geneBlockGraph[i][j].supportUse, s ) ;
 				}
 				fprintf( fpOut, "\n" ) ;
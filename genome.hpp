@@ -14,7 +14,9 @@
 
 #include "alignments.hpp"
 #include "KmerCode.hpp" 
+#include "KmerArray.hpp"
 #include "defs.h"
+#include "OutputWriter.hpp"
 
 extern char nucToNum[26] ;
 extern char numToNuc[26] ;
@@ -122,12 +124,22 @@ public:
 		std::cout<<"\n" ;
 	}
 
+	// The nucleotides are decoded into a chunk, which is written at once.
 	void Print( FILE *fp, int start, int end, bool rc )
 	{	
+		char chunk[65536] ;
+		int len = 0 ;
 		if ( !rc )
 		{
 			for ( int i = start ; i <= end ; ++i )
-				fprintf( fp, "%c", Get( i ) ) ;
+			{
+				chunk[ len++ ] = Get( i ) ;
+				if ( len == (int)sizeof( chunk ) )
+				{
+					fwrite( chunk, 1, len, fp ) ;
+					len = 0 ;
+				}
+			}
 		}
 		else
 		{
@@ -142,9 +154,15 @@ public:
 					c = 'C' ; 
 				else //if ( c == 'T' )
 					c = 'A' ; 
-				fprintf( fp, "%c", c ) ;
+				chunk[ len++ ] = c ;
+				if ( len == (int)sizeof( chunk ) )
+				{
+					fwrite( chunk, 1, len, fp ) ;
+					len = 0 ;
+				}
 			} 
 		}
+		fwrite( chunk, 1, len, fp ) ;
 	}
 } ;
 
@@ -156,9 +174,47 @@ private:
 	bool isOpen ;
 	std::vector<struct _contig> contigs ;
 	std::vector<struct _pair> contigRanges ;
+	const char *binaryContigListFile ;
+
+	// The binary contig listing: the magic, the number of chromosomes and their names, 
+	// the number of contigs, then for each contig the int32 chrId and the int64 1-based start and end.
+	void OutputBinaryContigList( Alignments &alignments )
+	{
+		FILE *fp = fopen( binaryContigListFile, "wb" ) ;
+		if ( fp == NULL )
+		{
+			fprintf( stderr, "Can not open %s.\n", binaryContigListFile ) ;
+			exit( 1 ) ;
+		}
+		OutputWriter writer( fp ) ;
+		int i ;
+		int chrCnt = alignments.GetChromCount() ;
+		writer.PutBytes( "RSCFCTG1", 8 ) ;
+		writer.PutBytes( (char *)&chrCnt, sizeof( chrCnt ) ) ;
+		for ( i = 0 ; i < chrCnt ; ++i )
+		{
+			const char *name = alignments.GetChromName( i ) ;
+			int len = strlen( name ) ;
+			writer.PutBytes( (char *)&len, sizeof( len ) ) ;
+			writer.PutBytes( name, len ) ;
+		}
+		int64_t cnt = contigs.size() ;
+		writer.PutBytes( (char *)&cnt, sizeof( cnt ) ) ;
+		for ( i = 0 ; i < cnt ; ++i )
+		{
+			int32_t chrId = contigs[i].chrId ;
+			int64_t start = contigs[i].start + 1 ;
+			int64_t end = contigs[i].end + 1 ;
+			writer.PutBytes( (char *)&chrId, sizeof( chrId ) ) ;
+			writer.PutBytes( (char *)&start, sizeof( start ) ) ;
+			writer.PutBytes( (char *)&end, sizeof( end ) ) ;
+		}
+		writer.Flush() ;
+		fclose( fp ) ;
+	}
 
 public:
-	Genome() { isOpen = false ;}
+	Genome() { isOpen = false ; binaryContigListFile = NULL ; }
 	~Genome() 
 	{
 		int size = genomes.size() ;
@@ -373,14 +429,61 @@ public:
 			}
 		}
 		
-		if ( fpOut != NULL )
+		if ( fpOut != NULL && binaryContigListFile != NULL )
+		{
+			fprintf( fpOut, "Contigs in %s\n", binaryContigListFile ) ;
+			OutputBinaryContigList( alignments ) ;
+		}
+		else if ( fpOut != NULL )
 		{
-			fprintf( fpOut, "Contigs\n" ) ;
-			for ( int i = 0 ; i < contigs.size() ; ++i )
-				fprintf( fpOut, "%d: %s %"PRId64" %"PRId64"\n", i, alignments.GetChromName( contigs[i].chrId ), contigs[i].start + 1, contigs[i].end + 1 ) ;
+			OutputWriter writer( fpOut ) ;
+			writer.PutString( "Contigs\n" ) ;
+			int cnt = contigs.size() ;
+			for ( int i = 0 ; i < cnt ; ++i )
+			{
+				writer.PutInt( i ) ;
+				writer.PutString( ": " ) ;
+				writer.PutString( alignments.GetChromName( contigs[i].chrId ) ) ;
+				writer.PutChar( ' ' ) ;
+				writer.PutInt( contigs[i].start + 1 ) ;
+				writer.PutChar( ' ' ) ;
+				writer.PutInt( contigs[i].end + 1 ) ;
+				writer.PutChar( '\n' ) ;
+			}
 		}
 	}
 
+	// Add a chromosome of one contig from the sequence, without the fasta file and the BAM header.
+	// Return the chromosome id.
+	int AddChrom( const char *seq )
+	{
+		int len = strlen( seq ) ;
+		int chrId = genomes.size() ;
+		BitSequence bs( len ) ;
+		for ( int i = 0 ; i < len ; ++i )
+			bs.Append( seq[i] ) ;
+		genomes.push_back( bs ) ;
+
+		struct _contig c ;
+		c.start = 0 ;
+		c.end = len - 1 ;
+		c.chrId = chrId ;
+		c.id = contigs.size() ;
+		contigs.push_back( c ) ;
+
+		struct _pair range ;
+		range.a = range.b = c.id ;
+		contigRanges.push_back( range ) ;
+		isOpen = true ;
+		return chrId ;
+	}
+
+	// Write the contig listing to the file in binary instead of the text in fpOut.
+	void SetBinaryContigList( const char *file )
+	{
+		binaryContigListFile = file ;
+	}
+
 	bool IsOpen()
 	{
 		return isOpen ;
@@ -515,11 +618,13 @@ public:
 	}
 
 	// The function handle kmers========================================================
-	void AddKmer( int chrId, int from, int to, int kl, std::map<uint64_t, int> &kmers ) 
+	// T is the word type holding the kmer code, see KmerCode.hpp
+	template <typename T>
+	void AddKmer( int chrId, int from, int to, int kl, std::map<T, int> &kmers ) 
 	{
 		if ( kl <= 0 )
 			return ;
-		KmerCode code( kl ) ;
+		KmerCode<T> code( kl ) ;
 		int i ;
 		BitSequence &s = genomes[chrId] ;
 		for ( i = from ; i < from + kl - 1 ; ++i )
@@ -532,7 +637,7 @@ public:
 		{
 			if ( code.IsValid() )
 			{
-				uint64_t key = code.GetCanonicalKmerCode() ;
+				T key = code.GetCanonicalKmerCode() ;
 				if ( kmers.count( key ) > 0 )
 					++kmers[key] ;
 				else
@@ -543,7 +648,7 @@ public:
 		
 		if ( code.IsValid() )
 		{
-			uint64_t key = code.GetCanonicalKmerCode() ;
+			T key = code.GetCanonicalKmerCode() ;
 			if ( kmers.count( key ) > 0 )
 				++kmers[key] ;
 			else
@@ -551,11 +656,12 @@ public:
 		}
 	}
 
-	int GetKmerCoverage( int chrId, int from, int to, int kl, std::map<uint64_t, int> &kmers )
+	template <typename T>
+	int GetKmerCoverage( int chrId, int from, int to, int kl, std::map<T, int> &kmers )
 	{
 		if ( kl <= 0 || to - from + 1 < kl )
 			return 0 ;
-		KmerCode code( kl ) ;
+		KmerCode<T> code( kl ) ;
 		int i ;
 		BitSequence &s = genomes[chrId] ;
 		for ( i = from ; i < from + kl - 1 ; ++i )
@@ -570,7 +676,7 @@ public:
 		{
 			if ( code.IsValid() )
 			{
-				uint64_t key = code.GetCanonicalKmerCode() ;
+				T key = code.GetCanonicalKmerCode() ;
 				if ( kmers.count( key ) > 0 )
 				{
 					if ( i <= prevHit + kl - 1 )
@@ -584,7 +690,7 @@ public:
 		}
 		if ( code.IsValid() )
 		{
-			uint64_t key = code.GetCanonicalKmerCode() ;
+			T key = code.GetCanonicalKmerCode() ;
 			if ( kmers.count( key ) > 0 )
 			{
 				if ( i <= prevHit + kl - 1 )
@@ -597,11 +703,12 @@ public:
 		return ret ;
 	}
 
-	int CountStoredKmer( int chrId, int from, int to, int kl, std::map<uint64_t, int> &kmers, bool test = false )
+	template <typename T>
+	int CountStoredKmer( int chrId, int from, int to, int kl, std::map<T, int> &kmers, bool test = false )
 	{
 		if ( kl <= 0 )
 			return 0 ;
-		KmerCode code( kl ) ;
+		KmerCode<T> code( kl ) ;
 		int i ;
 		int ret = 0 ;
 		BitSequence &s = genomes[chrId] ;
@@ -612,7 +719,7 @@ public:
 		{
 			if ( code.IsValid() )
 			{
-				std::map<uint64_t, int>::iterator it = kmers.find( code.GetCanonicalKmerCode() ) ;
+				typename std::map<T, int>::iterator it = kmers.find( code.GetCanonicalKmerCode() ) ;
 				if ( it != kmers.end() )
 				{
 					if ( test )
@@ -625,7 +732,7 @@ public:
 		
 		if ( code.IsValid() )
 		{
-			std::map<uint64_t, int>::iterator it = kmers.find( code.GetCanonicalKmerCode() ) ;
+			typename std::map<T, int>::iterator it = kmers.find( code.GetCanonicalKmerCode() ) ;
 			if ( it != kmers.end() )
 			{
 				//if ( test )
@@ -638,11 +745,12 @@ public:
 		return ret ;
 	}
 
-	int CompareKmerSets( std::map<uint64_t, int> &kmersA, std::map<uint64_t, int> &kmersB )
+	template <typename T>
+	int CompareKmerSets( std::map<T, int> &kmersA, std::map<T, int> &kmersB )
 	{
 		int ret = 0 ;
-		std::map<uint64_t, int>::iterator itA = kmersA.begin() ; 
-		std::map<uint64_t, int>::iterator itB ;
+		typename std::map<T, int>::iterator itA = kmersA.begin() ; 
+		typename std::map<T, int>::iterator itB ;
 		for ( ; itA != kmersA.end() ; ++itA )
 		{
 			int a = itA->second ;
@@ -654,6 +762,67 @@ public:
 		}
 		return ret ;
 	}
+
+	// The functions for the kmers stored in sorted arrays. =============================
+	// Call kmers.Build() after adding all the kmers.
+	template <typename T>
+	void AddKmer( int chrId, int from, int to, int kl, KmerArray<T> &kmers ) 
+	{
+		if ( kl <= 0 )
+			return ;
+		KmerCode<T> code( kl ) ;
+		int i ;
+		BitSequence &s = genomes[chrId] ;
+		kmers.SetKeyBits( 2 * kl ) ;
+		for ( i = from ; i < from + kl - 1 ; ++i )
+			code.Append( s.Get( i ) ) ;
+
+		for ( ; i <= to ; ++i )
+		{
+			if ( code.IsValid() )
+				kmers.Add( code.GetCanonicalKmerCode() ) ;
+			code.Append( s.Get( i ) ) ;
+		}
+		
+		if ( code.IsValid() )
+			kmers.Add( code.GetCanonicalKmerCode() ) ;
+	}
+
+	template <typename T>
+	int GetKmerCoverage( int chrId, int from, int to, int kl, KmerArray<T> &kmers )
+	{
+		if ( kl <= 0 || to - from + 1 < kl )
+			return 0 ;
+		KmerCode<T> code( kl ) ;
+		int i ;
+		BitSequence &s = genomes[chrId] ;
+		for ( i = from ; i < from + kl - 1 ; ++i )
+			code.Append( s.Get( i ) ) ;
+		int prevHit = -2 * kl ;
+		int ret = 0 ;
+
+		for ( ; i <= to ; ++i )
+		{
+			if ( code.IsValid() && kmers.IsIn( code.GetCanonicalKmerCode() ) )
+			{
+				if ( i <= prevHit + kl - 1 )
+					ret += i - prevHit ;
+				else
+					ret += kl ;
+				prevHit = i ;
+			}
+			code.Append( s.Get( i ) ) ;
+		}
+		if ( code.IsValid() && kmers.IsIn( code.GetCanonicalKmerCode() ) )
+		{
+			if ( i <= prevHit + kl - 1 )
+				ret += i - prevHit ;
+			else
+				ret += kl ;
+			prevHit = i ;
+		}
+		return ret ;
+	}
 } ;
 
 #endif
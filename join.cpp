@@ -11,13 +11,15 @@
 #include "genome.hpp" 
 #include "alignments.hpp"
 #include "ContigGraph.hpp"
+#include "Stats.hpp"
 
 const char *usage = "usage: rascaf_join [OPTIONS]\n"
 		"OPTIONS:\n"
 		"\t-r STRING: the path to the rascaf output. Can use multiple of -r. (required)\n"
 		"\t-o STRING: the prefix of the output file. (default: rascaf_scaffold)\n"
 		"\t-ms INT: minimum support alignments for the connection (default: 2)\n"
-		"\t-ignoreGap: ignore the gap size, which do not consider the number of Ns between contigs (default: not used)\n";
+		"\t-ignoreGap: ignore the gap size, which do not consider the number of Ns between contigs (default: not used)\n"
+		"\t-stats STRING: output the time, the peak memory and the counters of each stage to file STRING in JSON (default: not used)\n";
 
 bool VERBOSE = false ;
 int minSupport = 2 ;
@@ -272,6 +274,8 @@ int main( int argc, char *argv[] )
 	char infoFileName[512] ;
 	char outputFileName[512] ;
 	char fullpathBuffer[4096] ;
+	char *statsFile = NULL ;
+	Stats stats ;
 
 	breakN = 1 ;
 
@@ -296,6 +300,11 @@ int main( int argc, char *argv[] )
 		{
 			ignoreGap = true ;
 		}
+		else if ( !strcmp( "-stats", argv[i] ) || !strcmp( "--stats", argv[i] ) )
+		{
+			statsFile = argv[i + 1] ;
+			++i ;
+		}
 		else if ( !strcmp( "-r", argv[i] ) )
 		{
 			rascafFileId.push_back( i + 1 ) ; 
@@ -321,6 +330,7 @@ int main( int argc, char *argv[] )
 	sprintf( outputFileName, "%s.fa", prefix ) ;
 	
 	// Get the bam file.
+	stats.BeginStage( "genome" ) ;
 	rascafFile = fopen( argv[ rascafFileId[0] ], "r" ) ;
 	while ( fgets( line, sizeof( line ), rascafFile ) != NULL ) 
 	{
@@ -387,7 +397,11 @@ int main( int argc, char *argv[] )
 	}
 
 
+	stats.AddCounter( "contigs", genome.GetContigCount() ) ;
+
 	// Parse the input.
+	stats.BeginStage( "read" ) ;
+	stats.AddCounter( "files", rascafFileId.size() ) ;
 	for ( unsigned int fid = 0 ; fid < rascafFileId.size() ; ++fid )
 	{
 		rascafFile = fopen( argv[ rascafFileId[fid] ], "r" ) ;
@@ -467,9 +481,11 @@ int main( int argc, char *argv[] )
 		genome.SetIsOpen( contigLevel ) ;
 	}
 	fprintf( stderr, "Finish reading the rascaf output files.\n" ) ;
+	stats.AddCounter( "connections", connects.size() ) ;
 
 	
 	// Build the graph
+	stats.BeginStage( "graph" ) ;
 	int contigCnt = genome.GetContigCount() ;
 	int edgeCnt = 0 ;
 	int csize = connects.size() ;
@@ -486,6 +502,8 @@ int main( int argc, char *argv[] )
 		}
 	}
 	struct _pair *neighbors = new struct _pair[ MAX_NEIGHBOR ] ;
+	int addedEdgeCnt = 0 ;
+	int removedEdgeCnt = 0 ;
 	for ( i = 0 ; i < csize ; ++i )	
 	{
 		std::vector<struct _part> &parts = connects[i] ;
@@ -503,9 +521,11 @@ int main( int argc, char *argv[] )
 			if ( b.strand == '-' )
 				dummyV = 1 ;
 			
-			contigGraph.AddEdge( a.contigId, dummyU, b.contigId, dummyV, true ) ;
+			if ( contigGraph.AddEdge( a.contigId, dummyU, b.contigId, dummyV, true ) )
+				++addedEdgeCnt ;
 		}
 	}
+	stats.AddCounter( "edges.added", addedEdgeCnt ) ;
 
 	// Check the cycles in the contig graph. This may introduces when combining different rascaf outputs.
 	int *visitTime = new int[contigCnt] ;
@@ -543,11 +563,16 @@ int main( int argc, char *argv[] )
 						&& genome.GetChrIdFromContigId( i ) == genome.GetChrIdFromContigId( neighbors[j].a ) )
 						continue ; // the connection created by the raw assembly
 					else
+					{
 						contigGraph.RemoveEdge( i, dummy, neighbors[j].a, neighbors[j].b ) ;
+						++removedEdgeCnt ;
+					}
 				}
 			}
 		}
 	}
+	stats.AddCounter( "edges.removed.cycle", removedEdgeCnt ) ;
+	removedEdgeCnt = 0 ;
 	
 	//printf( "hi: %d %d\n", __LINE__, contigCnt ) ;
 	//printf( "%d %d\n", contigGraph.GetNeighbors( 163558, 0, neighbors, MAX_NEIGHBOR ), contigGraph.GetNeighbors( 163558, 1, neighbors, MAX_NEIGHBOR ) ) ;
@@ -616,13 +641,19 @@ int main( int argc, char *argv[] )
 						&& genome.GetChrIdFromContigId( i ) == genome.GetChrIdFromContigId( neighbors[j].a ) )
 						continue ; // the connection created by the raw assembly
 					else
+					{
 						contigGraph.RemoveEdge( i, dummy, neighbors[j].a, neighbors[j].b ) ;
+						++removedEdgeCnt ;
+					}
 				}
 			}
 		}
 	}
 	delete[] isInCycle ;
 	fprintf( stderr, "Finish removing cycles in the graph.\n" ) ;
+	stats.AddCounter( "edges.removed.triangularCycle", removedEdgeCnt ) ;
+
+	stats.BeginStage( "order" ) ;
 
 
 	memset( used, false, sizeof( bool ) * contigCnt ) ;
@@ -965,6 +996,7 @@ int main( int argc, char *argv[] )
 	fprintf( stderr, "Finish ordering the scaffolds.\n" ) ;
 	
 	// Output the scaffold
+	stats.BeginStage( "output" ) ;
 	int id = 0 ;
 	outputFile = fopen( outputFileName, "w" ) ;
 	infoFile = fopen( infoFileName, "w") ;
@@ -1053,6 +1085,9 @@ int main( int argc, char *argv[] )
 	delete[] degree ;
 	delete[] neighbors ;
 
+	stats.AddCounter( "scaffolds", id ) ;
+	if ( statsFile != NULL )
+		stats.Output( statsFile, "rascaf-join" ) ;
 	//fclose( rascafFile ) ;
 	return 0 ;
 }
@@ -5,11 +5,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "alignments.hpp"
 #include "blocks.hpp"
 #include "scaffold.hpp"
 #include "genome.hpp"
+#include "Stats.hpp"
 
 char usage[] = "usage: rascaf [options]\n"
 	       "options:\n"
@@ -21,8 +24,19 @@ char usage[] = "usage: rascaf [options]\n"
 	       "\t-ml INT: minimum exonic length(default: 200)\n"
 	       "\t-breakN INT: the least number of Ns to break a scaffold in the raw assembly (default: 1)\n"
 	       //"\t-minContigSize INT: the minimum length of a contig that can break a gene block. (default:200)"
-	       "\t-k INT: the size of a kmer(<=32; <=0 if you do not want to use kmer. default: 23)\n"
+	       "\t-k INT: the size of a kmer(<=64; <=0 if you do not want to use kmer. default: 23)\n"
+	       "\t-t INT: number of threads (default: 1)\n"
+	       "\t-fq FLOAT: use this quantile of the insert size distribution as the largest insert size of a pair connecting two gene blocks (default: not used, mean+2*std)\n"
+	       "\t-checkpoint : save the state after each stage in file $prefix_STAGE.snapshot (default: not used)\n"
+	       "\t-resume-from STRING: skip the stages up to STRING by loading its snapshot. STRING can be exonblock, geneblock, graph, cleangraph or component (default: not used)\n"
+	       "\t-snapshot STRING: prefix of the snapshot files to resume from (default: the prefix of the output)\n"
+	       "\t-sweep STRING: run the stages after building the gene block graph for each ms:k pair in the comma-separated list, and output to $prefix_msMS_kK.out (default: not used)\n"
+	       "\t-exact INT: scaffold the components with at most INT gene blocks (<=32) by the exact solver instead of the greedy one (default: 0, not used)\n"
+	       "\t-exactTime INT: the time budget in milliseconds of the exact solver for a component, the greedy one is used after that (default: 100)\n"
+	       "\t-componentTime : output the solver and the time of each component in file $prefix_component_time.txt (default: not used)\n"
+	       "\t-cb : output the contig listing in binary to file $prefix_contigs.bin instead of $prefix.out (default: not used)\n"
 	       "\t-cs : output the genomic sequence involved in connections in file $prefix_cs.fa (default: not used)\n"
+	       "\t-stats STRING: output the time, the peak memory and the counters of each stage to file STRING in JSON. With -sweep, each run outputs to STRING_msMS_kK (default: not used)\n"
 	       //"\t-aggressive: make connection decisions more aggressively, may introduce much more misassemblies. (default: not used)\n"
 	       "\t-v : verbose mode (default: false)\n" ;
 
@@ -36,6 +50,126 @@ bool VERBOSE ;
 FILE *fpOut ;
 int breakN ;
 int minContigSize ;
+int numOfThreads ;
+double fragLengthQuantile ;
+int exactComponentSize ;
+int exactTimeLimit ;
+bool outputComponentTime ;
+Stats stats ;
+char *statsFile ;
+
+void SaveSnapshot( const char *snapshotPrefix, int stage, Blocks &blocks, Scaffold *scaffold )
+{
+	char buffer[1024] ;
+	sprintf( buffer, "%s_%s.snapshot", snapshotPrefix, stageNames[stage] ) ;
+	FILE *fp = fopen( buffer, "wb" ) ;
+	if ( fp == NULL )
+	{
+		fprintf( stderr, "Can not open %s.\n", buffer ) ;
+		exit( 1 ) ;
+	}
+	SnapshotWriteHeader( fp, stage ) ;
+	blocks.SaveSnapshot( fp, stage ) ;
+	if ( scaffold != NULL )
+		scaffold->SaveSnapshot( fp ) ;
+	fclose( fp ) ;
+}
+
+// Move the counters of the alignments read so far into the current stage.
+void AddReadStat( Alignments &alignments, const char *name )
+{
+	char buffer[128] ;
+	const struct _readStat &readStat = alignments.GetReadStat() ;
+	sprintf( buffer, "%s.consumed", name ) ;
+	stats.AddCounter( buffer, readStat.consumed ) ;
+	sprintf( buffer, "%s.rejected.flag", name ) ;
+	stats.AddCounter( buffer, readStat.flag ) ;
+	sprintf( buffer, "%s.rejected.lowComplexity", name ) ;
+	stats.AddCounter( buffer, readStat.lowComplexity ) ;
+	sprintf( buffer, "%s.rejected.secondary", name ) ;
+	stats.AddCounter( buffer, readStat.secondary ) ;
+	sprintf( buffer, "%s.rejected.mateIncompatible", name ) ;
+	stats.AddCounter( buffer, readStat.mateIncompatible ) ;
+	alignments.ClearReadStat() ;
+}
+
+// Output the command line. The -sweep option is replaced by extra, the parameters of one run.
+void OutputCommandLine( int argc, char *argv[], const char *extra )
+{
+	int i ;
+	fprintf( fpOut, "command line:" ) ;
+	char *fullpath = (char *)malloc( sizeof( char ) * 4096 ) ;
+	for ( i = 0 ; i < argc ; ++i )
+	{
+		if ( extra != NULL && !strcmp( argv[i], "-sweep" ) )
+		{
+			++i ;
+			continue ;
+		}
+
+		if ( i > 0 && ( !strcmp( argv[i - 1], "-b" ) || !strcmp( argv[i - 1], "-f" ) ) )
+		{
+			if ( realpath( argv[i], fullpath ) == NULL )
+			{
+				fprintf( stderr, "Failed to resolve the path of file %s.\n", argv[i] ) ;
+				exit( 1 ) ;
+			}
+			fprintf( fpOut, " %s", fullpath ) ;
+		}
+		else
+			fprintf( fpOut, " %s", argv[i] ) ;
+	}
+	if ( extra != NULL )
+		fprintf( fpOut, " %s", extra ) ;
+	fprintf( fpOut, "\n" ) ;
+	free( fullpath ) ;
+}
+
+// The stages after building the gene block graph, which depend on minimumSupport and kmerSize.
+void CleanAndScaffold( Blocks &blocks, Alignments &alignments, Genome &genome, int resumeStage, FILE *fpSnapshot, 
+	bool checkpoint, int argc, char *argv[], const char *extra )
+{
+	// Cleaning
+	if ( resumeStage < STAGE_CLEAN_GRAPH )
+	{
+		stats.BeginStage( "cleangraph" ) ;
+		blocks.CleanGeneBlockGraph( alignments, genome ) ;
+		for ( int i = 0 ; i < CLEAN_RULE_COUNT ; ++i )
+		{
+			char buffer[128] ;
+			sprintf( buffer, "edges.invalidated.%s", cleanRuleNames[i] ) ;
+			stats.AddCounter( buffer, blocks.graphStat.invalidated[i] ) ;
+		}
+		if ( checkpoint )
+			SaveSnapshot( prefix, STAGE_CLEAN_GRAPH, blocks, NULL ) ;
+	}
+
+	// Scaffolding
+	stats.BeginStage( "component" ) ;
+	Scaffold scaffold( blocks, genome ) ;
+	//scaffold.Init( blocks ) ;
+	int componentCnt ;
+	if ( resumeStage < STAGE_COMPONENT )
+	{
+		componentCnt = scaffold.BuildComponent() ;
+		if ( checkpoint )
+			SaveSnapshot( prefix, STAGE_COMPONENT, blocks, &scaffold ) ;
+	}
+	else
+		componentCnt = scaffold.LoadSnapshot( fpSnapshot ) ;
+	fprintf( stderr, "Found %d non-trivial gene block components.\n", componentCnt ) ;
+	stats.AddCounter( "components", componentCnt ) ;
+
+	stats.BeginStage( "scaffold" ) ;
+	scaffold.ScaffoldComponents() ;
+	
+	scaffold.ScaffoldGenome() ;
+	
+	stats.BeginStage( "output" ) ;
+	OutputCommandLine( argc, argv, extra ) ;
+	scaffold.Output( fpOut, alignments ) ;
+	stats.EndStage() ;
+}
 
 int main( int argc, char *argv[] )
 {
@@ -47,6 +181,13 @@ int main( int argc, char *argv[] )
 	Blocks blocks ;
 	Genome genome ;
 	char *genomeFile = NULL ;
+	bool checkpoint = false ;
+	bool binaryContigList = false ;
+	int resumeStage = STAGE_NONE ;
+	char *snapshotPrefix = NULL ;
+	FILE *fpSnapshot = NULL ;
+	std::vector<int> sweepSupport ;
+	std::vector<int> sweepKmerSize ;
 	
 	if ( argc < 2 )
 	{
@@ -59,8 +200,14 @@ int main( int argc, char *argv[] )
 	kmerSize = 23 ;
 	breakN = 1 ;
 	minContigSize = 200 ;
+	numOfThreads = 1 ;
+	fragLengthQuantile = -1 ;
+	exactComponentSize = 0 ;
+	exactTimeLimit = 100 ;
+	outputComponentTime = false ;
 	prefix = NULL ;
 	VERBOSE = false ;
+	statsFile = NULL ;
 	outputConnectionSequence = false ;
 	aggressiveMode = false ;
 
@@ -111,6 +258,95 @@ int main( int argc, char *argv[] )
 			minContigSize = atoi( argv[i + 1] ) ;
 			++i ;
 		}
+		else if ( !strcmp( "-t", argv[i] ) )
+		{
+			numOfThreads = atoi( argv[i + 1] ) ;
+			if ( numOfThreads < 1 )
+				numOfThreads = 1 ;
+			++i ;
+		}
+		else if ( !strcmp( "-fq", argv[i] ) )
+		{
+			fragLengthQuantile = atof( argv[i + 1] ) ;
+			if ( fragLengthQuantile > 1 )
+			{
+				fprintf( stderr, "The quantile for -fq should be in (0, 1].\n" ) ;
+				exit( 1 ) ;
+			}
+			++i ;
+		}
+		else if ( !strcmp( "-exact", argv[i] ) )
+		{
+			exactComponentSize = atoi( argv[i + 1] ) ;
+			if ( exactComponentSize > MAX_EXACT_COMPONENT_SIZE )
+			{
+				fprintf( stderr, "The component size for -exact should be no larger than %d.\n", MAX_EXACT_COMPONENT_SIZE ) ;
+				exit( 1 ) ;
+			}
+			++i ;
+		}
+		else if ( !strcmp( "-exactTime", argv[i] ) )
+		{
+			exactTimeLimit = atoi( argv[i + 1] ) ;
+			++i ;
+		}
+		else if ( !strcmp( "-componentTime", argv[i] ) )
+		{
+			outputComponentTime = true ;
+		}
+		else if ( !strcmp( "-checkpoint", argv[i] ) )
+		{
+			checkpoint = true ;
+		}
+		else if ( !strcmp( "-resume-from", argv[i] ) )
+		{
+			if ( i + 1 >= argc )
+			{
+				fprintf( stderr, "-resume-from misses arguments.\n" ) ;
+				exit( 1 ) ;
+			}
+			resumeStage = GetStageId( argv[i + 1] ) ;
+			if ( resumeStage == -1 )
+			{
+				fprintf( stderr, "Unknown stage for -resume-from: %s\n", argv[i + 1] ) ;
+				exit( 1 ) ;
+			}
+			++i ;
+		}
+		else if ( !strcmp( "-snapshot", argv[i] ) )
+		{
+			snapshotPrefix = argv[i + 1] ;
+			++i ;
+		}
+		else if ( !strcmp( "-sweep", argv[i] ) )
+		{
+			if ( i + 1 >= argc )
+			{
+				fprintf( stderr, "-sweep misses arguments.\n" ) ;
+				exit( 1 ) ;
+			}
+			char *p = argv[i + 1] ;
+			while ( *p )
+			{
+				int ms, k, len ;
+				if ( sscanf( p, "%d:%d%n", &ms, &k, &len ) != 2 )
+				{
+					fprintf( stderr, "The format of -sweep should be ms:k,ms:k,...\n" ) ;
+					exit( 1 ) ;
+				}
+				sweepSupport.push_back( ms ) ;
+				sweepKmerSize.push_back( k ) ;
+				p += len ;
+				if ( *p == ',' )
+					++p ;
+				else if ( *p != '\0' )
+				{
+					fprintf( stderr, "The format of -sweep should be ms:k,ms:k,...\n" ) ;
+					exit( 1 ) ;
+				}
+			}
+			++i ;
+		}
 		else if ( !strcmp( "-v", argv[i] ) )
 		{
 			VERBOSE = true ;
@@ -119,10 +355,19 @@ int main( int argc, char *argv[] )
 		{
 			outputConnectionSequence = true ;
 		}
+		else if ( !strcmp( "-cb", argv[i] ) )
+		{
+			binaryContigList = true ;
+		}
 		/*else if ( !strcmp( "-aggressive", argv[i] ) )
 		{
 			aggressiveMode = true ;
 		}*/
+		else if ( !strcmp( "-stats", argv[i] ) || !strcmp( "--stats", argv[i] ) )
+		{
+			statsFile = argv[i + 1] ;
+			++i ;
+		}
 		else if ( !strcmp( "-bc", argv[i] ) )
 		{
 			// So far, assume the input is from BWA mem
@@ -142,6 +387,32 @@ int main( int argc, char *argv[] )
 		exit( 1 ) ;
 	}
 
+	if ( kmerSize > KmerCode<unsigned __int128>::GetMaxKmerLength() )
+	{
+		fprintf( stderr, "The kmer size should be no larger than %d.\n", KmerCode<unsigned __int128>::GetMaxKmerLength() ) ;
+		exit( 1 ) ;
+	}
+
+	for ( i = 0 ; i < (int)sweepKmerSize.size() ; ++i )
+	{
+		if ( sweepKmerSize[i] > KmerCode<unsigned __int128>::GetMaxKmerLength() )
+		{
+			fprintf( stderr, "The kmer size should be no larger than %d.\n", KmerCode<unsigned __int128>::GetMaxKmerLength() ) ;
+			exit( 1 ) ;
+		}
+		// The clipped alignments are filtered by the kmer size when building the graph.
+		if ( clippedAlignments.IsOpened() && sweepKmerSize[i] != kmerSize )
+		{
+			fprintf( stderr, "With -bc, the kmer sizes in -sweep should be the same as -k.\n" ) ;
+			exit( 1 ) ;
+		}
+	}
+	if ( sweepSupport.size() > 0 && resumeStage >= STAGE_CLEAN_GRAPH )
+	{
+		fprintf( stderr, "-sweep needs the gene block graph before cleaning, so it can not resume from %s.\n", stageNames[ resumeStage ] ) ;
+		exit( 1 ) ;
+	}
+
 	if ( !alignments.IsOpened() )
 	{
 		printf( "Must use -b to specify the bam file.\n" ) ;
@@ -162,10 +433,20 @@ int main( int argc, char *argv[] )
 		fpOut = fopen( buffer, "w" ) ;
 	}
 	
+	char contigListFile[1024] ;
+	if ( binaryContigList )
+	{
+		sprintf( contigListFile, "%s_contigs.bin", prefix ) ;
+		genome.SetBinaryContigList( contigListFile ) ;
+	}
+
 	if ( genomeFile != NULL )
 	{
+		stats.BeginStage( "genome" ) ;
 		genome.Open( alignments, genomeFile ) ;
 		alignments.Rewind() ;
+		stats.AddCounter( "contigs", genome.GetContigCount() ) ;
+		stats.EndStage() ;
 	}
 
 	if ( outputConnectionSequence == true && genomeFile == NULL )
@@ -173,83 +454,195 @@ int main( int argc, char *argv[] )
 		fprintf( stderr, "Must use -f to specify assembly file when using -cs\n" ) ;	
 		exit( EXIT_FAILURE ) ;
 	}
+	if ( snapshotPrefix == NULL )
+		snapshotPrefix = prefix ;
+	if ( resumeStage != STAGE_NONE )
+	{
+		// The stages up to resumeStage are replaced by the snapshot.
+		char buffer[1024] ;
+		sprintf( buffer, "%s_%s.snapshot", snapshotPrefix, stageNames[ resumeStage ] ) ;
+		fpSnapshot = fopen( buffer, "rb" ) ;
+		if ( fpSnapshot == NULL )
+		{
+			fprintf( stderr, "Can not open %s.\n", buffer ) ;
+			exit( 1 ) ;
+		}
+		if ( SnapshotReadHeader( fpSnapshot ) != resumeStage )
+		{
+			fprintf( stderr, "%s is not the snapshot of stage %s.\n", buffer, stageNames[ resumeStage ] ) ;
+			exit( 1 ) ;
+		}
+		stats.BeginStage( "resume" ) ;
+		blocks.LoadSnapshot( fpSnapshot, resumeStage ) ;
+		stats.EndStage() ;
+		fprintf( stderr, "Resume from %s.\n", buffer ) ;
+	}
+
 	// 74619
 	//printf( "%c\n", genome.GetNucleotide( 74619, 4 ) ) ;
 	//exit(0) ;
 	// Build the graph
-	ret = blocks.BuildExonBlocks( alignments, genome ) ;
-	alignments.Rewind() ;
-	fprintf( stderr, "Found %d exon blocks.\n", ret ) ;
-	if ( clippedAlignments.IsOpened() )
+	if ( resumeStage < STAGE_EXON_BLOCK )
 	{
-		fprintf( stderr, "Extend exon blocks with clipped alignments.\n" ) ;
-		Blocks extendBlocks ;
-		extendBlocks.BuildExonBlocks( clippedAlignments, genome ) ;
-		clippedAlignments.Rewind() ;
+		stats.BeginStage( "exonblock" ) ;
+		alignments.ClearReadStat() ;
+		ret = blocks.BuildExonBlocks( alignments, genome ) ;
+		alignments.Rewind() ;
+		fprintf( stderr, "Found %d exon blocks.\n", ret ) ;
+		if ( clippedAlignments.IsOpened() )
+		{
+			fprintf( stderr, "Extend exon blocks with clipped alignments.\n" ) ;
+			Blocks extendBlocks ;
+			extendBlocks.BuildExonBlocks( clippedAlignments, genome ) ;
+			clippedAlignments.Rewind() ;
+			AddReadStat( clippedAlignments, "clippedReads" ) ;
 
-		ret = blocks.ExtendExonBlocks( extendBlocks ) ;
-		fprintf( stderr, "Found %d exon blocks after extension.\n", ret ) ;
-	}
+			ret = blocks.ExtendExonBlocks( extendBlocks ) ;
+			fprintf( stderr, "Found %d exon blocks after extension.\n", ret ) ;
+		}
 
-	blocks.GetAlignmentsInfo( alignments ) ;
-	alignments.Rewind() ;
+		blocks.GetAlignmentsInfo() ;
+		AddReadStat( alignments, "reads" ) ;
+		stats.AddCounter( "exonBlocks", ret ) ;
+		if ( checkpoint )
+			SaveSnapshot( prefix, STAGE_EXON_BLOCK, blocks, NULL ) ;
+	}
 
-	ret = blocks.BuildGeneBlocks( alignments, genome ) ;
-	alignments.Rewind() ;
-	fprintf( stderr, "Found %d gene blocks.\n", ret ) ;
-	
-	blocks.BuildGeneBlockGraph( alignments ) ;
-	if ( clippedAlignments.IsOpened() )
+	if ( resumeStage < STAGE_GENE_BLOCK )
 	{
-		blocks.AddGeneBlockGraphByClippedAlignments( clippedAlignments ) ; 
+		stats.BeginStage( "geneblock" ) ;
+		alignments.ClearReadStat() ;
+		ret = blocks.BuildGeneBlocks( alignments, genome ) ;
+		alignments.Rewind() ;
+		fprintf( stderr, "Found %d gene blocks.\n", ret ) ;
+		AddReadStat( alignments, "reads" ) ;
+		stats.AddCounter( "geneBlocks", ret ) ;
+		if ( checkpoint )
+			SaveSnapshot( prefix, STAGE_GENE_BLOCK, blocks, NULL ) ;
 	}
 	
-	// Cleaning
-	blocks.CleanGeneBlockGraph( alignments, genome ) ;
-
-	// Scaffolding
-	Scaffold scaffold( blocks, genome ) ;
-	//scaffold.Init( blocks ) ;
-	int componentCnt = scaffold.BuildComponent() ;
-	fprintf( stderr, "Found %d non-trivial gene block components.\n", componentCnt ) ;
-	// Possible for parallelization
-	for ( i = 0 ; i < componentCnt ; ++i )
+	if ( resumeStage < STAGE_GRAPH )
 	{
-		scaffold.ScaffoldComponent( i ) ;
+		stats.BeginStage( "graph" ) ;
+		alignments.ClearReadStat() ;
+		blocks.BuildGeneBlockGraph( alignments ) ;
+		if ( clippedAlignments.IsOpened() )
+		{
+			blocks.AddGeneBlockGraphByClippedAlignments( clippedAlignments ) ; 
+		}
+		AddReadStat( alignments, "reads" ) ;
+		stats.AddCounter( "reads.rejected.noBlock", blocks.graphStat.noBlock ) ;
+		stats.AddCounter( "reads.rejected.sameBlock", blocks.graphStat.sameBlock ) ;
+		stats.AddCounter( "reads.rejected.farMate", blocks.graphStat.farMate ) ;
+		stats.AddCounter( "reads.edge", blocks.graphStat.edgeReads ) ;
+		stats.AddCounter( "edges.added", blocks.graphStat.edges ) ;
+		stats.AddCounter( "edges.added.repeat", blocks.graphStat.repeatEdges ) ;
+		stats.AddCounter( "edges.added.clipped", blocks.graphStat.clippedEdges ) ;
+		if ( checkpoint )
+			SaveSnapshot( prefix, STAGE_GRAPH, blocks, NULL ) ;
+		stats.EndStage() ;
 	}
 	
-	scaffold.ScaffoldGenome() ;
+	if ( sweepSupport.size() == 0 )
+	{
+		CleanAndScaffold( blocks, alignments, genome, resumeStage, fpSnapshot, checkpoint, argc, argv, NULL ) ;
+		if ( fpSnapshot != NULL )
+			fclose( fpSnapshot ) ;
+		if ( statsFile != NULL )
+			stats.Output( statsFile, "rascaf" ) ;
+		return 0 ;
+	}
+
+	// Sweep mode: each parameter tuple runs the rest of the pipeline in a forked process,
+	// which shares the gene block graph with the parent through copy-on-write.
+	// The output so far, e.g. the contig list, is copied into the output of each run.
+	char sharedOutFile[1024] ;
+	sprintf( sharedOutFile, "%s.out", prefix ) ;
+	int tupleCnt = sweepSupport.size() ;
+	int runningCnt = 0 ;
+	int concurrentCnt = numOfThreads < tupleCnt ? numOfThreads : tupleCnt ;
+	int failedCnt = 0 ;
+	int status ;
 	
-	// Output the command line
-	fprintf( fpOut, "command line: " ) ;
-	char *fullpath = (char *)malloc( sizeof( char ) * 4096 ) ;
-	for ( i = 0 ; i < argc ; ++i )
+	fflush( fpOut ) ;
+	fflush( stderr ) ;
+	stats.BeginStage( "sweep" ) ;
+	stats.AddCounter( "runs", tupleCnt ) ;
+	for ( i = 0 ; i < tupleCnt ; ++i )
 	{
-		char c = ' ' ;
-		if ( i == argc - 1 )
-			c = '\n' ;
-		if ( i > 0 && !strcmp( argv[i - 1], "-b" ) )
+		if ( runningCnt >= concurrentCnt )
 		{
-			if ( realpath( argv[i], fullpath ) == NULL )
-			{
-				fprintf( stderr, "Failed to resolve the path of file %s.\n", argv[i] ) ;
-				exit( 1 ) ;
-			}
-			fprintf( fpOut, "%s%c", fullpath, c ) ;
+			wait( &status ) ;
+			if ( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+				++failedCnt ;
+			--runningCnt ;
 		}
-		else if ( i > 0 && !strcmp( argv[i - 1], "-f" ) )
+
+		pid_t pid = fork() ;
+		if ( pid < 0 )
 		{
-			if ( realpath( argv[i], fullpath ) == NULL )
+			fprintf( stderr, "Failed to fork the process for the parameter sweep.\n" ) ;
+			exit( 1 ) ;
+		}
+		else if ( pid == 0 )
+		{
+			char buffer[1024] ;
+			char chunk[65536] ;
+			char extra[128] ;
+			minimumSupport = sweepSupport[i] ;
+			kmerSize = sweepKmerSize[i] ;
+			numOfThreads = numOfThreads / concurrentCnt ;
+			if ( numOfThreads < 1 )
+				numOfThreads = 1 ;
+
+			sprintf( buffer, "%s_ms%d_k%d", prefix, minimumSupport, kmerSize ) ;
+			prefix = strdup( buffer ) ;
+			sprintf( buffer, "%s.out", prefix ) ;
+			fclose( fpOut ) ;
+			fpOut = fopen( buffer, "w" ) ;
+			FILE *fpShared = fopen( sharedOutFile, "r" ) ;
+			if ( fpOut == NULL || fpShared == NULL )
 			{
-				fprintf( stderr, "Failed to resolve the path of file %s.\n", argv[i] ) ;
+				fprintf( stderr, "Can not open %s.\n", fpOut == NULL ? buffer : sharedOutFile ) ;
 				exit( 1 ) ;
 			}
-			fprintf( fpOut, "%s%c", fullpath, c ) ;
+			size_t len ;
+			while ( ( len = fread( chunk, 1, sizeof( chunk ), fpShared ) ) > 0 )
+				fwrite( chunk, 1, len, fpOut ) ;
+			fclose( fpShared ) ;
+			fprintf( stderr, "Sweep: -ms %d -k %d into %s.\n", minimumSupport, kmerSize, buffer ) ;
+
+			sprintf( extra, "-ms %d -k %d", minimumSupport, kmerSize ) ;
+			// The run's own stages follow the shared ones, without the sweep stage of the parent.
+			stats.DropStage() ;
+			CleanAndScaffold( blocks, alignments, genome, resumeStage, fpSnapshot, checkpoint, argc, argv, extra ) ;
+			fclose( fpOut ) ;
+			if ( statsFile != NULL )
+			{
+				sprintf( buffer, "%s_ms%d_k%d", statsFile, minimumSupport, kmerSize ) ;
+				stats.Output( buffer, "rascaf" ) ;
+			}
+			exit( 0 ) ;
 		}
-		else
-			fprintf( fpOut, "%s%c", argv[i], c ) ;
+		++runningCnt ;
+	}
+	for ( ; runningCnt > 0 ; --runningCnt )
+	{
+		wait( &status ) ;
+		if ( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+			++failedCnt ;
+	}
+	if ( fpSnapshot != NULL )
+		fclose( fpSnapshot ) ;
+	fclose( fpOut ) ;
+	unlink( sharedOutFile ) ;
+	stats.AddCounter( "failedRuns", failedCnt ) ;
+	if ( statsFile != NULL )
+		stats.Output( statsFile, "rascaf" ) ;
+	if ( failedCnt > 0 )
+	{
+		fprintf( stderr, "%d runs of the parameter sweep failed.\n", failedCnt ) ;
+		exit( 1 ) ;
 	}
-	free( fullpath ) ;
-	scaffold.Output( fpOut, alignments ) ;
 	return 0 ;
 }
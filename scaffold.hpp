@@ -5,17 +5,28 @@
 #define _LSONG_RSCAF_SCAFFOLD_HEADER
 
 #include <vector>
+#include <map>
 #include <algorithm>
 
 #include <inttypes.h>
+#include <time.h>
 
 #include "defs.h"
 #include "blocks.hpp"
 #include "alignments.hpp"
-#include "ContigGraph.hpp"
+#include "OutputWriter.hpp"
 
 extern char *prefix ;
 extern bool outputConnectionSequence ;
+extern int exactComponentSize ;
+extern int exactTimeLimit ;
+extern bool outputComponentTime ;
+
+#define MAX_EXACT_COMPONENT_SIZE 32
+
+#define SOLVER_GREEDY 0
+#define SOLVER_EXACT 1
+#define SOLVER_EXACT_TIMEOUT 2 // the exact solver ran out of time, and greedy is used
 
 struct _scaffold
 {
@@ -26,7 +37,7 @@ struct _scaffold
 struct _blockScaffoldWrapper
 {
 	int support ;
-	std::vector<struct _mateEdge> *s ; // Use point so the swapping when sorting can be efficiently done
+	std::vector<struct _compactMateEdge> *s ; // Use point so the swapping when sorting can be efficiently done
 } ;
 
 struct _misassembledInfo
@@ -40,19 +51,87 @@ struct _misassembledInfo
 // Conceptually, each chromosome has two dummy nodes
 // left node(0) leads to the 3'->5' neighbour(means need flip), right node(1) says the 5'->3' neighbor
 // neighborType tells the information of the neighbor. 
-// each node corresponds to a contig
+// each node corresponds to a contig carrying gene blocks
 struct _scaffoldNode
 {
 	//int contigId ;
 	int neighbor[2] ;  // The id of the neighbor is mapped chr id.
 	int neighborType[2] ;
 
-	struct _mateEdge mateEdges[2] ; // The information of the edges we use
+	const struct _compactMateEdge *mateEdges[2] ; // The edges we use, pointing into the block scaffolds
+} ;
+
+// The edge of the graph for finding the cycles in the scaffolds. 
+// A run of contigs without gene blocks on a chromosome is contracted into one edge.
+struct _cycleEdge
+{
+	int v ;
+	int dummyU, dummyV ;
+	int skipFrom, skipTo ; // the contigs the edge passes, from the u side. skipFrom=-1 if none
+	int next ;
+} ;
+
+struct _cycleFrame
+{
+	int node ;
+	int inDummy ;
+	int p ; // the next edge to try
+	int edge ; // the edge to the frame above
+} ;
+
+// The key to rank the edges of a component, index is into geneBlockEdges
+struct _edgeKey
+{
+	int support ;
+	int u ;
+	int index ;
 } ;
 
-bool CompEdge( struct _mateEdge e1, struct _mateEdge e2 )
+// Sort the keys by decreasing support with a stable LSD radix sort.
+void RadixSortEdgeKeys( std::vector<struct _edgeKey> &keys, std::vector<struct _edgeKey> &buffer )
 {
-	return e1.support[ e1.supportUse ].GetCount() > e2.support[ e2.supportUse ].GetCount() ; 
+	int n = keys.size() ;
+	int i ;
+	if ( n <= 1 )
+		return ;
+
+	int max = 0 ;
+	for ( i = 0 ; i < n ; ++i )
+		if ( keys[i].support > max )
+			max = keys[i].support ;
+
+	buffer.resize( n ) ;
+	struct _edgeKey *from = &keys[0] ;
+	struct _edgeKey *to = &buffer[0] ;
+	int count[256] ;
+	// Sort by max - support ascending, which is support descending.
+	for ( int shift = 0 ; shift < 32 && ( max >> shift ) > 0 ; shift += 8 )
+	{
+		memset( count, 0, sizeof( count ) ) ;
+		for ( i = 0 ; i < n ; ++i )
+			++count[ ( ( max - from[i].support ) >> shift ) & 0xff ] ;
+
+		int sum = 0 ;
+		for ( i = 0 ; i < 256 ; ++i )
+		{
+			int tmp = count[i] ;
+			count[i] = sum ;
+			sum += tmp ;
+		}
+		for ( i = 0 ; i < n ; ++i )
+		{
+			int d = ( ( max - from[i].support ) >> shift ) & 0xff ;
+			to[ count[d] ] = from[i] ;
+			++count[d] ;
+		}
+
+		struct _edgeKey *tmp = from ;
+		from = to ;
+		to = tmp ;
+	}
+
+	if ( from != &keys[0] )
+		memcpy( &keys[0], from, sizeof( struct _edgeKey ) * n ) ;
 }
 
 bool CompScaffold( struct _blockScaffoldWrapper s1, struct _blockScaffoldWrapper s2 )
@@ -60,43 +139,145 @@ bool CompScaffold( struct _blockScaffoldWrapper s1, struct _blockScaffoldWrapper
 	return s1.support > s2.support ;	
 }
 
+// Larger components first, ties by the component id
+bool CompComponentSize( const struct _pair &a, const struct _pair &b )
+{
+	if ( a.a != b.a )
+		return a.a > b.a ;
+	return a.b < b.b ;
+}
+
+// An edge of a component for the exact solver, in local ids.
+// su and sv are the sides of the gene blocks the edge attaches to.
+struct _exactEdge
+{
+	int u, v ;
+	int su, sv ;
+	int support ;
+	int index ; // the index in geneBlockEdges
+} ;
+
+bool CompExactEdge( const struct _exactEdge &a, const struct _exactEdge &b )
+{
+	return a.support > b.support ;
+}
+
+// The state of the branch-and-bound search
+struct _exactSearch
+{
+	std::vector<struct _exactEdge> edges ;
+	std::vector<int64_t> suffixSupport ; // the total support of edges[i...]
+	int nodeCnt ;
+
+	uint64_t sideUsed ; // bit 2*x+s: side s of node x is used
+	int label[ MAX_EXACT_COMPONENT_SIZE ] ; // the nodes connected by the chosen edges share the label
+	std::vector<bool> chosen ;
+	int64_t support ;
+
+	std::vector<bool> bestChosen ;
+	int64_t bestSupport ;
+
+	int64_t visitCnt ;
+	double deadline ;
+	bool timeout ;
+} ;
+
+double GetMonotonicTime()
+{
+	struct timespec t ;
+	clock_gettime( CLOCK_MONOTONIC, &t ) ;
+	return t.tv_sec + t.tv_nsec * 1e-9 ;
+}
+
 class Scaffold
 {
 private:
 	Blocks &blocks ;
 	Genome &genome ;
 
-	std::vector< std::vector<int> > components ;
-	std::vector<bool> blockUsed ;
+	// The members of component i are componentMembers[ componentOffset[i] ... componentOffset[i + 1] - 1 ]
+	std::vector<int> componentOffset ;
+	std::vector<int> componentMembers ;
+	bool *blockUsed ; // not std::vector<bool>, the components are scaffolded concurrently
 
-	void SearchComponent( int tag, bool *visited, std::vector<int> &list )
+	// The union-find over the gene blocks, shared by the threads. A root is always linked 
+	// to a smaller root, so the root of a component is its smallest gene block,
+	// and the father of a node only decreases, which makes the lock-free updates safe.
+	int FindComponentRoot( int *father, int x )
 	{
-		if ( visited[tag] )
-			return ;
-		visited[tag] = true ;
-		list.push_back( tag ) ;
+		while ( 1 )
+		{
+			int p = __atomic_load_n( &father[x], __ATOMIC_RELAXED ) ;
+			if ( p == x )
+				return x ;
+			int gp = __atomic_load_n( &father[p], __ATOMIC_RELAXED ) ;
+			// Path halving
+			if ( p != gp )
+				__sync_bool_compare_and_swap( &father[x], p, gp ) ;
+			x = gp ;
+		}
+	}
 
-		std::vector< struct _mateEdge > &edges = blocks.geneBlockGraph[tag] ;
-		std::vector<struct _mateEdge>::iterator it ;
-		for ( it = edges.begin() ; it != edges.end() ; ++it )
+	void UnionComponent( int *father, int u, int v )
+	{
+		while ( 1 )
 		{
-			if ( !visited[ it->v ] )
-				SearchComponent( it->v, visited, list ) ;
+			u = FindComponentRoot( father, u ) ;
+			v = FindComponentRoot( father, v ) ;
+			if ( u == v )
+				return ;
+			if ( u < v )
+			{
+				int tmp = u ;
+				u = v ;
+				v = tmp ;
+			}
+			if ( __sync_bool_compare_and_swap( &father[u], u, v ) )
+				return ;
 		}
 	}
 
+	struct _unionComponentArg
+	{
+		Scaffold *scaffold ;
+		int *father ;
+	} ;
+
+	static void UnionComponent_Thread( int taskId, int threadId, void *arg )
+	{
+		struct _unionComponentArg *a = (struct _unionComponentArg *)arg ;
+		Blocks &blocks = a->scaffold->blocks ;
+		int end = blocks.geneBlockEdgeOffset[ taskId + 1 ] ;
+		for ( int i = blocks.geneBlockEdgeOffset[ taskId ] ; i < end ; ++i )
+			a->scaffold->UnionComponent( a->father, taskId, blocks.geneBlockEdges[i].v ) ;
+	}
+
 	std::vector< struct _blockScaffoldWrapper > blockScaffolds ; // a-id of the block, b-direction
 	
-	int contigCnt ;
+	std::vector<int> keyContigs ; // the sorted ids of the contigs carrying gene blocks 
 
-	struct _scaffoldNode *scaffoldNodes ;
+	struct _scaffoldNode *scaffoldNodes ; // indexed by the rank in keyContigs
 
-	std::vector< struct _mateEdge > problematicMates ; 
+	std::vector< struct _compactMateEdge > problematicMates ; 
 
-	struct _misassembledInfo *misassembledInfo ; // record which two gene blocks resulting in reporting the misassembly
+	std::map<int, struct _misassembledInfo> misassembledInfo ; // record which two gene blocks resulting in reporting the misassembly, keyed by contig id
 	std::vector< std::vector<int> > misassembledCycles ;
 	std::vector<int> misassembledContigs ;
 
+	// Return the rank of the contig in keyContigs, -1 if it carries no gene block.
+	int GetKeyContigIndex( int contigId )
+	{
+		std::vector<int>::iterator it = std::lower_bound( keyContigs.begin(), keyContigs.end(), contigId ) ;
+		if ( it == keyContigs.end() || *it != contigId )
+			return -1 ;
+		return it - keyContigs.begin() ;
+	}
+
+	bool IsMisassembled( int contigId )
+	{
+		return misassembledInfo.find( contigId ) != misassembledInfo.end() ;
+	}
+
 	int GetFather( int tag, int *father )
 	{
 		if ( father[tag] == tag )
@@ -104,168 +285,452 @@ private:
 		return father[tag] = GetFather( father[tag], father ) ;
 	}
 	
-	// Find a circle 
-	bool FindContigGraphCircle( int startGeneBlock, int currGeneBlock, int timeStamp, int *visitTime, 
-		std::vector<int> *geneBlocksInContig, std::vector<int> *geneBlockScaffoldGraph )
+	// The misassemblies that involve other contigs: two gene blocks of a contig are connected 
+	// through the scaffolds of other contigs. Build the graph whose nodes are the gene blocks 
+	// and the contigs, where a gene block connects to its contig and to its neighbors in the block scaffolds 
+	// from other contigs. Then contig c is misassembled if and only if two of its edges 
+	// are in the same biconnected component, i.e. there is a path between two of its gene blocks avoiding c.
+	// The biconnected components are found by an iterative Tarjan's algorithm in linear time.
+	void FindMisassembliesAcrossContigs()
 	{
-		int j ;
-		visitTime[currGeneBlock] = timeStamp ;
-		int currContigId = blocks.geneBlocks[ currGeneBlock ].contigId ;
-		int cnt = geneBlockScaffoldGraph[currGeneBlock].size() ;
+		int i ;
+		int geneBlockCnt = blocks.GetGeneBlockCount() ;
+		int keyCnt = keyContigs.size() ;
+		int nodeCnt = geneBlockCnt + keyCnt ;
+		int bscafCnt = blockScaffolds.size() ;
 
-		for ( j = 0 ; j < cnt ; ++j )
+		std::vector<int> edgeU, edgeV ;
+		for ( i = 0 ; i < geneBlockCnt ; ++i )
 		{
-			if ( visitTime[ geneBlockScaffoldGraph[ currGeneBlock ][j] ] == timeStamp )
-				continue ;
-
-			if ( currContigId != blocks.geneBlocks[ startGeneBlock ].contigId && 
-				geneBlockScaffoldGraph[ currGeneBlock ][j] != startGeneBlock &&
-				blocks.geneBlocks[ geneBlockScaffoldGraph[ currGeneBlock ][j] ].contigId == blocks.geneBlocks[ startGeneBlock ].contigId )
+			edgeU.push_back( i ) ;
+			edgeV.push_back( geneBlockCnt + GetKeyContigIndex( blocks.GetGeneBlockContigId( i ) ) ) ;
+		}
+		for ( i = 0 ; i < bscafCnt ; ++i )
+		{
+			int cnt = blockScaffolds[i].s->size() ;
+			std::vector<struct _compactMateEdge> &s = *( blockScaffolds[i].s ) ;
+			for ( int j = 0 ; j < cnt ; ++j )
 			{
-				misassembledInfo[ blocks.geneBlocks[ startGeneBlock ].contigId ].u = startGeneBlock ;
-				misassembledInfo[ blocks.geneBlocks[ startGeneBlock ].contigId ].v = geneBlockScaffoldGraph[ currGeneBlock ][j] ;
-				misassembledInfo[ blocks.geneBlocks[ startGeneBlock ].contigId ].type = 0 ;
-				return true ;
+				// Since the gene block scaffold are disjoint paths,
+				// there is no need to worry about repeat edges
+				if ( blocks.GetGeneBlockContigId( s[j].u ) == blocks.GetGeneBlockContigId( s[j].v ) )
+					continue ;
+				edgeU.push_back( s[j].u ) ;
+				edgeV.push_back( s[j].v ) ;
 			}
-			if ( FindContigGraphCircle( startGeneBlock, geneBlockScaffoldGraph[ currGeneBlock ][j], timeStamp, visitTime, 
-					geneBlocksInContig, geneBlockScaffoldGraph ) )
-				return true ;
 		}
 
-		if ( currContigId != blocks.geneBlocks[ startGeneBlock ].contigId )
+		// The adjacency list in CSR form, storing the edge ids.
+		int edgeCnt = edgeU.size() ;
+		int *offset = new int[ nodeCnt + 1 ] ;
+		int *adj = new int[ 2 * edgeCnt ] ;
+		memset( offset, 0, sizeof( int ) * ( nodeCnt + 1 ) ) ;
+		for ( i = 0 ; i < edgeCnt ; ++i )
 		{
-			cnt = geneBlocksInContig[ currContigId ].size() ;
-			for ( j = 0 ; j < cnt ; ++j )
+			++offset[ edgeU[i] + 1 ] ;
+			++offset[ edgeV[i] + 1 ] ;
+		}
+		for ( i = 0 ; i < nodeCnt ; ++i )
+			offset[i + 1] += offset[i] ;
+		int *pos = new int[ nodeCnt ] ;
+		memcpy( pos, offset, sizeof( int ) * nodeCnt ) ;
+		for ( i = 0 ; i < edgeCnt ; ++i )
+		{
+			adj[ pos[ edgeU[i] ]++ ] = i ;
+			adj[ pos[ edgeV[i] ]++ ] = i ;
+		}
+
+		int *disc = new int[ nodeCnt ] ;
+		int *low = new int[ nodeCnt ] ;
+		int *parentEdge = new int[ nodeCnt ] ;
+		int *stamp = new int[ keyCnt ] ; // the last biconnected component touching the contig
+		int *firstBlock = new int[ keyCnt ] ;
+		memset( disc, -1, sizeof( int ) * nodeCnt ) ;
+		memset( stamp, -1, sizeof( int ) * keyCnt ) ;
+		std::vector<int> nodeStack ;
+		std::vector<int> edgeStack ;
+		int time = 0 ;
+		int componentId = 0 ;
+
+		for ( int root = 0 ; root < nodeCnt ; ++root )
+		{
+			if ( disc[root] != -1 )
+				continue ;
+			disc[root] = low[root] = time++ ;
+			parentEdge[root] = -1 ;
+			pos[root] = offset[root] ;
+			nodeStack.push_back( root ) ;
+
+			while ( !nodeStack.empty() )
 			{
-				int tag = geneBlocksInContig[ currContigId ][j] ;
-				if ( tag == currGeneBlock )
+				int x = nodeStack.back() ;
+				if ( pos[x] < offset[x + 1] )
+				{
+					int e = adj[ pos[x] ] ;
+					++pos[x] ;
+					if ( e == parentEdge[x] )
+						continue ;
+					int y = ( edgeU[e] == x ) ? edgeV[e] : edgeU[e] ;
+					if ( disc[y] == -1 )
+					{
+						edgeStack.push_back( e ) ;
+						disc[y] = low[y] = time++ ;
+						parentEdge[y] = e ;
+						pos[y] = offset[y] ;
+						nodeStack.push_back( y ) ;
+					}
+					else if ( disc[y] < disc[x] ) // back edge
+					{
+						edgeStack.push_back( e ) ;
+						if ( disc[y] < low[x] )
+							low[x] = disc[y] ;
+					}
 					continue ;
+				}
 
-				if ( visitTime[tag] == timeStamp )
+				nodeStack.pop_back() ;
+				if ( parentEdge[x] == -1 )
+					continue ;
+				int p = ( edgeU[ parentEdge[x] ] == x ) ? edgeV[ parentEdge[x] ] : edgeU[ parentEdge[x] ] ;
+				if ( low[x] < low[p] )
+					low[p] = low[x] ;
+				if ( low[x] < disc[p] )
 					continue ;
 
-				if ( FindContigGraphCircle( startGeneBlock, tag, timeStamp, visitTime, 
-							geneBlocksInContig, geneBlockScaffoldGraph ) )
-					return true ;
+				// p separates the subtree of x, pop the biconnected component.
+				int e ;
+				do
+				{
+					e = edgeStack.back() ;
+					edgeStack.pop_back() ;
+					// Only the edges between a gene block and its contig touch contig nodes.
+					if ( edgeV[e] < geneBlockCnt )
+						continue ;
+					int c = edgeV[e] - geneBlockCnt ;
+					if ( stamp[c] != componentId )
+					{
+						stamp[c] = componentId ;
+						firstBlock[c] = edgeU[e] ;
+					}
+					else if ( !IsMisassembled( keyContigs[c] ) )
+					{
+						struct _misassembledInfo &info = misassembledInfo[ keyContigs[c] ] ;
+						info.u = firstBlock[c] ;
+						info.v = edgeU[e] ;
+						info.type = 0 ;
+					}
+				} while ( e != parentEdge[x] ) ;
+				++componentId ;
 			}
 		}
-		return false ;
+
+		delete[] offset ;
+		delete[] adj ;
+		delete[] pos ;
+		delete[] disc ;
+		delete[] low ;
+		delete[] parentEdge ;
+		delete[] stamp ;
+		delete[] firstBlock ;
 	}
 
 	void FindMisassemblies()
 	{
-		std::vector<int> *geneBlockScaffoldGraph = new std::vector<int>[ blocks.geneBlocks.size() ] ; // This graph is undirected
-									// the index are for the gene block 
-		std::vector<int> *geneBlocksInContig = new std::vector<int>[ contigCnt ] ; // The other gene blocks in the same contig
-
 		int bscafCnt = blockScaffolds.size() ;
-		int *visitTime = new int[ blocks.geneBlocks.size() ] ; 
-		misassembledInfo = new struct _misassembledInfo[ contigCnt ] ;	
-		int i, j, k ;
-		int edgeCnt = 0 ;
+		int i, j ;
 
-		memset( misassembledInfo, -1, sizeof( *misassembledInfo ) * contigCnt ) ;
-		memset( visitTime, -1, sizeof( int ) * blocks.geneBlocks.size() ) ;
+		misassembledInfo.clear() ;
 		
 		// First, try to find the misassemblies that involves other contigs
-		for ( i = 0 ; i < bscafCnt ; ++i )
-		{
-			int cnt = blockScaffolds[i].s->size() ;
-			std::vector<struct _mateEdge> &s = *( blockScaffolds[i].s ) ;
-			edgeCnt += cnt ;
-
-			for ( j = 0 ; j < cnt ; ++j )
-			{
-				// Since the gene block scaffold are disjoint paths,
-				// there is no need to worry about repeat edges
-				geneBlockScaffoldGraph[ s[j].u ].push_back( s[j].v ) ;
-				geneBlockScaffoldGraph[ s[j].v ].push_back( s[j].u ) ;
-			}
-		}
-
-		k = blocks.geneBlocks.size() ;
-		for ( i = 0 ; i < k ; ++i )
-			geneBlocksInContig[ blocks.geneBlocks[i].contigId ].push_back( i ) ;
-
-
-		for ( i = 0 ; i < k ; ++i )
-		{
-			FindContigGraphCircle( i, i, i, visitTime, geneBlocksInContig, geneBlockScaffoldGraph ) ;
-			/*{
-				//printf( "Misassembly from gene block: %lld-%lld", blocks.geneBlocks[i].start, blocks.geneBlocks[i].end ) ;
-				//isMisassembled[ blocks.geneBlocks[i].contigId ] = true ;
-			}*/
-		}
+		FindMisassembliesAcrossContigs() ;
 
 		// Then, find the misassemblies that can directly determined by the geneblocks within the contig
 		for ( i = 0 ; i < bscafCnt ; ++i )	
 		{
 			int cnt = blockScaffolds[i].s->size() ;
-			std::vector<struct _mateEdge> &s = *( blockScaffolds[i].s ) ;
+			std::vector<struct _compactMateEdge> &s = *( blockScaffolds[i].s ) ;
 
 			for ( j = 1 ; j < cnt ; ++j )
 			{
-				if ( blocks.geneBlocks[ s[j].u ].contigId != blocks.geneBlocks[ s[j].v ].contigId )
+				if ( blocks.GetGeneBlockContigId( s[j].u ) != blocks.GetGeneBlockContigId( s[j].v ) )
 					continue ;
 				// Test the direction
 				if ( s[j].supportUse == 0 )
 				{
-					misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].u = s[j].u ;
-					misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].v = s[j].v ;
+					misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].u = s[j].u ;
+					misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].v = s[j].v ;
 
-					if ( blocks.geneBlocks[ s[j].u ].start <= blocks.geneBlocks[ s[j].v ].start )
-						misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].type = 2 ;
+					if ( blocks.GetGeneBlockStart( s[j].u ) <= blocks.GetGeneBlockStart( s[j].v ) )
+						misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].type = 2 ;
 					else
-						misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].type = 1 ;
+						misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].type = 1 ;
 						
 				}
 				else if ( s[j].supportUse == 3 )
 				{
-					misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].u = s[j].u ;
-					misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].v = s[j].v ;
+					misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].u = s[j].u ;
+					misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].v = s[j].v ;
 
-					if ( blocks.geneBlocks[ s[j].u ].start <= blocks.geneBlocks[ s[j].v ].start )
-						misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].type = 2 ;
+					if ( blocks.GetGeneBlockStart( s[j].u ) <= blocks.GetGeneBlockStart( s[j].v ) )
+						misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].type = 2 ;
 					else
-						misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].type = 1 ;
+						misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].type = 1 ;
 						
 				}
 				else if ( s[j].supportUse == 1 )
 				{
 					// from left to right
-					if ( blocks.geneBlocks[ s[j].u ].start > blocks.geneBlocks[ s[j].v ].start )
+					if ( blocks.GetGeneBlockStart( s[j].u ) > blocks.GetGeneBlockStart( s[j].v ) )
 					{
-						misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].u = s[j].u ;
-						misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].v = s[j].v ;
-						misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].type = 3 ;
+						misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].u = s[j].u ;
+						misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].v = s[j].v ;
+						misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].type = 3 ;
 					}
 				}
 				else // supportUsed == 2
 				{
 					// from right to left
-					if ( blocks.geneBlocks[ s[j].u ].start < blocks.geneBlocks[ s[j].v ].start )
+					if ( blocks.GetGeneBlockStart( s[j].u ) < blocks.GetGeneBlockStart( s[j].v ) )
+					{
+						misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].u = s[j].u ;
+						misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].v = s[j].v ;
+						misassembledInfo[ blocks.GetGeneBlockContigId( s[j].u ) ].type = 3 ;
+					}
+				}
+			}
+		}
+
+	}
+
+	void AddCycleEdge( std::vector<struct _cycleEdge> &edges, int *head, int u, int dummyU, int v, int dummyV, 
+		int skipFrom, int skipTo )
+	{
+		struct _cycleEdge e ;
+		e.v = v ;
+		e.dummyU = dummyU ;
+		e.dummyV = dummyV ;
+		e.skipFrom = skipFrom ;
+		e.skipTo = skipTo ;
+		e.next = head[u] ;
+		head[u] = edges.size() ;
+		edges.push_back( e ) ;
+
+		e.v = u ;
+		e.dummyU = dummyV ;
+		e.dummyV = dummyU ;
+		e.skipFrom = skipTo ;
+		e.skipTo = skipFrom ;
+		e.next = head[v] ;
+		head[v] = edges.size() ;
+		edges.push_back( e ) ;
+	}
+
+	int GetSkipCount( const struct _cycleEdge &e )
+	{
+		if ( e.skipFrom == -1 )
+			return 0 ;
+		return ( e.skipFrom <= e.skipTo ? e.skipTo - e.skipFrom : e.skipFrom - e.skipTo ) + 1 ;
+	}
+
+	// Add the first cnt contigs passed by the edge to cycleNodes, the farthest one first.
+	void PushSkippedContigs( const struct _cycleEdge &e, int cnt, std::vector<int> &cycleNodes )
+	{
+		int step = ( e.skipFrom <= e.skipTo ) ? 1 : -1 ;
+		for ( int k = cnt - 1 ; k >= 0 ; --k )
+			cycleNodes.push_back( e.skipFrom + k * step ) ;
+	}
+
+	// The iterative form of the depth-first search in ContigGraph::SearchCycle, visiting the edges in the same order.
+	// It succeeds when coming back to the start node, or when taking the edge target if it is not -1,
+	// in which case only the first targetSkip contigs passed by target are on the cycle.
+	// cycleNodes gets the contigs on the path in reverse order.
+	bool SearchScaffoldCycle( std::vector<struct _cycleEdge> &edges, int *head, int node, int inDummy, 
+		int target, int targetSkip, int time, int *visitTime, std::vector<int> &cycleNodes )
+	{
+		std::vector<struct _cycleFrame> stack ;
+		struct _cycleFrame frame ;
+		frame.node = node ;
+		frame.inDummy = inDummy ;
+		frame.p = head[node] ;
+		frame.edge = -1 ;
+		stack.push_back( frame ) ;
+		visitTime[node] = time ;
+
+		while ( !stack.empty() )
+		{
+			struct _cycleFrame &f = stack.back() ;
+			if ( f.p == -1 )
+			{
+				stack.pop_back() ;
+				continue ;
+			}
+			int e = f.p ;
+			f.p = edges[e].next ;
+			if ( edges[e].dummyU == f.inDummy )
+				continue ;
+
+			if ( ( target == -1 && edges[e].v == stack[0].node ) || e == target )
+			{
+				PushSkippedContigs( edges[e], target == -1 ? GetSkipCount( edges[e] ) : targetSkip, cycleNodes ) ;
+				cycleNodes.push_back( keyContigs[ f.node ] ) ;
+				for ( int k = (int)stack.size() - 2 ; k >= 0 ; --k )
+				{
+					PushSkippedContigs( edges[ stack[k].edge ], GetSkipCount( edges[ stack[k].edge ] ), cycleNodes ) ;
+					cycleNodes.push_back( keyContigs[ stack[k].node ] ) ;
+				}
+				return true ;
+			}
+
+			int v = edges[e].v ;
+			if ( visitTime[v] == time )
+				continue ;
+			visitTime[v] = time ;
+			f.edge = e ;
+			frame.node = v ;
+			frame.inDummy = edges[e].dummyV ;
+			frame.p = head[v] ;
+			frame.edge = -1 ;
+			stack.push_back( frame ) ;
+		}
+		return false ;
+	}
+
+	// Mark the contigs on the cycle as misassembled and cut them out of the scaffolds.
+	void RemoveScaffoldCycle( std::vector<int> &cycleNodes )
+	{
+		int ccnt = cycleNodes.size() ;
+		for ( int j = 0 ; j < ccnt ; ++j )
+		{
+			if ( IsMisassembled( cycleNodes[j] ) )
+				continue ;
+			struct _misassembledInfo &info = misassembledInfo[ cycleNodes[j] ] ;
+			info.u = cycleNodes[j] ;
+			info.v = misassembledCycles.size() ;
+			info.type = 4 ;
+
+			int k = GetKeyContigIndex( cycleNodes[j] ) ;
+			if ( k == -1 )
+				continue ;
+			// Remove the effects on the nieghbors
+			int v, dummyV ;
+			for ( int l = 0 ; l < 2 ; ++l )
+			{
+				v = scaffoldNodes[k].neighbor[l] ;
+				if ( v != -1 )
+				{
+					dummyV = scaffoldNodes[k].neighborType[l] ;
+					struct _scaffoldNode &node = scaffoldNodes[ GetKeyContigIndex( v ) ] ;
+					node.neighbor[ dummyV ] = -1 ;
+					node.neighborType[ dummyV ] = -1 ;
+				}
+			}
+			scaffoldNodes[k].neighbor[0] = scaffoldNodes[k].neighbor[1] = -1 ;
+			scaffoldNodes[k].neighborType[0] = scaffoldNodes[k].neighborType[1] = -1 ;
+		}
+		misassembledCycles.push_back( cycleNodes ) ;
+	}
+
+	// The contigs are connected by the scaffold edges and by the adjacency on the chromosome,
+	// a cycle in this graph means a misassembly in the scaffolds. The nodes are the contigs carrying gene blocks,
+	// and a run of other contigs between two of them is contracted into one edge, 
+	// which gives the same search as on the graph of all the contigs.
+	void FindScaffoldCycles()
+	{
+		int i, d ;
+		int keyCnt = keyContigs.size() ;
+		std::vector<struct _cycleEdge> edges ;
+		int *head = new int[ keyCnt ] ;
+		int *chainEdge = new int[ keyCnt ] ; // the edge to the next key contig along the chromosome, -1 if none
+		memset( head, -1, sizeof( int ) * keyCnt ) ;
+		memset( chainEdge, -1, sizeof( int ) * keyCnt ) ;
+
+		// Build graph
+		for ( i = 0 ; i < keyCnt - 1 ; ++i )
+		{
+			int a = keyContigs[i] ;
+			int b = keyContigs[i + 1] ;
+			int c ;
+			for ( c = a ; c < b ; ++c )
+				if ( genome.GetChrIdFromContigId( c ) != genome.GetChrIdFromContigId( c + 1 ) )
+					break ;
+			if ( c < b )
+				continue ;
+			chainEdge[i] = edges.size() ;
+			if ( b - a > 1 )
+				AddCycleEdge( edges, head, i, 1, i + 1, 0, a + 1, b - 1 ) ;
+			else
+				AddCycleEdge( edges, head, i, 1, i + 1, 0, -1, -1 ) ;
+		}
+
+		for ( i = 0 ; i < keyCnt ; ++i )	
+		{
+			for ( d = 0 ; d < 2 ; ++d )
+				if ( scaffoldNodes[i].neighbor[d] != -1 )
+					AddCycleEdge( edges, head, i, d, GetKeyContigIndex( scaffoldNodes[i].neighbor[d] ), 
+						scaffoldNodes[i].neighborType[d], -1, -1 ) ;
+		}
+
+		// Record cycles
+		int *visitTime = new int[ keyCnt ] ;
+		memset( visitTime, -1, sizeof( int ) * keyCnt ) ;
+		int time = 0 ;
+		std::vector<int> cycleNodes ;
+		for ( i = 0 ; i < keyCnt ; ++i )	
+		{
+			if ( !IsMisassembled( keyContigs[i] ) )
+			{
+				for ( d = 0 ; d < 2 ; ++d )
+				{
+					cycleNodes.clear() ;
+					if ( SearchScaffoldCycle( edges, head, i, d, -1, 0, time++, visitTime, cycleNodes ) )
 					{
-						misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].u = s[j].u ;
-						misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].v = s[j].v ;
-						misassembledInfo[ blocks.geneBlocks[ s[j].u ].contigId ].type = 3 ;
+						RemoveScaffoldCycle( cycleNodes ) ;
+						break ;
 					}
 				}
 			}
+
+			// The contigs passed by the edge to the next key contig. A cycle through one of them goes through 
+			// all of them, and their searches succeed or fail together, so only the first one is searched.
+			if ( chainEdge[i] == -1 || edges[ chainEdge[i] ].skipFrom == -1 )
+				continue ;
+			int a = keyContigs[i] ;
+			int b = keyContigs[i + 1] ;
+			if ( IsMisassembled( a + 1 ) )
+				continue ;
+			
+			// Leave a+1 to the right and come back from contig a.
+			cycleNodes.clear() ;
+			if ( SearchScaffoldCycle( edges, head, i + 1, 0, chainEdge[i], 0, time++, visitTime, cycleNodes ) )
+			{
+				for ( int c = b - 1 ; c > a ; --c )
+					cycleNodes.push_back( c ) ;
+				RemoveScaffoldCycle( cycleNodes ) ;
+				continue ;
+			}
+			// Leave a+1 to the left and come back from contig b.
+			cycleNodes.clear() ;
+			if ( SearchScaffoldCycle( edges, head, i, 1, chainEdge[i] + 1, b - a - 2, time++, visitTime, cycleNodes ) )
+			{
+				cycleNodes.push_back( a + 1 ) ;
+				RemoveScaffoldCycle( cycleNodes ) ;
+			}
 		}
 
+		delete[] head ;
+		delete[] chainEdge ;
 		delete[] visitTime ;
-		delete[] geneBlockScaffoldGraph ;
-		delete[] geneBlocksInContig ;
 	}
 
 public:
 	Scaffold( Blocks &in, Genome &inGenome ):blocks(in), genome( inGenome )
 	{ 
-		for ( std::vector< struct _geneBlock >::iterator it = blocks.geneBlocks.begin() ; it != blocks.geneBlocks.end() ; ++it )
+		int cnt = blocks.GetGeneBlockCount() ;
+		blockUsed = new bool[cnt] ;
+		for ( int i = 0 ; i < cnt ; ++i )
 		{
-			blockUsed.push_back( false ) ;
+			blockUsed[i] = false ;
 		}
-		misassembledInfo = NULL ;
 		scaffoldNodes = NULL ;
 	} 
 	//Scaffold( ) {} 
@@ -275,96 +740,346 @@ public:
 		int cnt = blockScaffolds.size() ;
 		for ( i = 0 ; i < cnt ; ++i )
 			delete blockScaffolds[i].s ;
-
-		if ( misassembledInfo != NULL )
-			delete[] misassembledInfo ;
+		delete[] blockUsed ;
 
 		if ( scaffoldNodes != NULL )
 			delete[] scaffoldNodes ;
 	}
 	
+	// The components are ordered by their smallest gene block, and the members are sorted.
 	int BuildComponent()	
 	{
-		int i, j ;	
-		int geneBlockCnt = blocks.geneBlocks.size() ;
-		bool *visited = new bool[geneBlockCnt] ;
+		int i ;	
+		int geneBlockCnt = blocks.GetGeneBlockCount() ;
+		int *father = new int[ geneBlockCnt ] ;
 
 		for ( i = 0 ; i < geneBlockCnt ; ++i )
-			visited[i] = false ;
+			father[i] = i ;
 
+		int64_t *cost = new int64_t[ geneBlockCnt ] ;
+		for ( i = 0 ; i < geneBlockCnt ; ++i )
+			cost[i] = blocks.geneBlockEdgeOffset[i + 1] - blocks.geneBlockEdgeOffset[i] + 1 ;
+		struct _unionComponentArg arg ;
+		arg.scaffold = this ;
+		arg.father = father ;
+		ThreadPool pool( numOfThreads ) ;
+		pool.Run( geneBlockCnt, cost, UnionComponent_Thread, &arg ) ;
+		delete[] cost ;
+
+		// Bucket the gene blocks by their roots with counting sort.
+		// count[r] is the size of the component rooted at r, 
+		// then reused as the position to put the next member. 
+		int *count = new int[ geneBlockCnt ] ;
+		memset( count, 0, sizeof( int ) * geneBlockCnt ) ;
 		for ( i = 0 ; i < geneBlockCnt ; ++i )
 		{
-			if ( visited[i] )
+			father[i] = FindComponentRoot( father, i ) ;
+			++count[ father[i] ] ;
+		}
+
+		componentOffset.clear() ;
+		int sum = 0 ;
+		for ( i = 0 ; i < geneBlockCnt ; ++i )
+		{
+			if ( count[i] <= 1 ) // singletons and non-roots
+			{
+				count[i] = -1 ;
 				continue ;
-			std::vector<int> newComponent ;
+			}
+			componentOffset.push_back( sum ) ;
+			int tmp = count[i] ;
+			count[i] = sum ;
+			sum += tmp ;
+		}
+		componentOffset.push_back( sum ) ;
+
+		componentMembers.resize( sum ) ;
+		for ( i = 0 ; i < geneBlockCnt ; ++i )
+		{
+			int r = father[i] ;
+			if ( count[r] == -1 )
+				continue ;
+			componentMembers[ count[r] ] = i ;
+			++count[r] ;
+		}
+
+		delete[] count ;
+		delete[] father ;
 
-			SearchComponent( i, visited, newComponent ) ;
-			if ( newComponent.size() <= 1 )
+		return GetComponentCount() ;
+	}
+
+	int GetComponentCount()
+	{
+		return componentOffset.size() - 1 ;
+	}
+
+	int GetComponentSize( int componentId )
+	{
+		return componentOffset[ componentId + 1 ] - componentOffset[ componentId ] ;
+	}
+
+	void SaveSnapshot( FILE *fp )
+	{
+		SnapshotWriteVector( fp, componentOffset ) ;
+		SnapshotWriteVector( fp, componentMembers ) ;
+	}
+
+	// Return the number of components loaded.
+	int LoadSnapshot( FILE *fp )
+	{
+		SnapshotReadVector( fp, componentOffset ) ;
+		SnapshotReadVector( fp, componentMembers ) ;
+		if ( componentOffset.size() == 0 || componentOffset.back() != (int)componentMembers.size() )
+		{
+			fprintf( stderr, "The snapshot is corrupted.\n" ) ;
+			exit( 1 ) ;
+		}
+		return GetComponentCount() ;
+	}
+
+	// Choose the edges in the order of decreasing support. Each side of a gene block takes at most one edge, 
+	// and the chosen edges should not form a cycle, so they are vertex-disjoint oriented paths.
+	void SearchExact( struct _exactSearch &st, int i )
+	{
+		if ( st.timeout )
+			return ;
+		++st.visitCnt ;
+		if ( ( st.visitCnt & 1023 ) == 0 && GetMonotonicTime() > st.deadline )
+		{
+			st.timeout = true ;
+			return ;
+		}
+		if ( st.support > st.bestSupport )
+		{
+			st.bestSupport = st.support ;
+			st.bestChosen = st.chosen ;
+		}
+		int edgeCnt = st.edges.size() ;
+		if ( i >= edgeCnt || st.support + st.suffixSupport[i] <= st.bestSupport )
+			return ;
+
+		struct _exactEdge &e = st.edges[i] ;
+		uint64_t bits = ( 1ull << ( 2 * e.u + e.su ) ) | ( 1ull << ( 2 * e.v + e.sv ) ) ;
+		if ( ( st.sideUsed & bits ) == 0 && st.label[ e.u ] != st.label[ e.v ] )
+		{
+			int j ;
+			int from = st.label[ e.v ] ;
+			int to = st.label[ e.u ] ;
+			uint32_t relabeled = 0 ;
+			for ( j = 0 ; j < st.nodeCnt ; ++j )
+				if ( st.label[j] == from )
+				{
+					st.label[j] = to ;
+					relabeled |= ( 1u << j ) ;
+				}
+			st.sideUsed |= bits ;
+			st.support += e.support ;
+			st.chosen[i] = true ;
+
+			SearchExact( st, i + 1 ) ;
+
+			st.chosen[i] = false ;
+			st.support -= e.support ;
+			st.sideUsed &= ~bits ;
+			for ( j = 0 ; j < st.nodeCnt ; ++j )
+				if ( relabeled & ( 1u << j ) )
+					st.label[j] = from ;
+		}
+		SearchExact( st, i + 1 ) ;
+	}
+
+	// Find the maximum-support set of vertex-disjoint oriented paths in a small component.
+	// Return false if it runs out of the time budget, and nothing is changed then.
+	bool ScaffoldComponentExact( int componentId, std::vector< struct _blockScaffoldWrapper > &blockScaffolds )
+	{
+		int *component = &componentMembers[ componentOffset[ componentId ] ] ;
+		int nodeCnt = GetComponentSize( componentId ) ;
+		int i, j, k ;
+		struct _exactSearch st ;
+
+		// The members are sorted, so the local id is found by binary search.
+		// edgeAt[x * nodeCnt + y] is the index of the directed edge x->y in geneBlockEdges.
+		std::vector<int> edgeAt( nodeCnt * nodeCnt, -1 ) ;
+		for ( i = 0 ; i < nodeCnt ; ++i )
+		{
+			int end = blocks.geneBlockEdgeOffset[ component[i] + 1 ] ;
+			for ( j = blocks.geneBlockEdgeOffset[ component[i] ] ; j < end ; ++j )
+			{
+				k = std::lower_bound( component, component + nodeCnt, blocks.geneBlockEdges[j].v ) - component ;
+				edgeAt[ i * nodeCnt + k ] = j ;
+			}
+		}
+
+		// The supports of the two directions differ, since each mate adds to its own side.
+		// As the keys of the greedy solver, a pair is weighted by its stronger direction,
+		// and that directed edge is the one output.
+		for ( i = 0 ; i < nodeCnt ; ++i )
+			for ( k = i + 1 ; k < nodeCnt ; ++k )
+			{
+				int forward = edgeAt[ i * nodeCnt + k ] ;
+				int reverse = edgeAt[ k * nodeCnt + i ] ;
+				if ( forward == -1 && reverse == -1 )
+					continue ;
+				j = forward ;
+				if ( forward == -1 || ( reverse != -1 && blocks.geneBlockEdges[ reverse ].support > blocks.geneBlockEdges[ forward ].support ) )
+					j = reverse ;
+
+				struct _compactMateEdge &edge = blocks.geneBlockEdges[j] ;
+				struct _exactEdge e ;
+				e.u = ( j == forward ) ? i : k ;
+				e.v = ( j == forward ) ? k : i ;
+				e.su = edge.supportUse >> 1 ;
+				e.sv = edge.supportUse & 1 ;
+				e.support = edge.support ;
+				e.index = j ;
+				st.edges.push_back( e ) ;
+			}
+		std::stable_sort( st.edges.begin(), st.edges.end(), CompExactEdge ) ;
+
+		int edgeCnt = st.edges.size() ;
+		st.suffixSupport.resize( edgeCnt + 1 ) ;
+		st.suffixSupport[ edgeCnt ] = 0 ;
+		for ( i = edgeCnt - 1 ; i >= 0 ; --i )
+			st.suffixSupport[i] = st.suffixSupport[i + 1] + st.edges[i].support ;
+		st.nodeCnt = nodeCnt ;
+		st.sideUsed = 0 ;
+		for ( i = 0 ; i < nodeCnt ; ++i )
+			st.label[i] = i ;
+		st.chosen.assign( edgeCnt, false ) ;
+		st.support = 0 ;
+		st.bestSupport = -1 ;
+		st.visitCnt = 0 ;
+		st.deadline = GetMonotonicTime() + exactTimeLimit / 1000.0 ;
+		st.timeout = false ;
+
+		SearchExact( st, 0 ) ;
+		if ( st.timeout )
+			return false ;
+
+		// Walk the paths. next[2*x+s] is the chosen edge on side s of node x.
+		std::vector<int> next( 2 * nodeCnt, -1 ) ;
+		for ( i = 0 ; i < edgeCnt ; ++i )
+		{
+			if ( !st.bestChosen[i] )
 				continue ;
-			components.push_back( newComponent ) ;
+			next[ 2 * st.edges[i].u + st.edges[i].su ] = i ;
+			next[ 2 * st.edges[i].v + st.edges[i].sv ] = i ;
 		}
-		delete[] visited ;
+		for ( i = 0 ; i < nodeCnt ; ++i )
+		{
+			// Start from one end of a path.
+			if ( blockUsed[ component[i] ] || ( next[2 * i] == -1 ) == ( next[2 * i + 1] == -1 ) )
+				continue ;
 
-		return components.size() ;
+			struct _blockScaffoldWrapper scaffoldW ;
+			scaffoldW.s = new std::vector< struct _compactMateEdge > ;
+			scaffoldW.support = 100000000 ;
+			int x = i ;
+			int side = ( next[2 * i] == -1 ) ? 1 : 0 ;
+			blockUsed[ component[x] ] = true ;
+			while ( next[ 2 * x + side ] != -1 )
+			{
+				struct _exactEdge &e = st.edges[ next[ 2 * x + side ] ] ;
+				int y = ( e.u == x ) ? e.v : e.u ;
+				int ySide = ( e.u == x ) ? e.sv : e.su ;
+
+				scaffoldW.s->push_back( blocks.geneBlockEdges[ e.index ] ) ;
+				if ( e.support < scaffoldW.support )
+					scaffoldW.support = e.support ;
+
+				blockUsed[ component[y] ] = true ;
+				x = y ;
+				side = 1 - ySide ;
+			}
+			blockScaffolds.push_back( scaffoldW ) ;
+		}
+		return true ;
 	}
 
 	// scaffold one component of gene block graph.
-	void ScaffoldComponent( int componentId )
+	// Small components use the exact solver if it finishes in time, the others use the greedy one.
+	// Return the solver used.
+	int ScaffoldComponent( int componentId, std::vector< struct _blockScaffoldWrapper > &blockScaffolds )
+	{
+		if ( GetComponentSize( componentId ) <= exactComponentSize )
+		{
+			if ( ScaffoldComponentExact( componentId, blockScaffolds ) )
+				return SOLVER_EXACT ;
+			ScaffoldComponentGreedy( componentId, blockScaffolds ) ;
+			return SOLVER_EXACT_TIMEOUT ;
+		}
+		ScaffoldComponentGreedy( componentId, blockScaffolds ) ;
+		return SOLVER_GREEDY ;
+	}
+
+	// A greedy heuristic method that anchors at the edge with the highest support and extends it.
+	// The components are disjoint, so only the blockUsed of its own gene blocks are touched,
+	// and the scaffolds are appended to blockScaffolds of the component.
+	void ScaffoldComponentGreedy( int componentId, std::vector< struct _blockScaffoldWrapper > &blockScaffolds )
 	{
-		std::vector<int> &component = components[ componentId ] ;
+		int *component = &componentMembers[ componentOffset[ componentId ] ] ;
 
-		int nodeCnt = component.size() ;
+		int nodeCnt = GetComponentSize( componentId ) ;
 		int edgeCnt ;
 		int i, j, k ;
 		//printf( "%s %d\n", __func__, nodeCnt ) ;
-		// A greedy heuristic method
-		// TODO: enumeration method for simple component
-		std::vector< struct _mateEdge > edges ;
+		// Rank the edges by keys, the edges themselves stay in the graph.
+		std::vector< struct _edgeKey > keys ;
+		std::vector< struct _edgeKey > buffer ;
 
 		for ( i = 0 ; i < nodeCnt ; ++i )
 		{
-			int cnt = blocks.geneBlockGraph[ component[i] ].size() ;
-			for ( j = 0 ; j < cnt ; ++j )
+			int end = blocks.geneBlockEdgeOffset[ component[i] + 1 ] ;
+			for ( j = blocks.geneBlockEdgeOffset[ component[i] ] ; j < end ; ++j )
 			{
-				edges.push_back( blocks.geneBlockGraph[ component[i] ][j] ) ;
+				struct _edgeKey key ;
+				key.support = blocks.geneBlockEdges[j].support ;
+				key.u = component[i] ;
+				key.index = j ;
+				keys.push_back( key ) ;
 			}
 		}
 
-		std::sort( edges.begin(), edges.end(), CompEdge ) ;
-		edgeCnt = edges.size() ;
+		RadixSortEdgeKeys( keys, buffer ) ;
+		edgeCnt = keys.size() ;
 
+		// blockUsed only turns true, so the edges skipped once are never anchors later. 
+		int anchorStart = 0 ;
 		while ( 1 )
 		{
 			// Find the anchor
 			int tmp ;
-			for ( i = 0 ; i < edgeCnt ; ++i )		
+			for ( i = anchorStart ; i < edgeCnt ; ++i )		
 			{
-				if ( blockUsed[ edges[i].u ] || blockUsed[ edges[i].v ] )
+				if ( blockUsed[ keys[i].u ] || blockUsed[ blocks.geneBlockEdges[ keys[i].index ].v ] )
 					continue ;
 				break ;
 			}
 			if ( i >= edgeCnt )
 				break ;
+			anchorStart = i + 1 ;
+			struct _compactMateEdge &anchor = blocks.geneBlockEdges[ keys[i].index ] ;
 
-			blockUsed[ edges[i].u ] = true ;
-			blockUsed[ edges[i].v ] = true ;
+			blockUsed[ anchor.u ] = true ;
+			blockUsed[ anchor.v ] = true ;
 
 			// Extend the anchor until the support drops a lot or connect with other scaffoled part
-			std::vector<struct _mateEdge> chain[2] ;
-			chain[1].push_back( edges[i] ) ; // chain2 are used to search towards right.
+			std::vector<struct _compactMateEdge> chain[2] ;
+			chain[1].push_back( anchor ) ; // chain2 are used to search towards right.
 			
-			tmp = blocks.geneBlockGraph[ edges[i].v ].size() ;
-			for ( j = 0 ; j < tmp ; ++j )
+			tmp = blocks.geneBlockEdgeOffset[ anchor.v + 1 ] ;
+			for ( j = blocks.geneBlockEdgeOffset[ anchor.v ] ; j < tmp ; ++j )
 			{
-				if ( blocks.geneBlockGraph[ edges[i].v ][j].v == edges[i].u )
+				if ( blocks.geneBlockEdges[j].v == anchor.u )
 				{
-					chain[0].push_back( blocks.geneBlockGraph[ edges[i].v ][j] ) ;
+					chain[0].push_back( blocks.geneBlockEdges[j] ) ;
 					break ;
 				}
 			}
-			//printf( "%d %d\n", edges[i].u, edges[i].v ) ;
+			//printf( "%d %d\n", anchor.u, anchor.v ) ;
 			assert( chain[0].size() > 0 ) ;
-			//printf( "%d %d\n", edges[i].supportUse, chain[0][0].supportUse ) ;
+			//printf( "%d %d\n", anchor.supportUse, chain[0][0].supportUse ) ;
 			// Extend.
 			for ( k = 0 ; k < 2 ; ++k )
 			{
@@ -375,20 +1090,20 @@ public:
 
 					u = chain[k][csize - 1].v ;
 
-					int cnt = blocks.geneBlockGraph[u].size() ;
+					int end = blocks.geneBlockEdgeOffset[u + 1] ;
 					int max = 0, maxtag ;
 					int max2 = 0 ;
-					for ( j = 0 ; j < cnt ; ++j )
+					for ( j = blocks.geneBlockEdgeOffset[u] ; j < end ; ++j )
 					{
-						struct _mateEdge &edge = blocks.geneBlockGraph[u][j] ;
+						struct _compactMateEdge &edge = blocks.geneBlockEdges[j] ;
 						// The first part makes sure we are exiting the current block.
 						if ( ( edge.supportUse / 2 != ( chain[k][ csize - 1 ].supportUse & 1 ) ) )
 						{ 
-							int c = edge.support[ edge.supportUse ].GetCount() ;
+							int c = edge.support ;
 							if ( c >= max )
 							{
 								max2 = max ;
-								max = edge.support[ edge.supportUse ].GetCount() ;
+								max = edge.support ;
 								maxtag = j ;
 							}
 							else if ( c > max2 )
@@ -402,21 +1117,21 @@ public:
 					//if ( max2 != 0 && !blocks.IsSignificantDifferent( max, 100, max2, 100 ) ) // The extension is ambiguous
 					//	break ;
 
-					struct _mateEdge &edge = blocks.geneBlockGraph[u][maxtag] ;
+					struct _compactMateEdge &edge = blocks.geneBlockEdges[maxtag] ;
 					if ( blockUsed[ edge.v ]  )
 						break ;
-					if ( edge.support[ edge.supportUse ].GetCount() < chain[k][csize - 1].support[ chain[k][csize - 1].supportUse ].GetCount() / 50 ) // stop if the support drops too much
-					//if ( blocks.IsSignificantDifferent( edge.support[ edge.supportUse ].GetCount(), 100, chain[k][csize - 1].support[ chain[k][csize - 1].supportUse ].GetCount(), 100 ) )
+					if ( edge.support < chain[k][csize - 1].support / 50 ) // stop if the support drops too much
+					//if ( blocks.IsSignificantDifferent( edge.support, 100, chain[k][csize - 1].support, 100 ) )
 						break ;
-					blockUsed[ blocks.geneBlockGraph[u][maxtag].v ] = true ;
+					blockUsed[ blocks.geneBlockEdges[maxtag].v ] = true ;
 					chain[k].push_back( edge ) ;
 				}
 			}
 			// Concatenate chain1 and chain2.
 			// Add the whole chain to the scaffolding list.
 			struct _blockScaffoldWrapper scaffoldW ;
-			scaffoldW.s = new std::vector< struct _mateEdge > ;
-			std::vector< struct _mateEdge > *scaffold = scaffoldW.s ;
+			scaffoldW.s = new std::vector< struct _compactMateEdge > ;
+			std::vector< struct _compactMateEdge > *scaffold = scaffoldW.s ;
 			int cnt = chain[0].size() ;
 			for ( i = cnt - 1 ; i >= 0 ; --i )
 			{
@@ -432,10 +1147,10 @@ public:
 			// TODO: make it less stringent
 			/*if ( scaffold->size() == 1 )
 			{
-				int u = edges[i].u ;
-				int v = edges[i].v ;
-				if ( blocks.geneBlocks[u].exonBlockIds.size() == 1  &&
-					blocks.geneBlocks[v].exonBlockIds.size() == 1 )
+				int u = anchor.u ;
+				int v = anchor.v ;
+				if ( blocks.GetGeneBlockExonCount( u ) == 1  &&
+					blocks.GetGeneBlockExonCount( v ) == 1 )
 				{
 					delete scaffoldW.s ;
 					continue ;
@@ -452,41 +1167,136 @@ public:
 	
 				for ( i = 0 ; i < cnt ; ++i )
 				{
-					if ( chain[k][i].support[ chain[k][i].supportUse ].GetCount() < scaffoldW.support )
-						scaffoldW.support = chain[k][i].support[ chain[k][i].supportUse ].GetCount() ;
+					if ( chain[k][i].support < scaffoldW.support )
+						scaffoldW.support = chain[k][i].support ;
 				}
 			}
 			blockScaffolds.push_back( scaffoldW ) ;
 		}
 	}
 
+	// Output the solver and the time of each component, for tuning the size cutoff of the exact solver.
+	void OutputComponentTime( int *solver, double *elapsed )
+	{
+		int i, j ;
+		char buffer[1024] ;
+		const char *solverNames[] = { "greedy", "exact", "exact_timeout" } ;
+		sprintf( buffer, "%s_component_time.txt", prefix ) ;
+		FILE *fp = fopen( buffer, "w" ) ;
+		if ( fp == NULL )
+		{
+			fprintf( stderr, "Can not open %s.\n", buffer ) ;
+			exit( 1 ) ;
+		}
+		fprintf( fp, "#component\tgene_blocks\tedges\tsolver\tmicroseconds\n" ) ;
+		int componentCnt = GetComponentCount() ;
+		for ( i = 0 ; i < componentCnt ; ++i )
+		{
+			int nodeCnt = GetComponentSize( i ) ;
+			int *component = &componentMembers[ componentOffset[i] ] ;
+			int edgeCnt = 0 ;
+			for ( j = 0 ; j < nodeCnt ; ++j )
+				edgeCnt += blocks.geneBlockEdgeOffset[ component[j] + 1 ] - blocks.geneBlockEdgeOffset[ component[j] ] ;
+			fprintf( fp, "%d\t%d\t%d\t%s\t%.0lf\n", i, nodeCnt, edgeCnt / 2, solverNames[ solver[i] ], elapsed[i] * 1e6 ) ;
+		}
+		fclose( fp ) ;
+	}
+
+	struct _scaffoldComponentArg
+	{
+		Scaffold *scaffold ;
+		int *order ;
+		std::vector< struct _blockScaffoldWrapper > *componentScaffolds ;
+		int *solver ;
+		double *elapsed ;
+	} ;
+
+	static void ScaffoldComponent_Thread( int taskId, int threadId, void *arg )
+	{
+		struct _scaffoldComponentArg *a = (struct _scaffoldComponentArg *)arg ;
+		int componentId = a->order[ taskId ] ;
+		double start = GetMonotonicTime() ;
+		a->solver[ componentId ] = a->scaffold->ScaffoldComponent( componentId, a->componentScaffolds[ componentId ] ) ;
+		a->elapsed[ componentId ] = GetMonotonicTime() - start ;
+	}
+
+	// Scaffold all the components with the thread pool, the largest ones first.
+	// The results are concatenated in the order of the components, 
+	// so blockScaffolds is the same as scaffolding them one by one.
+	void ScaffoldComponents()
+	{
+		int i, j ;
+		int componentCnt = GetComponentCount() ;
+		if ( componentCnt == 0 )
+			return ;
+
+		// The work of a component is dominated by sorting its edges.
+		struct _pair *size = new struct _pair[ componentCnt ] ;
+		for ( i = 0 ; i < componentCnt ; ++i )
+		{
+			int nodeCnt = GetComponentSize( i ) ;
+			int *component = &componentMembers[ componentOffset[i] ] ;
+			size[i].a = 0 ;
+			for ( j = 0 ; j < nodeCnt ; ++j )
+				size[i].a += blocks.geneBlockEdgeOffset[ component[j] + 1 ] - blocks.geneBlockEdgeOffset[ component[j] ] ;
+			size[i].a += nodeCnt ;
+			size[i].b = i ;
+		}
+		std::sort( size, size + componentCnt, CompComponentSize ) ;
+
+		int *order = new int[ componentCnt ] ;
+		int64_t *cost = new int64_t[ componentCnt ] ;
+		for ( i = 0 ; i < componentCnt ; ++i )
+		{
+			order[i] = size[i].b ;
+			cost[i] = size[i].a ;
+		}
+		delete[] size ;
+
+		struct _scaffoldComponentArg arg ;
+		arg.scaffold = this ;
+		arg.order = order ;
+		arg.componentScaffolds = new std::vector< struct _blockScaffoldWrapper >[ componentCnt ] ;
+		arg.solver = new int[ componentCnt ] ;
+		arg.elapsed = new double[ componentCnt ] ;
+
+		ThreadPool pool( numOfThreads ) ;
+		pool.Run( componentCnt, cost, ScaffoldComponent_Thread, &arg ) ;
+
+		if ( outputComponentTime )
+			OutputComponentTime( arg.solver, arg.elapsed ) ;
+
+		for ( i = 0 ; i < componentCnt ; ++i )
+			blockScaffolds.insert( blockScaffolds.end(), arg.componentScaffolds[i].begin(), arg.componentScaffolds[i].end() ) ;
+
+		delete[] arg.componentScaffolds ;
+		delete[] arg.solver ;
+		delete[] arg.elapsed ;
+		delete[] order ;
+		delete[] cost ;
+	}
+
 	void ScaffoldGenome()
 	{
 		int i, j ;
 		int bscafCnt ;
-		contigCnt = 0 ;
 
 		std::sort( blockScaffolds.begin(), blockScaffolds.end(), CompScaffold ) ;					
 		// The sort and mapping can make scaffolds with higher support comes first
 		bscafCnt = blockScaffolds.size() ;
 
-		if ( genome.IsOpen() )
-		{
-			contigCnt = genome.GetContigCount()  ;
-		}
-		else
-		{
-			int cnt = blocks.geneBlocks.size() ;
-			int max = -1 ;
-			for ( i = 0 ; i < cnt ; ++i )
-				if ( blocks.geneBlocks[i].contigId > max )
-					max = blocks.geneBlocks[i].contigId ;
-			contigCnt = max + 1 ;
-		}
+		// Only the contigs carrying gene blocks can be scaffolded, so the nodes are kept for them alone.
+		int geneBlockCnt = blocks.GetGeneBlockCount() ;
+		keyContigs.clear() ;
+		for ( i = 0 ; i < geneBlockCnt ; ++i )
+			keyContigs.push_back( blocks.GetGeneBlockContigId( i ) ) ;
+		std::sort( keyContigs.begin(), keyContigs.end() ) ;
+		keyContigs.erase( std::unique( keyContigs.begin(), keyContigs.end() ), keyContigs.end() ) ;
+		int keyCnt = keyContigs.size() ;
 
 		/*for ( i = 0 ; i < bscafCnt ; ++i )
 		{
-			std::vector<struct _mateEdge> &s = *( blockScaffolds[i].s ) ;
+			std::vector<struct _compactMateEdge> &s = *( blockScaffolds[i].s ) ;
 			int cnt = s.size() ;
 			for ( j = 0 ; j < cnt ; ++j )
 				printf( "(%d=>%d) ", s[j].u, s[j].v ) ;
@@ -496,17 +1306,18 @@ public:
 		FindMisassemblies() ;	
 
 
-		scaffoldNodes = new struct _scaffoldNode[contigCnt] ;
+		scaffoldNodes = new struct _scaffoldNode[keyCnt] ;
 
-		for ( i = 0 ; i < contigCnt ; ++i )
+		for ( i = 0 ; i < keyCnt ; ++i )
 		{
 			memset( &scaffoldNodes[i], -1, sizeof( scaffoldNodes[i] ) ) ;
+			scaffoldNodes[i].mateEdges[0] = scaffoldNodes[i].mateEdges[1] = NULL ;
 		}
 
 		for ( i = 0 ; i < bscafCnt ; ++i )
 		{
 			// TODO: stop early if the block scaffold is not well
-			std::vector<struct _mateEdge> &s = *( blockScaffolds[i].s ) ;
+			std::vector<struct _compactMateEdge> &s = *( blockScaffolds[i].s ) ;
 
 			int cnt = s.size() ;
 			for ( j = 0 ; j < cnt ; ++j )
@@ -514,8 +1325,8 @@ public:
 				int u = s[j].u ;
 				int v = s[j].v ;
 
-				int contigIdu = blocks.geneBlocks[u].contigId ;
-				int contigIdv = blocks.geneBlocks[v].contigId ;
+				int contigIdu = blocks.GetGeneBlockContigId( u ) ;
+				int contigIdv = blocks.GetGeneBlockContigId( v ) ;
 				int dummyNodeu = 1 ;
 				int dummyNodev = 1 ;
 				if ( s[j].supportUse & 2 )	
@@ -523,44 +1334,46 @@ public:
 				if ( s[j].supportUse & 1 )
 					dummyNodev = 0 ;
 				
-				if ( misassembledInfo[ contigIdu ].u != -1 || misassembledInfo[ contigIdv ].v != -1 || contigIdu == contigIdv )
+				if ( IsMisassembled( contigIdu ) || IsMisassembled( contigIdv ) || contigIdu == contigIdv )
 					continue ;
+				struct _scaffoldNode &nodeu = scaffoldNodes[ GetKeyContigIndex( contigIdu ) ] ;
+				struct _scaffoldNode &nodev = scaffoldNodes[ GetKeyContigIndex( contigIdv ) ] ;
 
-				if ( scaffoldNodes[ contigIdu ].neighbor[ dummyNodeu ] == -1 &&
-					scaffoldNodes[ contigIdv ].neighbor[ dummyNodev ] == -1 )
+				if ( nodeu.neighbor[ dummyNodeu ] == -1 &&
+					nodev.neighbor[ dummyNodev ] == -1 )
 				{
-					//printf( "connect: %d %d %d\n", contigIdu, contigIdv, s[j].support[ s[j].supportUse ].GetCount() ) ;
-					scaffoldNodes[ contigIdu ].neighbor[ dummyNodeu ] = contigIdv ;
-					scaffoldNodes[ contigIdu ].neighborType[ dummyNodeu ] = dummyNodev ;
-					scaffoldNodes[ contigIdu ].mateEdges[ dummyNodeu ] = s[j] ;
+					//printf( "connect: %d %d %d\n", contigIdu, contigIdv, s[j].support ) ;
+					nodeu.neighbor[ dummyNodeu ] = contigIdv ;
+					nodeu.neighborType[ dummyNodeu ] = dummyNodev ;
+					nodeu.mateEdges[ dummyNodeu ] = &s[j] ;
 			
-					scaffoldNodes[ contigIdv ].neighbor[ dummyNodev ] = contigIdu ;
-					scaffoldNodes[ contigIdv ].neighborType[ dummyNodev ] = dummyNodeu ;
-					scaffoldNodes[ contigIdv ].mateEdges[ dummyNodev ] = s[j] ;
+					nodev.neighbor[ dummyNodev ] = contigIdu ;
+					nodev.neighborType[ dummyNodev ] = dummyNodeu ;
+					nodev.mateEdges[ dummyNodev ] = &s[j] ;
 				}
 				else
 				{
-					//printf( "error: %d %d %d\n", contigIdu, contigIdv, s[j].support[ s[j].supportUse ].GetCount() ) ;
+					//printf( "error: %d %d %d\n", contigIdu, contigIdv, s[j].support ) ;
 					// Break the originally assignment if the support is about the same.
 					bool reported = false ;
-					if ( scaffoldNodes[ contigIdu ].neighbor[ dummyNodeu ] >= 0 )
+					if ( nodeu.neighbor[ dummyNodeu ] >= 0 )
 					{
-						struct _mateEdge &me = scaffoldNodes[ contigIdu ].mateEdges[ dummyNodeu ] ;
-						if ( !blocks.IsSignificantDifferent( me.support[ me.supportUse ].GetCount(), 100, s[j].support[ s[j].supportUse ].GetCount(), 100 ) &&
-							( me.support[ me.supportUse ].GetCount() < 20 || !me.support[ me.supportUse ].IsUnique() ) )
+						const struct _compactMateEdge &me = *nodeu.mateEdges[ dummyNodeu ] ;
+						if ( !blocks.IsSignificantDifferent( me.support, 100, s[j].support, 100 ) &&
+							( me.support < 20 || !me.unique ) )
 						{
 							reported = true ;
-							scaffoldNodes[ contigIdu ].neighbor[ dummyNodeu ] = -2 ;
+							nodeu.neighbor[ dummyNodeu ] = -2 ;
 							problematicMates.push_back( me ) ;
 						}
 					}
-					if ( scaffoldNodes[ contigIdv ].neighbor[ dummyNodev ] >= 0 )
+					if ( nodev.neighbor[ dummyNodev ] >= 0 )
 					{
-						struct _mateEdge &me = scaffoldNodes[ contigIdv ].mateEdges[ dummyNodev ] ;
-						if ( !blocks.IsSignificantDifferent( me.support[ me.supportUse ].GetCount(), 100, s[j].support[ s[j].supportUse ].GetCount(), 100 ) &
-							( me.support[ me.supportUse ].GetCount() < 20 || !me.support[ me.supportUse ].IsUnique() ) )
+						const struct _compactMateEdge &me = *nodev.mateEdges[ dummyNodev ] ;
+						if ( !blocks.IsSignificantDifferent( me.support, 100, s[j].support, 100 ) &
+							( me.support < 20 || !me.unique ) )
 						{
-							scaffoldNodes[ contigIdv ].neighbor[ dummyNodev ] = -2 ;
+							nodev.neighbor[ dummyNodev ] = -2 ;
 							if ( !reported )
 								problematicMates.push_back( me ) ;
 						}
@@ -571,7 +1384,7 @@ public:
 			}
 		}
 
-		for ( i = 0 ; i < contigCnt ; ++i )
+		for ( i = 0 ; i < keyCnt ; ++i )
 		{
 			if ( scaffoldNodes[i].neighbor[0] < -1 )
 				scaffoldNodes[i].neighbor[0] = -1 ;
@@ -581,84 +1394,13 @@ public:
 
 		// Remove cycle.
 		// which records for the misassemblies in the scaffolding.
-
-		// Build graph
-		int edgeCnt = 0 ;
-		for ( i = 0 ; i < contigCnt ; ++i )
-		{
-			if ( scaffoldNodes[i].neighbor[0] != -1 )
-				++edgeCnt ;
-			if ( i + 1 < contigCnt && scaffoldNodes[i + 1].neighbor[1] != -1 )
-				++edgeCnt ;
-		}
-		ContigGraph contigGraph( contigCnt, contigCnt + edgeCnt ) ;
-		for ( i = 0 ; i < contigCnt - 1 ; ++i )
-		{
-			if ( genome.GetChrIdFromContigId( i ) == genome.GetChrIdFromContigId( i + 1 ) )
-				contigGraph.AddEdge( i, 1, i + 1, 0 ) ;
-		}
-
-		for ( i = 0 ; i < contigCnt ; ++i )	
-		{
-			if ( scaffoldNodes[i].neighbor[0] != -1 )	
-				contigGraph.AddEdge( i, 0, scaffoldNodes[i].neighbor[0], scaffoldNodes[i].neighborType[0] ) ;	
-			if ( scaffoldNodes[i].neighbor[1] != -1 )	
-				contigGraph.AddEdge( i, 1, scaffoldNodes[i].neighbor[1], scaffoldNodes[i].neighborType[1] ) ;	
-		}
-
-		// Record cycles
-		int *visitTime = new int[2 * contigCnt + 2] ; 
-		memset( visitTime, -1, sizeof( int ) * ( 2 * contigCnt + 2 ) ) ;
-		
-		std::vector<int> cycleNodes ;
-		for ( i = 0 ; i < contigCnt ; ++i )	
-		{
-			if ( misassembledInfo[i].u != -1 || misassembledInfo[i].v != -1 )
-				continue ;
-			//printf( "%d\n", i ) ;
-			cycleNodes.clear() ;
-
-			if ( contigGraph.IsInCycle( i, cycleNodes, visitTime ) )
-			{
-				int ccnt = cycleNodes.size() ;
-				for ( j = 0 ; j < ccnt ; ++j )
-				{
-					//printf( "hi %d %d: %d %d\n", i, cycleNodes[j], misassembledInfo[cycleNodes[j]].u, misassembledInfo[ cycleNodes[j] ].v ) ;
-					if ( misassembledInfo[ cycleNodes[j] ].u == -1 && misassembledInfo[ cycleNodes[j] ].v == -1 )
-					{
-						misassembledInfo[ cycleNodes[j] ].u = cycleNodes[j] ;
-						misassembledInfo[ cycleNodes[j] ].v = misassembledCycles.size() ;
-						misassembledInfo[ cycleNodes[j] ].type = 4 ;
-						//printf( "hi2 %d %d: %d %d\n", i, cycleNodes[j], misassembledInfo[cycleNodes[j]].u, misassembledInfo[ cycleNodes[j] ].v ) ;
-						// Remove the effects on the nieghbors
-						int v, dummyV ;
-						for ( int l = 0 ; l < 2 ; ++l )
-						{
-							v = scaffoldNodes[ cycleNodes[j] ].neighbor[l] ;
-							if ( v != -1 )
-							{
-								dummyV = scaffoldNodes[ cycleNodes[j] ].neighborType[l] ;
-								scaffoldNodes[v].neighbor[ dummyV ] = -1 ;
-								scaffoldNodes[v].neighborType[ dummyV ] = -1 ;
-							}
-						}
-						scaffoldNodes[ cycleNodes[j] ].neighbor[0] = scaffoldNodes[ cycleNodes[j] ].neighbor[1] = -1 ;
-						scaffoldNodes[ cycleNodes[j] ].neighborType[0] = scaffoldNodes[ cycleNodes[j] ].neighborType[1] = -1 ;
-					}
-				}
-				misassembledCycles.push_back( cycleNodes ) ;
-			}
-		}
-
-		delete[] visitTime ;
+		FindScaffoldCycles() ;
 		
-		for ( i = 0 ; i < contigCnt ; ++i )
+		for ( std::map<int, struct _misassembledInfo>::iterator it = misassembledInfo.begin() ; 
+			it != misassembledInfo.end() ; ++it )
 		{
-			if ( misassembledInfo[i].u != -1 )
-			{
-				//struct _contig c = genome.GetContigInfo( i ) ;
-				misassembledContigs.push_back( i ) ;
-			}
+			//struct _contig c = genome.GetContigInfo( it->first ) ;
+			misassembledContigs.push_back( it->first ) ;
 		}
 	}
 
@@ -667,17 +1409,22 @@ public:
 		int i, j ;
 		std::vector<struct _scaffold> scaffold ;		
 		std::vector<int> visit ;
-		bool *used = new bool[ contigCnt ] ;
-		memset( used, false, sizeof( bool ) * contigCnt ) ;
+		int keyCnt = keyContigs.size() ;
+		int cycleCnt = misassembledCycles.size() ;
+		bool *used = new bool[ keyCnt > cycleCnt ? keyCnt : cycleCnt ] ;
+		memset( used, false, sizeof( bool ) * cycleCnt ) ;
 
 		FILE *fpCS ; // the genomic sequence involved in connection 
+		OutputWriter *outCS = NULL ;
 		int headerCnt = 0 ;
 		if ( outputConnectionSequence )
 		{
 			char buffer[256] ;
 			sprintf( buffer, "%s_cs.fa", prefix ) ;
 			fpCS = fopen( buffer, "w" ) ;
+			outCS = new OutputWriter( fpCS ) ;
 		}
+		OutputWriter out( fpOut ) ;
 
 		// Output misassembled contig information
 		int mcCnt = misassembledContigs.size() ;
@@ -686,26 +1433,26 @@ public:
 			struct _contig c = genome.GetContigInfo( misassembledContigs[i] ) ;			
 			if ( misassembledInfo[c.id].type <= 3 )
 			{
-				fprintf( fpOut, "Contig %d is misassembled. (%s %" PRId64 "-%" PRId64 "): (%"PRId64"-%"PRId64") (%"PRId64"-%"PRId64"): ", 
+				out.Printf( "Contig %d is misassembled. (%s %" PRId64 "-%" PRId64 "): (%"PRId64"-%"PRId64") (%"PRId64"-%"PRId64"): ", 
 						c.id, alignments.GetChromName( c.chrId ), c.start + 1, c.end + 1,
-						blocks.geneBlocks[ misassembledInfo[ c.id ].u ].start + 1, blocks.geneBlocks[ misassembledInfo[ c.id ].u ].end + 1, 
-						blocks.geneBlocks[ misassembledInfo[ c.id ].v ].start + 1, blocks.geneBlocks[ misassembledInfo[ c.id ].v ].end + 1 ) ;
+						blocks.GetGeneBlockStart( misassembledInfo[ c.id ].u ) + 1, blocks.GetGeneBlockEnd( misassembledInfo[ c.id ].u ) + 1, 
+						blocks.GetGeneBlockStart( misassembledInfo[ c.id ].v ) + 1, blocks.GetGeneBlockEnd( misassembledInfo[ c.id ].v ) + 1 ) ;
 
 				if ( misassembledInfo[ c.id ].type == 0 )
 				{
-					fprintf( fpOut, "Found deletion between.\n") ;	
+					out.PutString( "Found deletion between.\n") ;	
 				}
 				else if ( misassembledInfo[ c.id ].type == 1 )
 				{
-					fprintf( fpOut, "Reverse first block.\n" ) ;
+					out.PutString( "Reverse first block.\n" ) ;
 				}
 				else if ( misassembledInfo[ c.id ].type == 2 )
 				{
-					fprintf( fpOut, "Reverse second block.\n" ) ;
+					out.PutString( "Reverse second block.\n" ) ;
 				}
 				else if ( misassembledInfo[ c.id ].type == 3 )
 				{
-					fprintf( fpOut, "Swap the two blocks.\n" ) ;
+					out.PutString( "Swap the two blocks.\n" ) ;
 				}
 			}
 			else if ( misassembledInfo[ c.id ].type == 4 )
@@ -715,23 +1462,23 @@ public:
 					used[ misassembledInfo[ c.id ].v ] = true ;
 					std::vector<int> &cycleNodes = misassembledCycles[ misassembledInfo[ c.id ].v ] ;
 					int cnt = cycleNodes.size() ;
-					fprintf( fpOut, "Misassembled scaffolds found among %d contigs: ", cnt ) ;
+					out.Printf( "Misassembled scaffolds found among %d contigs: ", cnt ) ;
 
 					for ( j = 0 ; j < cnt - 1 ; ++j )
 					{
 						struct _contig c= genome.GetContigInfo( cycleNodes[j] ) ;
-						fprintf( fpOut, "(%d %s %"PRId64"-%"PRId64") ",  c.id, alignments.GetChromName( c.chrId ), c.start + 1, c.end + 1 ) ;
+						out.Printf( "(%d %s %"PRId64"-%"PRId64") ",  c.id, alignments.GetChromName( c.chrId ), c.start + 1, c.end + 1 ) ;
 					}
 					struct _contig c= genome.GetContigInfo( cycleNodes[j] ) ;
-					fprintf( fpOut, "(%d %s %"PRId64"-%"PRId64")\n",  c.id, alignments.GetChromName( c.chrId ), c.start + 1, c.end + 1 ) ;
+					out.Printf( "(%d %s %"PRId64"-%"PRId64")\n",  c.id, alignments.GetChromName( c.chrId ), c.start + 1, c.end + 1 ) ;
 				}
 				
 			}
 		}
-		memset( used, false, sizeof( bool ) * contigCnt ) ;
+		memset( used, false, sizeof( bool ) * keyCnt ) ;
 
 		//printf( "%d\n", chrIdCnt ) ;	
-		for ( i = 0 ; i < contigCnt ; ++i )
+		for ( i = 0 ; i < keyCnt ; ++i )
 		{
 			if ( used[i] )
 				continue ;
@@ -740,7 +1487,7 @@ public:
 			if ( scaffoldNodes[i].neighbor[0] == -1 && scaffoldNodes[i].neighbor[1] == -1 ) // single-contig scaffold
 				continue ;
 
-			int p = i ;
+			int p = keyContigs[i] ;
 			int direction = 0 ;
 			if ( scaffoldNodes[i].neighbor[0] == -1 )
 				direction = 1 ;
@@ -751,9 +1498,10 @@ public:
 			visit.clear() ;
 			while ( p != -1 )
 			{
-				//if ( used[p] ) // avoid a cycle
+				int k = GetKeyContigIndex( p ) ;
+				//if ( used[k] ) // avoid a cycle
 				//	break ;
-				used[p] = true ;
+				used[k] = true ;
 				struct _scaffold newS ;
 				newS.contigId = p ;//scaffoldNodes[p].contigId ;
 
@@ -771,26 +1519,33 @@ public:
 				else
 					tag = 1 ;
 					
-				if ( scaffoldNodes[p].neighborType[tag] == 1 )
+				if ( scaffoldNodes[k].neighborType[tag] == 1 )
 					direction = -1 ;
 				else
 					direction = 1 ;
-				p = scaffoldNodes[p].neighbor[tag] ;
+				p = scaffoldNodes[k].neighbor[tag] ;
 			}
 
 			// Output the connections
 			int cnt = scaffold.size() ;
-			fprintf( fpOut, "%d: ", cnt ) ;
+			out.PutInt( cnt ) ;
+			out.PutString( ": " ) ;
 			for ( j = 0 ; j < cnt ; ++j )
 			{
 				char orientation = ( scaffold[j].flip ? '-' : '+' ) ;
 				struct _contig contigInfo = genome.GetContigInfo( scaffold[j].contigId ) ;
-				fprintf( fpOut, "(%s %"PRId64" %d %c) ", alignments.GetChromName( genome.GetChrIdFromContigId( scaffold[j].contigId ) ), 
-						//alignments.GetChromLength( genome.GetChrIdFromContigId( scaffold[j].contigId ) ), 
-						contigInfo.end - contigInfo.start + 1, 
-						scaffold[j].contigId, orientation ) ;
+				// (chrom length contigId orientation)
+				out.PutChar( '(' ) ;
+				out.PutString( alignments.GetChromName( genome.GetChrIdFromContigId( scaffold[j].contigId ) ) ) ;
+				out.PutChar( ' ' ) ;
+				out.PutInt( contigInfo.end - contigInfo.start + 1 ) ;
+				out.PutChar( ' ' ) ;
+				out.PutInt( scaffold[j].contigId ) ;
+				out.PutChar( ' ' ) ;
+				out.PutChar( orientation ) ;
+				out.PutString( ") " ) ;
 			}
-			fprintf( fpOut, "\n" ) ;
+			out.PutChar( '\n' ) ;
 			
 			for ( j = 0 ; j < cnt - 1 ; ++j )
 			{
@@ -800,26 +1555,39 @@ public:
 				else
 					tag = 1 ;
 
-				struct _mateEdge &edge = scaffoldNodes[ visit[j] ].mateEdges[tag] ;
+				const struct _compactMateEdge &edge = *scaffoldNodes[ GetKeyContigIndex( visit[j] ) ].mateEdges[tag] ;
 				int64_t a, b, c, d ;
-				if ( blocks.geneBlocks[ edge.u ].contigId == visit[j] )
+				if ( blocks.GetGeneBlockContigId( edge.u ) == visit[j] )
 				{
-					a = blocks.geneBlocks[ edge.u ].start ;
-					b = blocks.geneBlocks[ edge.u ].end ;
-					c = blocks.geneBlocks[ edge.v ].start ;
-					d = blocks.geneBlocks[ edge.v ].end ;
+					a = blocks.GetGeneBlockStart( edge.u ) ;
+					b = blocks.GetGeneBlockEnd( edge.u ) ;
+					c = blocks.GetGeneBlockStart( edge.v ) ;
+					d = blocks.GetGeneBlockEnd( edge.v ) ;
 				}
 				else
 				{
-					a = blocks.geneBlocks[ edge.v ].start ;
-					b = blocks.geneBlocks[ edge.v ].end ;
-					c = blocks.geneBlocks[ edge.u ].start ;
-					d = blocks.geneBlocks[ edge.u ].end ;
+					a = blocks.GetGeneBlockStart( edge.v ) ;
+					b = blocks.GetGeneBlockEnd( edge.v ) ;
+					c = blocks.GetGeneBlockStart( edge.u ) ;
+					d = blocks.GetGeneBlockEnd( edge.u ) ;
 				}
 				//fprintf( fpOut, "%d: (%s %" PRI64 "-%" PRI64 ") (%s %" PRI64 "-%" PRI64 ")\n", 
-				fprintf( fpOut, "\t%d: (%s:%"PRId64"-%"PRId64") (%s:%"PRId64"-%"PRId64")\n", 
-						edge.support[ edge.supportUse ].GetCount(), alignments.GetChromName( genome.GetChrIdFromContigId( scaffold[j].contigId ) ), a + 1, b + 1,
-						alignments.GetChromName( genome.GetChrIdFromContigId( scaffold[j + 1].contigId ) ), c + 1, d + 1 ) ;
+				// \tsupport: (chrom:start-end) (chrom:start-end)
+				out.PutChar( '\t' ) ;
+				out.PutInt( edge.support ) ;
+				out.PutString( ": (" ) ;
+				out.PutString( alignments.GetChromName( genome.GetChrIdFromContigId( scaffold[j].contigId ) ) ) ;
+				out.PutChar( ':' ) ;
+				out.PutInt( a + 1 ) ;
+				out.PutChar( '-' ) ;
+				out.PutInt( b + 1 ) ;
+				out.PutString( ") (" ) ;
+				out.PutString( alignments.GetChromName( genome.GetChrIdFromContigId( scaffold[j + 1].contigId ) ) ) ;
+				out.PutChar( ':' ) ;
+				out.PutInt( c + 1 ) ;
+				out.PutChar( '-' ) ;
+				out.PutInt( d + 1 ) ;
+				out.PutString( ")\n" ) ;
 			}
 
 			// Output the genomic sequence associated with the connection
@@ -834,9 +1602,9 @@ public:
 					else
 						tag = 1 ; 
 
-					struct _mateEdge &edge = scaffoldNodes[ visit[j] ].mateEdges[tag] ;
+					const struct _compactMateEdge &edge = *scaffoldNodes[ GetKeyContigIndex( visit[j] ) ].mateEdges[tag] ;
 				
-					if ( blocks.geneBlocks[ edge.u ].contigId == visit[j] )
+					if ( blocks.GetGeneBlockContigId( edge.u ) == visit[j] )
 					{
 						struct _pair id ;
 						id.a = edge.u ;
@@ -879,20 +1647,20 @@ public:
 
 					header[0] = '\0' ;
 					int len = 0, headerLen = 0 ;
-					struct _geneBlock &gb = blocks.geneBlocks[ geneBlockIds[tag].a ] ; 
+					int gb = geneBlockIds[tag].a ; 
 					int differentScaffoldConnection = 0 ;
 					// Test whether this is a connection from the contigs from the same scaffold
 					int k ;
 					for ( k = tag + 1 ; k < j ; ++k )
 					{
-						if ( blocks.geneBlocks[ geneBlockIds[k].a ].chrId != blocks.geneBlocks[geneBlockIds[k - 1].a ].chrId )
+						if ( blocks.GetGeneBlockChrId( geneBlockIds[k].a ) != blocks.GetGeneBlockChrId( geneBlockIds[k - 1].a ) )
 							break ;
 					} 
 					if ( k < j )
 						differentScaffoldConnection = 1 ;
 
 					sprintf( header, ">rascaf_CS_%d (%s:%"PRId64"-%"PRId64") %d %d", headerCnt, 
-						alignments.GetChromName( gb.chrId ), gb.start + 1, gb.end + 1, 
+						alignments.GetChromName( blocks.GetGeneBlockChrId( gb ) ), blocks.GetGeneBlockStart( gb ) + 1, blocks.GetGeneBlockEnd( gb ) + 1, 
 						differentScaffoldConnection, ( j - tag ) / 2 + 1 ) ;	
 					headerLen = strlen( header ) ;
 					int tmp ;
@@ -923,7 +1691,10 @@ public:
 					//if ( seq[0] == '\0' )
 					//	printf( "%s | %d %d %d %d %d\n", header, tag, j, seqLen, len, geneBlockIds[0].a ) ;
 									
-					fprintf( fpCS, "%s\n%s\n", header, seq ) ;
+					outCS->PutString( header ) ;
+					outCS->PutChar( '\n' ) ;
+					outCS->PutString( seq ) ;
+					outCS->PutChar( '\n' ) ;
 
 					free( seq ) ;
 					tag = j ;
@@ -933,15 +1704,18 @@ public:
 		delete[] used ;
 
 		if ( outputConnectionSequence )
+		{
+			delete outCS ;
 			fclose( fpCS ) ;
+		}
 
 		// Print out the problematic mates.
-		fprintf( fpOut, "WARNINGS:\n" ) ;
+		out.PutString( "WARNINGS:\n" ) ;
 		int pcnt = problematicMates.size() ;
 		for ( i = 0 ; i < pcnt ; ++i )
 		{
 			char du, dv ;
-			struct _mateEdge &edge = problematicMates[i] ;
+			struct _compactMateEdge &edge = problematicMates[i] ;
 			if ( edge.supportUse & 2 )
 				du = '-' ;
 			else
@@ -952,12 +1726,31 @@ public:
 			else
 				dv = '-' ;
 			
-			struct _geneBlock &u = blocks.geneBlocks[ edge.u ] ;
-			struct _geneBlock &v = blocks.geneBlocks[ edge.v ] ;
-			fprintf( fpOut, "%d: (%s:%"PRId64"-%"PRId64" %d %c) (%s:%"PRId64"-%"PRId64" %d %c)\n", 
-				edge.support[ edge.supportUse ].GetCount(), 
-				alignments.GetChromName( u.chrId ), u.start + 1, u.end + 1, u.contigId, du, 
-				alignments.GetChromName( v.chrId ), v.start + 1, v.end + 1, v.contigId, dv ) ;
+			int u = edge.u ;
+			int v = edge.v ;
+			// support: (chrom:start-end contigId orientation) (chrom:start-end contigId orientation)
+			out.PutInt( edge.support ) ;
+			out.PutString( ": (" ) ;
+			out.PutString( alignments.GetChromName( blocks.GetGeneBlockChrId( u ) ) ) ;
+			out.PutChar( ':' ) ;
+			out.PutInt( blocks.GetGeneBlockStart( u ) + 1 ) ;
+			out.PutChar( '-' ) ;
+			out.PutInt( blocks.GetGeneBlockEnd( u ) + 1 ) ;
+			out.PutChar( ' ' ) ;
+			out.PutInt( blocks.GetGeneBlockContigId( u ) ) ;
+			out.PutChar( ' ' ) ;
+			out.PutChar( du ) ;
+			out.PutString( ") (" ) ;
+			out.PutString( alignments.GetChromName( blocks.GetGeneBlockChrId( v ) ) ) ;
+			out.PutChar( ':' ) ;
+			out.PutInt( blocks.GetGeneBlockStart( v ) + 1 ) ;
+			out.PutChar( '-' ) ;
+			out.PutInt( blocks.GetGeneBlockEnd( v ) + 1 ) ;
+			out.PutChar( ' ' ) ;
+			out.PutInt( blocks.GetGeneBlockContigId( v ) ) ;
+			out.PutChar( ' ' ) ;
+			out.PutChar( dv ) ;
+			out.PutString( ")\n" ) ;
 		}
 	}
 } ;
@@ -2,120 +2,52 @@
 #ifndef _LSONG_RSCAF_SUPPORT_HEADER
 #define _LSONG_RSCAF_SUPPORT_HEADER
 
-extern int minimumSupport ; 
+#include <limits.h>
+#include <stdint.h>
+#include <algorithm>
 
-class Support
-{
-private:
-	int uniqSupport ; 
-	int multiSupport ;
+extern int minimumSupport ;
+
+// The weight of a multi-aligned read relative to a unique one.
+#define MULTI_SUPPORT_COEFFICIENT 1.0
 
+// The strand weights are stored in fixed point with this many units per read.
+// It is divisible by 1..10, 12, 14, 15 and 16, so the weights 1/(2*segCnt-2) and 1/(segCnt-1)
+// are exact for the reads with up to 9 segments. A 32-bit sum holds about 850,000 reads.
+#define STRAND_WEIGHT_SCALE 5040
 
-	int clipSupport ;
+// The support of a plain edge, which only needs the counts.
+class EdgeSupport
+{
+protected:
+	int uniqSupport ;
+	int multiSupport ;
 	int nmSum ;
-	double multiSupportCoefficient ;
 
-	int64_t leftPos, rightPos ;
-	int coordCnt ; // Record how many coordinates showed up.
-	int64_t prevCoord ;
-		
-	bool IsSignificantDifferent( double a, double b )
+	void AddCount( bool unique, int nm )
 	{
-		if ( a - 6 * sqrt((double)a) <= b  
-				&& b <= a + 6 * sqrt( (double)a ) )
-		{
-			return false ;
-		}
-
-		if ( b - 6 * sqrt( (double)b ) <= a && a <= b + 6 * sqrt( (double)b ) )
-		{
-			return false ;
-		}
-
-		return true ;
+		if ( unique )
+			++uniqSupport ;
+		else
+			++multiSupport ;
+		if ( nm > 0 )
+			nmSum += nm ;
 	}
 public:
-	double plusSupport ;
-	double minusSupport ;
-	Support()
+	EdgeSupport()
 	{
 		uniqSupport = multiSupport = 0 ;
-		plusSupport = minusSupport = 0 ;
-		clipSupport = 0 ;
-		leftPos = rightPos = -1 ;
-		multiSupportCoefficient = 1.0 ;
 		nmSum = 0 ;
-		coordCnt = 0 ;
-		prevCoord = -1 ;
 	}
 
-	~Support()
-	{
-	} 
-
-	void Add( Alignments &align, bool ignoreCoord = false )
+	void Add( Alignments &align )
 	{
-		if ( align.IsUnique() )
-			++uniqSupport ;
-		else
-			++multiSupport ;
-
-		int strand = align.GetStrand() ;
-		if ( strand == 1 )
-			plusSupport += align.GetStrandWeight() ;
-		else if ( strand == -1 )
-			minusSupport += align.GetStrandWeight() ;
-		int nm = align.GetFieldI( "NM" ) ;
-		if ( nm > 0 )
-		{
-			// Check the whether it aligns to Ns.
-			/*char *md = align.GetFieldZ( "MD" ) ;	
-			if ( md != NULL )
-			{
-				int i ;
-				for ( i = 0 ; md[i] ; ++i )
-				{
-					if ( md[i] == '0' && md[i + 1] == 'N' )
-						--nm ;
-				}
-			}*/
-			nmSum += nm ;
-		}
-
-		if ( !ignoreCoord )
-		{
-			if ( leftPos == -1 || align.segments[0].a < leftPos )
-				leftPos = align.segments[0].a ;
-			if ( align.segments[ align.segCnt - 1 ].b > rightPos )
-				rightPos = align.segments[ align.segCnt - 1 ].b ;
-
-			if ( align.segments[0].a != prevCoord ) // This makes sense when the coordinates are sorted
-				++coordCnt ;
-			else if ( align.GetFieldZ( "SA" ) != NULL )
-				++coordCnt ;
-			prevCoord = align.segments[0].a ;
-		}
+		AddCount( align.IsUnique(), align.GetFieldI( "NM" ) ) ;
 	}
 
-	void Add( Support &in )
+	void Add( const struct _alignmentSummary &s )
 	{
-		uniqSupport += in.uniqSupport ;
-		multiSupport += in.multiSupport ;
-
-		plusSupport += in.plusSupport ;
-		minusSupport += in.minusSupport ;
-
-		nmSum += in.nmSum ;
-
-		clipSupport += in.clipSupport ;
-
-		if ( in.leftPos != -1 && ( leftPos == -1 || in.leftPos < leftPos ) )
-			leftPos = in.leftPos ;
-		if ( in.rightPos > rightPos )
-			rightPos = in.rightPos ;
-
-		prevCoord = prevCoord > in.prevCoord ? prevCoord : in.prevCoord ;
-		coordCnt += in.coordCnt ;
+		AddCount( s.unique, s.nm ) ;
 	}
 
 	bool IsGood()
@@ -138,7 +70,7 @@ public:
 
 	int GetCount()
 	{
-		return (int)( uniqSupport + multiSupportCoefficient * multiSupport + 1e-6) ;
+		return (int)( uniqSupport + MULTI_SUPPORT_COEFFICIENT * multiSupport + 1e-6) ;
 	}
 
 	int GetUniqCount()
@@ -146,74 +78,173 @@ public:
 		return uniqSupport ;
 	}
 
+	void Clear()
+	{
+		uniqSupport = multiSupport = 0 ;
+		nmSum = 0 ;
+	}
+} ;
+
+// The support of blocks and mate edges. It is a plain struct of 32 bytes, so it can be copied and saved as raw bytes.
+class Support : public EdgeSupport
+{
+private:
+	uint32_t plusSupport, minusSupport ; // in the unit of 1/STRAND_WEIGHT_SCALE, saturated at UINT32_MAX
+	int leftPos, rightPos ; // leftPos is INT_MAX when no coordinate is recorded, so merging is a min.
+	// The coordinates of BAM are below 2^31. Only whether one or more coordinates showed up is used, 
+	// so a flag replaces the count.
+	uint32_t prevCoord : 31 ;
+	uint32_t multiCoord : 1 ;
+
+	bool IsSignificantDifferent( double a, double b )
+	{
+		if ( a - 6 * sqrt((double)a) <= b
+				&& b <= a + 6 * sqrt( (double)a ) )
+		{
+			return false ;
+		}
+
+		if ( b - 6 * sqrt( (double)b ) <= a && a <= b + 6 * sqrt( (double)b ) )
+		{
+			return false ;
+		}
+
+		return true ;
+	}
+
+	static uint32_t SaturatedAdd( uint32_t a, uint64_t b )
+	{
+		uint64_t sum = a + b ;
+		return sum > UINT32_MAX ? UINT32_MAX : (uint32_t)sum ;
+	}
+
+	void AddStrand( int strand, double weight )
+	{
+		uint64_t w = (uint64_t)( weight * STRAND_WEIGHT_SCALE + 0.5 ) ;
+		if ( strand == 1 )
+			plusSupport = SaturatedAdd( plusSupport, w ) ;
+		else if ( strand == -1 )
+			minusSupport = SaturatedAdd( minusSupport, w ) ;
+	}
+
+	void AddCoord( int start, int end, bool hasSA )
+	{
+		// This makes sense when the coordinates are sorted
+		if ( leftPos != INT_MAX && ( (uint32_t)start != prevCoord || hasSA ) )
+			multiCoord = 1 ;
+		if ( start < leftPos )
+			leftPos = start ;
+		if ( end > rightPos )
+			rightPos = end ;
+		prevCoord = start ;
+	}
+public:
+	Support()
+	{
+		Clear() ;
+	}
+
+	void Add( Alignments &align, bool ignoreCoord = false )
+	{
+		EdgeSupport::Add( align ) ;
+		AddStrand( align.GetStrand(), align.GetStrandWeight() ) ;
+
+		if ( !ignoreCoord )
+		{
+			int start = align.segments[0].a ;
+			// Only look up the SA field when it matters.
+			AddCoord( start, align.segments[ align.segCnt - 1 ].b,
+				start == prevCoord && align.GetFieldZ( "SA" ) != NULL ) ;
+		}
+	}
+
+	// The same as Add( Alignments & ) for the alignment summarized in s.
+	void Add( const struct _alignmentSummary &s )
+	{
+		EdgeSupport::Add( s ) ;
+		AddStrand( s.strand, s.strandWeight ) ;
+		AddCoord( s.start, s.end, s.hasSA ) ;
+	}
+
+	void Add( const Support &in )
+	{
+		uniqSupport += in.uniqSupport ;
+		multiSupport += in.multiSupport ;
+		nmSum += in.nmSum ;
+
+		plusSupport = SaturatedAdd( plusSupport, in.plusSupport ) ;
+		minusSupport = SaturatedAdd( minusSupport, in.minusSupport ) ;
+
+		if ( in.leftPos != INT_MAX )
+		{
+			if ( leftPos != INT_MAX || in.multiCoord )
+				multiCoord = 1 ;
+			if ( leftPos == INT_MAX || in.prevCoord > prevCoord )
+				prevCoord = in.prevCoord ;
+		}
+		leftPos = std::min( leftPos, in.leftPos ) ;
+		rightPos = std::max( rightPos, in.rightPos ) ;
+	}
+
 	int GetStrand()
 	{
-		if ( !IsSignificantDifferent( plusSupport, minusSupport ) && plusSupport > 1 && minusSupport > 1 )
+		if ( !IsSignificantDifferent( GetPlusSupport(), GetMinusSupport() )
+			&& plusSupport > STRAND_WEIGHT_SCALE && minusSupport > STRAND_WEIGHT_SCALE )
 			return 0 ;
-		else if ( plusSupport <= 1 && minusSupport <= 1 )
+		else if ( plusSupport <= STRAND_WEIGHT_SCALE && minusSupport <= STRAND_WEIGHT_SCALE )
 			return 0 ;
 		else if ( plusSupport == minusSupport )
 			return 0 ;
 		else if ( plusSupport > minusSupport )
 			return 1 ;
-		else 
+		else
 			return -1 ;
 	}
 
 	bool HasStrandSupport()
 	{
-		if ( plusSupport >= minimumSupport || minusSupport >= minimumSupport )
+		int64_t threshold = (int64_t)minimumSupport * STRAND_WEIGHT_SCALE ;
+		if ( plusSupport >= threshold || minusSupport >= threshold )
 			return true ;
 		return false ;
 	}
 
-	int GetLeftMostPos()
+	double GetPlusSupport()
 	{
-		return leftPos ;
+		return plusSupport / (double)STRAND_WEIGHT_SCALE ;
 	}
 
-	int GetRightMostPos()
+	double GetMinusSupport()
 	{
-		return rightPos ;
+		return minusSupport / (double)STRAND_WEIGHT_SCALE ;
 	}
 
-	int GetCoordCnt()
+	int GetLeftMostPos()
 	{
-		return coordCnt ;
+		return leftPos == INT_MAX ? -1 : leftPos ;
 	}
 
-	void operator=( const Support &in )
+	int GetRightMostPos()
 	{
-		uniqSupport = in.uniqSupport ;
-		multiSupport = in.multiSupport ;
-
-		plusSupport = in.plusSupport ;
-		minusSupport = in.minusSupport ;
-		
-		clipSupport += in.clipSupport ;
-		
-		nmSum = in.nmSum ;
-		
-		leftPos = in.leftPos ;
-		rightPos = in.rightPos ;
+		return rightPos ;
+	}
 
-		multiSupportCoefficient = in.multiSupportCoefficient ;
-		
-		prevCoord = in.prevCoord ;
-		coordCnt = in.coordCnt ;
+	// 0, 1, or 2 for two or more coordinates.
+	int GetCoordCnt()
+	{
+		if ( leftPos == INT_MAX )
+			return 0 ;
+		return multiCoord ? 2 : 1 ;
 	}
 
 	void Clear()
 	{
-		uniqSupport = multiSupport = 0 ;
+		EdgeSupport::Clear() ;
 		plusSupport = minusSupport = 0 ;
-		clipSupport = 0 ;
-		nmSum = 0 ;
-		leftPos = rightPos = -1 ;
-		multiSupportCoefficient = 1.0 ;
-
-		coordCnt = 0 ;
-		prevCoord = -1 ;
+		leftPos = INT_MAX ;
+		rightPos = -1 ;
+		prevCoord = 0 ;
+		multiCoord = 0 ;
 	}
 } ;
 #endif